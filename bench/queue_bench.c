@@ -0,0 +1,778 @@
+/*
+ * Queue and Analytics Microbenchmarks
+ *
+ * Measures the queue and analytics primitives in isolation, without the
+ * sleeps and per-item output of the simulation, and prints one result row
+ * per configuration as CSV or JSON so runs can be compared across versions.
+ *
+ * Benchmarks:
+ *   enq_deq    single thread, queue held at half capacity, one enqueue and
+ *              one dequeue per item (ns_per_op = one round trip)
+ *   find_high  find_highest_priority_index() on a full SCAN queue
+ *   mpmc       producers/consumers moving a fixed number of items
+ *   analytics  analytics_record_*() calls from concurrent threads
+ *   layout     before/after rows for the Queue index padding and the
+ *              QueueItem encoding (legacy layouts are reproduced locally)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "queue_backend.h"
+#include "analytics.h"
+#include "timing.h"
+#include "config.h"
+
+// Sweep dimensions
+static const int bench_capacities[] = { 64, 1024, 4096 };
+static const int bench_batches[] = { 1, 32 };
+static const QueueBackend bench_backends[] = {
+    QUEUE_BACKEND_SCAN, QUEUE_BACKEND_BUCKET, QUEUE_BACKEND_LOCKFREE, QUEUE_BACKEND_SPSC
+};
+
+#define ARRAY_COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+// Priority mixes used to generate items
+typedef enum {
+    MIX_UNIFORM = 0,    // Same value -> priority mapping as the producers
+    MIX_NORMAL,         // Every item at PRIORITY_NORMAL (pure FIFO)
+    MIX_SKEWED,         // 10% high, 90% low (high items overtake a long tail)
+    MIX_COUNT
+} PriorityMix;
+
+static const char *mix_names[MIX_COUNT] = { "uniform", "normal", "skewed" };
+
+// Items are drawn round-robin from a pre-generated pool
+#define ITEM_POOL_SIZE 4096
+
+// Output format
+typedef enum {
+    FORMAT_CSV = 0,
+    FORMAT_JSON
+} OutputFormat;
+
+static OutputFormat output_format = FORMAT_CSV;
+static int rows_printed = 0;
+
+// One result row
+typedef struct {
+    const char *bench;          // Benchmark name
+    const char *target;         // Queue backend or analytics call
+    int producers;
+    int consumers;
+    int capacity;
+    const char *mix;
+    int batch;
+    long ops;                   // Operations measured
+    uint64_t elapsed_ns;        // Wall time for all operations
+    int threads;                // Threads sharing the operations (for ns/op)
+} BenchResult;
+
+/*
+ * Display usage information
+ */
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [-f csv|json] [-t max_threads] [-n items] [-b bench]\n", program_name);
+    fprintf(stderr, "  -f  Output format (default csv)\n");
+    fprintf(stderr, "  -t  Largest producer/consumer count to sweep (default: online CPUs)\n");
+    fprintf(stderr, "  -n  Items per measurement (default 200000)\n");
+    fprintf(stderr, "  -b  Run only one benchmark: enq_deq, find_high, mpmc,\n");
+    fprintf(stderr, "      analytics or layout\n");
+}
+
+/*
+ * Print one result row in the selected format
+ */
+static void print_result(const BenchResult *r) {
+    double ns_per_op = r->ops > 0 ? (double)r->elapsed_ns * r->threads / r->ops : 0.0;
+    double ops_per_sec = r->elapsed_ns > 0 ? r->ops * 1e9 / r->elapsed_ns : 0.0;
+    
+    if (output_format == FORMAT_JSON) {
+        printf("%s  {\"bench\": \"%s\", \"target\": \"%s\", \"producers\": %d, \"consumers\": %d, "
+               "\"capacity\": %d, \"mix\": \"%s\", \"batch\": %d, \"ops\": %ld, "
+               "\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}",
+               rows_printed > 0 ? ",\n" : "", r->bench, r->target, r->producers, r->consumers,
+               r->capacity, r->mix, r->batch, r->ops, ns_per_op, ops_per_sec);
+    } else {
+        printf("%s,%s,%d,%d,%d,%s,%d,%ld,%.2f,%.0f\n",
+               r->bench, r->target, r->producers, r->consumers, r->capacity,
+               r->mix, r->batch, r->ops, ns_per_op, ops_per_sec);
+    }
+    
+    rows_printed++;
+    fflush(stdout);
+}
+
+/*
+ * Fill the item pool with priorities following the given mix
+ */
+static void fill_items(QueueItem *items, int n, PriorityMix mix, unsigned int seed) {
+    for (int i = 0; i < n; i++) {
+        int value = rand_r(&seed) % (RANDOM_VALUE_MAX - RANDOM_VALUE_MIN + 1) + RANDOM_VALUE_MIN;
+        int priority;
+    
+        if (mix == MIX_NORMAL) {
+            priority = PRIORITY_NORMAL;
+        } else if (mix == MIX_SKEWED) {
+            priority = value == RANDOM_VALUE_MAX ? PRIORITY_HIGH : PRIORITY_LOW;
+        } else if (value >= 7) {
+            priority = PRIORITY_HIGH;
+        } else if (value >= 4) {
+            priority = PRIORITY_NORMAL;
+        } else {
+            priority = PRIORITY_LOW;
+        }
+    
+        items[i].value = value;
+        items[i].priority = priority;
+        items[i].producer_id = 0;
+        items[i].timestamp = 0;
+        items[i].sequence = i;
+    }
+}
+
+/*
+ * Create a queue for one measurement
+ */
+static Queue* bench_queue(QueueBackend backend, int capacity) {
+    QueueOptions opts;
+    queue_options_default(&opts, capacity);
+    opts.backend = backend;
+    
+    return queue_init_with(&opts);
+}
+
+/*
+ * Enqueue items from the pool until the queue holds count items
+ */
+static void prefill(Queue *q, const QueueItem *pool, int count) {
+    for (int i = 0; i < count; i++) {
+        queue_enqueue(q, pool[i % ITEM_POOL_SIZE]);
+    }
+}
+
+/*
+ * enq_deq: single-threaded round trips at half occupancy
+ */
+static void bench_enq_deq(long n_items) {
+    QueueItem *pool = (QueueItem *)malloc(sizeof(QueueItem) * ITEM_POOL_SIZE);
+    QueueItem *out = (QueueItem *)malloc(sizeof(QueueItem) * ITEM_POOL_SIZE);
+    if (pool == NULL || out == NULL) {
+        fprintf(stderr, "Error: Failed to allocate item pool\n");
+        free(pool);
+        free(out);
+        return;
+    }
+    
+    for (int b = 0; b < ARRAY_COUNT(bench_backends); b++) {
+        if (!queue_backend_available(bench_backends[b])) {
+            continue;
+        }
+        for (int c = 0; c < ARRAY_COUNT(bench_capacities); c++) {
+            for (int m = 0; m < MIX_COUNT; m++) {
+                for (int s = 0; s < ARRAY_COUNT(bench_batches); s++) {
+                    int capacity = bench_capacities[c];
+                    int batch = bench_batches[s];
+    
+                    // The batch must fit in the free half of the queue
+                    if (batch > capacity - capacity / 2) {
+                        continue;
+                    }
+    
+                    fill_items(pool, ITEM_POOL_SIZE, (PriorityMix)m, 1);
+                    Queue *q = bench_queue(bench_backends[b], capacity);
+                    if (q == NULL) {
+                        continue;
+                    }
+                    prefill(q, pool, capacity / 2);
+    
+                    long rounds = n_items / batch;
+                    int next = 0;
+                    uint64_t start = timing_now_ns();
+    
+                    for (long r = 0; r < rounds; r++) {
+                        if (next + batch > ITEM_POOL_SIZE) {
+                            next = 0;
+                        }
+                        queue_enqueue_batch(q, &pool[next], batch, NULL);
+                        queue_dequeue_batch(q, out, batch, batch, NULL);
+                        next += batch;
+                    }
+    
+                    BenchResult res = {
+                        "enq_deq", queue_backend_name(bench_backends[b]), 1, 1, capacity,
+                        mix_names[m], batch, rounds * batch, timing_now_ns() - start, 1
+                    };
+                    print_result(&res);
+                    queue_destroy(q);
+                }
+            }
+        }
+    }
+    
+    free(pool);
+    free(out);
+}
+
+/*
+ * find_high: priority scan over a full SCAN queue
+ */
+static void bench_find_high(long n_items) {
+    if (!queue_backend_available(QUEUE_BACKEND_SCAN)) {
+        return;
+    }
+    
+    QueueItem *pool = (QueueItem *)malloc(sizeof(QueueItem) * ITEM_POOL_SIZE);
+    if (pool == NULL) {
+        fprintf(stderr, "Error: Failed to allocate item pool\n");
+        return;
+    }
+    
+    for (int c = 0; c < ARRAY_COUNT(bench_capacities); c++) {
+        for (int m = 0; m < MIX_COUNT; m++) {
+            int capacity = bench_capacities[c];
+    
+            fill_items(pool, ITEM_POOL_SIZE, (PriorityMix)m, 1);
+            Queue *q = bench_queue(QUEUE_BACKEND_SCAN, capacity);
+            if (q == NULL) {
+                continue;
+            }
+            prefill(q, pool, capacity);
+    
+            // Keep the cost of one run roughly independent of the capacity
+            long calls = n_items * 64 / capacity;
+            if (calls < 1) {
+                calls = 1;
+            }
+    
+            volatile int sink = 0;
+            uint64_t start = timing_now_ns();
+    
+            for (long i = 0; i < calls; i++) {
+                sink += find_highest_priority_index(q);
+            }
+            (void)sink;
+    
+            BenchResult res = {
+                "find_high", "scan", 0, 0, capacity, mix_names[m], 1,
+                calls, timing_now_ns() - start, 1
+            };
+            print_result(&res);
+            queue_destroy(q);
+        }
+    }
+    
+    free(pool);
+}
+
+// Shared state of one mpmc measurement
+typedef struct {
+    Queue *queue;
+    pthread_barrier_t start;
+    long items_per_producer;
+    long total_items;
+    int batch;
+    const QueueItem *pool;
+    atomic_long consumed;
+} MpmcRun;
+
+/*
+ * mpmc producer: enqueue a fixed share of the items in batches
+ */
+static void* mpmc_producer(void *arg) {
+    MpmcRun *run = (MpmcRun *)arg;
+    long left = run->items_per_producer;
+    int next = 0;
+    
+    pthread_barrier_wait(&run->start);
+    
+    while (left > 0) {
+        int n = left < run->batch ? (int)left : run->batch;
+        if (next + n > ITEM_POOL_SIZE) {
+            next = 0;
+        }
+    
+        int done = queue_enqueue_batch(run->queue, &run->pool[next], n, NULL);
+        if (done <= 0) {
+            break;
+        }
+        left -= done;
+        next += done;
+    }
+    
+    return NULL;
+}
+
+/*
+ * mpmc consumer: dequeue until every item has been taken
+ * The consumer taking the last item stops the others by closing the queue
+ */
+static void* mpmc_consumer(void *arg) {
+    MpmcRun *run = (MpmcRun *)arg;
+    QueueItem *out = (QueueItem *)malloc(sizeof(QueueItem) * run->batch);
+    if (out == NULL) {
+        fprintf(stderr, "Error: Failed to allocate consumer buffer\n");
+        return NULL;
+    }
+    
+    pthread_barrier_wait(&run->start);
+    
+    while (atomic_load(&run->consumed) < run->total_items) {
+        int done = queue_dequeue_batch(run->queue, out, run->batch, 1, NULL);
+        if (done <= 0) {
+            break;
+        }
+    
+        if (atomic_fetch_add(&run->consumed, done) + done >= run->total_items) {
+            queue_close(run->queue);
+        }
+    }
+    
+    free(out);
+    return NULL;
+}
+
+/*
+ * Run one mpmc configuration, returns 0 on success
+ */
+static int mpmc_run(QueueBackend backend, int capacity, int batch,
+                    int producers, int consumers, const QueueItem *pool, long n_items) {
+    MpmcRun run;
+    run.queue = bench_queue(backend, capacity);
+    if (run.queue == NULL) {
+        return -1;
+    }
+    run.items_per_producer = n_items / producers;
+    run.total_items = run.items_per_producer * producers;
+    run.batch = batch;
+    run.pool = pool;
+    atomic_init(&run.consumed, 0);
+    pthread_barrier_init(&run.start, NULL, (unsigned)(producers + consumers + 1));
+    
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * (producers + consumers));
+    if (threads == NULL) {
+        pthread_barrier_destroy(&run.start);
+        queue_destroy(run.queue);
+        return -1;
+    }
+    
+    for (int i = 0; i < producers + consumers; i++) {
+        void *(*fn)(void *) = i < producers ? mpmc_producer : mpmc_consumer;
+        if (pthread_create(&threads[i], NULL, fn, &run) != 0) {
+            // A half-started run would never pass the barrier
+            fprintf(stderr, "Error: Failed to create benchmark thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    
+    pthread_barrier_wait(&run.start);
+    uint64_t start = timing_now_ns();
+    
+    for (int i = 0; i < producers + consumers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    BenchResult res = {
+        "mpmc", queue_backend_name(backend), producers, consumers, capacity,
+        mix_names[MIX_UNIFORM], batch, atomic_load(&run.consumed), timing_now_ns() - start, 1
+    };
+    print_result(&res);
+    
+    free(threads);
+    pthread_barrier_destroy(&run.start);
+    queue_destroy(run.queue);
+    return 0;
+}
+
+/*
+ * mpmc: sweep thread counts, capacity and batch size for every backend
+ * Thread counts are 1, 2, 4, ... max_threads for balanced runs, plus the
+ * 1:N and N:1 shapes
+ */
+static void bench_mpmc(int max_threads, long n_items) {
+    QueueItem *pool = (QueueItem *)malloc(sizeof(QueueItem) * ITEM_POOL_SIZE);
+    if (pool == NULL) {
+        fprintf(stderr, "Error: Failed to allocate item pool\n");
+        return;
+    }
+    fill_items(pool, ITEM_POOL_SIZE, MIX_UNIFORM, 1);
+    
+    for (int b = 0; b < ARRAY_COUNT(bench_backends); b++) {
+        if (!queue_backend_available(bench_backends[b])) {
+            continue;
+        }
+        for (int c = 0; c < ARRAY_COUNT(bench_capacities); c++) {
+            for (int s = 0; s < ARRAY_COUNT(bench_batches); s++) {
+                for (int t = 1; t <= max_threads; t *= 2) {
+                    // SPSC only supports one producer and one consumer
+                    if (bench_backends[b] == QUEUE_BACKEND_SPSC && t > 1) {
+                        break;
+                    }
+                    mpmc_run(bench_backends[b], bench_capacities[c], bench_batches[s],
+                             t, t, pool, n_items);
+                    if (t > 1) {
+                        mpmc_run(bench_backends[b], bench_capacities[c], bench_batches[s],
+                                 1, t, pool, n_items);
+                        mpmc_run(bench_backends[b], bench_capacities[c], bench_batches[s],
+                                 t, 1, pool, n_items);
+                    }
+                }
+            }
+        }
+    }
+    
+    free(pool);
+}
+
+// Analytics calls under test
+typedef enum {
+    CALL_PRODUCE = 0,
+    CALL_CONSUME_PRIORITY,
+    CALL_PRODUCER_BLOCK,
+    CALL_COUNT
+} AnalyticsCall;
+
+static const char *call_names[CALL_COUNT] = {
+    "record_produce", "record_consume_priority", "record_producer_block"
+};
+
+// Shared state of one analytics measurement
+typedef struct {
+    Analytics *analytics;
+    AnalyticsCall call;
+    long calls_per_thread;
+    pthread_barrier_t start;
+} AnalyticsRun;
+
+/*
+ * analytics worker: issue the same record call in a loop
+ */
+static void* analytics_worker(void *arg) {
+    AnalyticsRun *run = (AnalyticsRun *)arg;
+    static const int priorities[] = { PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW };
+    
+    pthread_barrier_wait(&run->start);
+    
+    for (long i = 0; i < run->calls_per_thread; i++) {
+        switch (run->call) {
+            case CALL_PRODUCE:
+                analytics_record_produce(run->analytics);
+                break;
+            case CALL_CONSUME_PRIORITY:
+                analytics_record_consume_priority(run->analytics, priorities[i % 3],
+                                                  (uint64_t)(i & 0xffff) * 1000);
+                break;
+            default:
+                analytics_record_producer_block(run->analytics, (uint64_t)(i & 0xffff) * 1000);
+                break;
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+ * analytics: every record call at 1, 2, 4, ... max_threads threads
+ */
+static void bench_analytics(int max_threads, long n_items) {
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * max_threads);
+    if (threads == NULL) {
+        fprintf(stderr, "Error: Failed to allocate thread table\n");
+        return;
+    }
+    
+    for (int call = 0; call < CALL_COUNT; call++) {
+        for (int t = 1; t <= max_threads; t *= 2) {
+            AnalyticsRun run;
+            run.analytics = analytics_init();
+            if (run.analytics == NULL) {
+                break;
+            }
+            run.call = (AnalyticsCall)call;
+            run.calls_per_thread = n_items * 10;
+            pthread_barrier_init(&run.start, NULL, (unsigned)(t + 1));
+    
+            for (int i = 0; i < t; i++) {
+                if (pthread_create(&threads[i], NULL, analytics_worker, &run) != 0) {
+                    fprintf(stderr, "Error: Failed to create benchmark thread\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+    
+            pthread_barrier_wait(&run.start);
+            uint64_t start = timing_now_ns();
+    
+            for (int i = 0; i < t; i++) {
+                pthread_join(threads[i], NULL);
+            }
+    
+            // ns_per_op is the cost of one call as seen by one thread
+            BenchResult res = {
+                "analytics", call_names[call], t, 0, 0, "-", 1,
+                run.calls_per_thread * t, timing_now_ns() - start, t
+            };
+            print_result(&res);
+    
+            pthread_barrier_destroy(&run.start);
+            analytics_destroy(run.analytics);
+        }
+    }
+    
+    free(threads);
+}
+
+// Index pair as laid out before the Queue fields were split by writer:
+// producer and consumer counters share one cache line
+typedef struct {
+    atomic_size_t tail;
+    atomic_size_t head;
+} SharedIndices;
+
+// Index pair as laid out now: each counter on its own cache line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+} PaddedIndices;
+
+// QueueItem as laid out before the compaction (32 bytes with padding)
+typedef struct {
+    int value;
+    int priority;
+    int producer_id;
+    uint64_t timestamp;
+    int sequence;
+} LegacyItem;
+
+// Ring used for the item layout comparison (1M items)
+#define LAYOUT_RING_ITEMS (1 << 20)
+
+// Shared state of one index measurement
+typedef struct {
+    atomic_size_t *counter;     // Counter owned by this thread
+    long increments;
+    pthread_barrier_t *start;
+} IndexRun;
+
+/*
+ * layout worker: advance one counter, as a producer or consumer advances
+ * its own index
+ */
+static void* layout_index_worker(void *arg) {
+    IndexRun *run = (IndexRun *)arg;
+    
+    pthread_barrier_wait(run->start);
+    
+    for (long i = 0; i < run->increments; i++) {
+        atomic_fetch_add_explicit(run->counter, 1, memory_order_release);
+    }
+    
+    return NULL;
+}
+
+/*
+ * Time two threads advancing the tail and head counters of one index pair
+ */
+static void layout_indices(const char *target, atomic_size_t *tail, atomic_size_t *head,
+                           long n_items) {
+    pthread_t threads[2];
+    pthread_barrier_t start;
+    IndexRun runs[2] = {
+        { tail, n_items, &start },
+        { head, n_items, &start },
+    };
+    
+    pthread_barrier_init(&start, NULL, 3);
+    for (int i = 0; i < 2; i++) {
+        if (pthread_create(&threads[i], NULL, layout_index_worker, &runs[i]) != 0) {
+            fprintf(stderr, "Error: Failed to create benchmark thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    
+    pthread_barrier_wait(&start);
+    uint64_t begin = timing_now_ns();
+    
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    BenchResult res = {
+        "layout", target, 1, 1, 0, "-", 1, n_items * 2, timing_now_ns() - begin, 2
+    };
+    print_result(&res);
+    pthread_barrier_destroy(&start);
+}
+
+/*
+ * Stream n_items through a 1M-item ring of legacy items: write the item at
+ * the tail, read the one half a ring behind it (memory bound)
+ */
+static uint64_t layout_stream_legacy(LegacyItem *ring, long n_items, long *checksum) {
+    uint64_t begin = timing_now_ns();
+    long sum = 0;
+    
+    for (long i = 0; i < n_items; i++) {
+        LegacyItem *in = &ring[i % LAYOUT_RING_ITEMS];
+        in->value = (int)(i % 10);
+        in->priority = (int)(i % QUEUE_PRIORITY_LEVELS);
+        in->producer_id = 1;
+        in->timestamp = (uint64_t)i;
+        in->sequence = (int)i;
+    
+        const LegacyItem *out = &ring[(i + LAYOUT_RING_ITEMS / 2) % LAYOUT_RING_ITEMS];
+        sum += out->value + out->priority + out->sequence + (long)out->timestamp;
+    }
+    
+    *checksum = sum;
+    return timing_now_ns() - begin;
+}
+
+/*
+ * Same as layout_stream_legacy() with the QueueItem of this build
+ */
+static uint64_t layout_stream_current(QueueItem *ring, long n_items, long *checksum) {
+    uint64_t begin = timing_now_ns();
+    long sum = 0;
+    
+    for (long i = 0; i < n_items; i++) {
+        QueueItem *in = &ring[i % LAYOUT_RING_ITEMS];
+        in->value = (int)(i % 10);
+        in->priority = (int)(i % QUEUE_PRIORITY_LEVELS);
+        in->producer_id = 1;
+        in->timestamp = (uint64_t)i;
+        in->sequence = (int)i;
+    
+        const QueueItem *out = &ring[(i + LAYOUT_RING_ITEMS / 2) % LAYOUT_RING_ITEMS];
+        sum += out->value + out->priority + out->sequence + (long)out->timestamp;
+    }
+    
+    *checksum = sum;
+    return timing_now_ns() - begin;
+}
+
+/*
+ * layout: before/after rows for the cache-line split of the queue indices
+ * and for the item encoding (the "capacity" column is the ring size and the
+ * target names the bytes per item)
+ */
+static void bench_layout(long n_items) {
+    static SharedIndices shared;
+    static PaddedIndices padded;
+    long increments = n_items * 10;
+    
+    atomic_init(&shared.tail, 0);
+    atomic_init(&shared.head, 0);
+    layout_indices("indices_shared_line", &shared.tail, &shared.head, increments);
+    
+    atomic_init(&padded.tail, 0);
+    atomic_init(&padded.head, 0);
+    layout_indices("indices_padded", &padded.tail, &padded.head, increments);
+    
+    LegacyItem *legacy = (LegacyItem *)calloc(LAYOUT_RING_ITEMS, sizeof(LegacyItem));
+    QueueItem *current = (QueueItem *)calloc(LAYOUT_RING_ITEMS, sizeof(QueueItem));
+    if (legacy == NULL || current == NULL) {
+        fprintf(stderr, "Error: Failed to allocate layout rings\n");
+        free(legacy);
+        free(current);
+        return;
+    }
+    
+    // Touch every page once so the timed loops do not measure page faults
+    long checksum;
+    long stream_items = n_items * 10 > LAYOUT_RING_ITEMS ? n_items * 10 : LAYOUT_RING_ITEMS;
+    layout_stream_legacy(legacy, LAYOUT_RING_ITEMS, &checksum);
+    layout_stream_current(current, LAYOUT_RING_ITEMS, &checksum);
+    
+    char legacy_name[32];
+    char current_name[32];
+    snprintf(legacy_name, sizeof(legacy_name), "item_%zuB_legacy", sizeof(LegacyItem));
+    snprintf(current_name, sizeof(current_name), "item_%zuB%s", sizeof(QueueItem),
+             QUEUE_COMPACT_ITEMS ? "_compact" : "");
+    
+    BenchResult res = {
+        "layout", legacy_name, 1, 1, LAYOUT_RING_ITEMS, "-", 1, stream_items,
+        layout_stream_legacy(legacy, stream_items, &checksum), 1
+    };
+    print_result(&res);
+    
+    res.target = current_name;
+    res.elapsed_ns = layout_stream_current(current, stream_items, &checksum);
+    print_result(&res);
+    
+    free(legacy);
+    free(current);
+}
+
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cpus > 0 ? (int)cpus : 1;
+    long n_items = 200000;
+    const char *only = NULL;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "f:t:n:b:")) != -1) {
+        switch (opt) {
+            case 'f':
+                if (strcmp(optarg, "csv") == 0) {
+                    output_format = FORMAT_CSV;
+                } else if (strcmp(optarg, "json") == 0) {
+                    output_format = FORMAT_JSON;
+                } else {
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'n':
+                n_items = atol(optarg);
+                break;
+            case 'b':
+                only = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    
+    if (max_threads < 1 || n_items < 1) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    timing_init(TIMING_SOURCE_MONOTONIC);
+    
+    if (output_format == FORMAT_JSON) {
+        printf("[\n");
+    } else {
+        printf("bench,target,producers,consumers,capacity,mix,batch,ops,ns_per_op,ops_per_sec\n");
+    }
+    
+    if (only == NULL || strcmp(only, "enq_deq") == 0) {
+        bench_enq_deq(n_items);
+    }
+    if (only == NULL || strcmp(only, "find_high") == 0) {
+        bench_find_high(n_items);
+    }
+    if (only == NULL || strcmp(only, "mpmc") == 0) {
+        bench_mpmc(max_threads, n_items);
+    }
+    if (only == NULL || strcmp(only, "analytics") == 0) {
+        bench_analytics(max_threads, n_items);
+    }
+    if (only == NULL || strcmp(only, "layout") == 0) {
+        bench_layout(n_items);
+    }
+    
+    if (output_format == FORMAT_JSON) {
+        printf("\n]\n");
+    }
+    
+    return EXIT_SUCCESS;
+}
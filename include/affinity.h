@@ -0,0 +1,52 @@
+/*
+ * Affinity Header File
+ * CPU topology discovery (sysfs) and producer/consumer placement policies
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+
+// Thread placement policies (-A option)
+typedef enum {
+    AFFINITY_NONE = 0,      // Leave placement to the scheduler
+    AFFINITY_COMPACT,       // Fill CPUs in topology order: SMT siblings, cores, then nodes
+    AFFINITY_SCATTER,       // Spread threads over nodes and cores before sharing a core
+    AFFINITY_PAIR           // Producer i and consumer i on CPUs sharing an L2 (else L3)
+} AffinityPolicy;
+
+// One usable CPU and where it sits
+typedef struct {
+    int cpu;                // Logical CPU number
+    int package;            // Physical package (socket)
+    int core;               // Core id within the package
+    int node;               // NUMA node
+    int l2;                 // L2 sharing group (lowest CPU sharing the cache, -1 unknown)
+    int l3;                 // L3 sharing group (lowest CPU sharing the cache, -1 unknown)
+    int smt_rank;           // 0 for the first hardware thread of its core, 1 for the next...
+} AffinityCpu;
+
+// CPUs this process may run on, in compact (topology) order
+typedef struct {
+    AffinityCpu *cpus;
+    int n_cpus;
+    int n_packages;
+    int n_nodes;
+    int n_l2;               // Distinct L2 groups
+    int n_l3;               // Distinct L3 groups
+} AffinityTopology;
+
+// Function declarations
+int affinity_topology_load(AffinityTopology *topo);
+void affinity_topology_free(AffinityTopology *topo);
+int affinity_plan(const AffinityTopology *topo, AffinityPolicy policy,
+                  int n_producers, int n_consumers, int *producer_cpus, int *consumer_cpus);
+int affinity_node_of(const AffinityTopology *topo, int cpu);
+int affinity_attr_set_cpu(pthread_attr_t *attr, int cpu);
+void affinity_print(const AffinityTopology *topo, AffinityPolicy policy);
+int affinity_numa_available(void);
+const char* affinity_policy_name(AffinityPolicy policy);
+int affinity_policy_from_name(const char *name, AffinityPolicy *policy);
+
+#endif
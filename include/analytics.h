@@ -7,31 +7,151 @@
 #define ANALYTICS_H
 
 #include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "histogram.h"
+#include "payload.h"
 
-// Analytics structure - tracks system performance metrics
+// Priority classes with their own latency histogram
+typedef enum {
+    ANALYTICS_CLASS_HIGH = 0,       // PRIORITY_HIGH items
+    ANALYTICS_CLASS_NORMAL,         // PRIORITY_NORMAL items
+    ANALYTICS_CLASS_LOW,            // Everything else
+    ANALYTICS_CLASSES
+} AnalyticsClass;
+
+// Roles with their own blocked-time histogram
+typedef enum {
+    ANALYTICS_ROLE_PRODUCER = 0,    // Waits on a full queue
+    ANALYTICS_ROLE_CONSUMER,        // Waits on an empty queue
+    ANALYTICS_ROLES
+} AnalyticsRole;
+
+// Histograms of one counter slot, allocated when a thread claims the slot
+typedef struct {
+    LatencyHistogram latency[ANALYTICS_CLASSES];    // Latency (ns) per priority class
+    LatencyHistogram wait[ANALYTICS_ROLES];         // Blocked time (ns) per wait
+} AnalyticsSlotHistograms;
+
+// Per-thread counter slot - written only by the thread that claimed it
+// (relaxed atomic stores, no lock) and padded to its own cache line(s)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE)
+    atomic_long total_produced;     // Items produced
+    atomic_long total_consumed;     // Items consumed
+    atomic_long producer_blocks;    // Times producers blocked (queue full)
+    atomic_long consumer_blocks;    // Times consumers blocked (queue empty/starved)
+    atomic_long high_priority_consumed;
+    atomic_long normal_priority_consumed;
+    atomic_long low_priority_consumed;
+    atomic_long produce_batches;    // Successful batch writes
+    atomic_long consume_batches;    // Successful batch reads
+    atomic_long producer_wait_ns;   // Time producers spent blocked on a full queue
+    atomic_long consumer_wait_ns;   // Time consumers spent blocked on an empty queue
+    atomic_long total_latency_ns;   // Sum of latencies seen by this thread
+    atomic_long min_latency_ns;     // Minimum latency (-1 until first sample)
+    atomic_long max_latency_ns;     // Maximum latency
+    atomic_long drained;            // Items consumed during the drain phase
+    atomic_long payload_bytes;      // Payload body bytes consumed
+    atomic_long payload_stalls;     // Producer waits for a free payload slot
+    atomic_long producer_spins;     // Producer waits that ended while spinning
+    atomic_long producer_yields;    // ... while yielding the CPU
+    atomic_long producer_parks;     // ... parked on a condition variable
+    atomic_long consumer_spins;     // Consumer waits that ended while spinning
+    atomic_long consumer_yields;    // ... while yielding the CPU
+    atomic_long consumer_parks;     // ... parked on a condition variable
+    atomic_long scheduled;          // Scheduled arrivals handed to the queue
+    atomic_long schedule_lag_ns;    // Sum of their lag behind the schedule
+    atomic_long schedule_lag_max_ns;    // Largest lag
+    atomic_long schedule_late;      // Arrivals more than WORKLOAD_LATE_NS late
+    _Atomic(AnalyticsSlotHistograms *) hist;    // Set once the slot is claimed (NULL before)
+} AnalyticsSlot;
+
+// Totals merged from every slot at read time
 typedef struct {
     long total_produced;            // Total items produced
     long total_consumed;            // Total items consumed
     long producer_blocks;           // Times producers blocked (queue full)
     long consumer_blocks;           // Times consumers blocked (queue empty/starved)
-    double total_latency;           // Sum of all latencies
-    double min_latency;             // Minimum latency observed
-    double max_latency;             // Maximum latency observed
+    long producer_wait_ns;          // Total producer blocked time (ns)
+    long consumer_wait_ns;          // Total consumer blocked time (ns)
+    long total_latency_ns;          // Sum of all latencies (ns)
+    long min_latency_ns;            // Minimum latency observed (ns, -1 if none)
+    long max_latency_ns;            // Maximum latency observed (ns)
     long high_priority_consumed;    // Count of high priority items consumed
     long normal_priority_consumed;  // Count of normal priority items consumed
     long low_priority_consumed;     // Count of low priority items consumed
-    pthread_mutex_t mutex;          // Protects analytics data
+    long produce_batches;           // Number of successful batch writes
+    long consume_batches;           // Number of successful batch reads
+    long drained;                   // Items consumed during the drain phase
+    long payload_bytes;             // Payload body bytes consumed
+    long payload_stalls;            // Producer waits for a free payload slot
+    long producer_spins;            // Producer waits that ended while spinning
+    long producer_yields;           // Producer waits that ended while yielding
+    long producer_parks;            // Producer waits that parked
+    long consumer_spins;            // Consumer waits that ended while spinning
+    long consumer_yields;           // Consumer waits that ended while yielding
+    long consumer_parks;            // Consumer waits that parked
+    long scheduled;                 // Scheduled arrivals handed to the queue
+    long schedule_lag_ns;           // Sum of their lag behind the schedule (ns)
+    long schedule_lag_max_ns;       // Largest lag (ns)
+    long schedule_late;             // Arrivals more than WORKLOAD_LATE_NS late
+} AnalyticsTotals;
+
+// Per-shard counters of a sharded queue run, one cache line each
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_long produced;     // Items written to the shard
+    atomic_long consumed_local;     // Items taken by consumers homed on the shard
+    atomic_long stolen;             // Items taken by consumers of other shards
+    atomic_long steals;             // Dequeue operations that stole from the shard
+} AnalyticsShard;
+
+// Analytics structure - tracks system performance metrics
+typedef struct {
+    AnalyticsSlot *slots;           // ANALYTICS_MAX_SLOTS per-thread slots + 1 shared overflow slot
+    atomic_int slots_used;          // Slots claimed so far
+    unsigned long id;               // Unique instance id (keys the per-thread slot cache)
+    AnalyticsShard *shards;         // Per-shard counters (NULL unless sharded)
+    int n_shards;                   // Number of entries in shards
+    int drain_ran;                  // Non-zero once analytics_set_drain() reported a drain
+    int drain_deadline_hit;         // Drain ended by its deadline, not an empty queue
+    uint64_t drain_ns;              // Length of the drain phase (ns)
+    const PayloadPool *payload;     // Payload pool of the run (NULL = no bodies)
+    double offered_rate;            // Scheduled workload: items/s of all producers (0 = none)
+    int open_loop;                  // The schedule ignored backpressure
+    long shed;                      // Items the overflow policy discarded or evicted
+    pthread_mutex_t mutex;          // Serializes writers of the shared overflow slot only
 } Analytics;
 
 // Function declarations
 Analytics* analytics_init(void);
 void analytics_record_produce(Analytics *a);
-void analytics_record_consume(Analytics *a, double latency);
-void analytics_record_consume_priority(Analytics *a, int priority, double latency);
-void analytics_record_producer_block(Analytics *a);
-void analytics_record_consumer_block(Analytics *a);
+void analytics_record_produce_batch(Analytics *a, int count);
+void analytics_record_consume_batch(Analytics *a, int count);
+void analytics_record_consume(Analytics *a, uint64_t latency_ns);
+void analytics_record_consume_priority(Analytics *a, int priority, uint64_t latency_ns);
+void analytics_record_producer_block(Analytics *a, uint64_t wait_ns);
+void analytics_record_consumer_block(Analytics *a, uint64_t wait_ns);
+void analytics_record_wait_phases(Analytics *a, int role, int spins, int yields, int parks);
+int analytics_init_shards(Analytics *a, int n_shards);
+void analytics_record_shard_produce(Analytics *a, int shard, int count);
+void analytics_record_shard_consume(Analytics *a, int shard, int count, int stolen);
+void analytics_record_drain_batch(Analytics *a, int count);
+void analytics_set_drain(Analytics *a, uint64_t drain_ns, int deadline_hit);
+void analytics_set_payload_pool(Analytics *a, const PayloadPool *pool);
+void analytics_record_payload_consume(Analytics *a, long bytes);
+void analytics_record_payload_stall(Analytics *a);
+void analytics_set_offered_load(Analytics *a, double rate, int open_loop);
+void analytics_set_shed(Analytics *a, long shed);
+void analytics_record_schedule_lag(Analytics *a, int count, uint64_t lag_sum_ns,
+                                   uint64_t lag_max_ns, int late);
 void analytics_print_summary(Analytics *a, double runtime, int n_producers, int n_consumers);
+void analytics_print_benchmark(Analytics *a, double runtime, int n_producers, int n_consumers);
 void analytics_destroy(Analytics *a);
+void analytics_collect(Analytics *a, AnalyticsTotals *totals);
+void analytics_latency_histogram(Analytics *a, int cls, LatencyHistogram *out);
+void analytics_wait_histogram(Analytics *a, int role, LatencyHistogram *out);
 void analytics_get_snapshot(Analytics *a, long *produced, long *consumed, 
                             long *prod_blocks, long *cons_blocks);
 
@@ -16,11 +16,16 @@
 // Maximum wait period between Consumer reads (seconds)
 #define DEFAULT_MAX_CONSUMER_WAIT 4
 
-// Maximum number of Producers supported
-#define MAX_PRODUCERS 10
+// Maximum number of Producers supported (thread tables are sized at runtime;
+// this only bounds the command line)
+#define MAX_PRODUCERS 4096
 
 // Maximum number of Consumers supported
-#define MAX_CONSUMERS 5
+#define MAX_CONSUMERS 4096
+
+// Items moved per queue operation by Producers and Consumers (-b option)
+#define DEFAULT_BATCH_SIZE 1
+#define MAX_BATCH_SIZE 4096
 
 // Range of random numbers generated by Producer
 #define RANDOM_VALUE_MIN 0
@@ -34,6 +39,10 @@
 #define PRIORITY_NORMAL 5
 #define PRIORITY_HIGH 9
 
+// Number of distinct priority levels (0 .. PRIORITY_HIGH) tracked by the
+// bucket queue backend; priorities outside this range are clamped
+#define QUEUE_PRIORITY_LEVELS (PRIORITY_HIGH + 1)
+
 // ==============================================================================
 // DEBUG AND INSTRUMENTATION
 // ==============================================================================
@@ -41,16 +50,138 @@
 // Debug mode: Set to 1 to enable detailed logging, 0 to disable
 // When enabled, prints detailed information about queue operations,
 // thread activities, and internal state changes
+#ifndef DEBUG_MODE
 #define DEBUG_MODE 0
+#endif
+
+// Instrumentation: 1 times the queue critical sections, condition variable
+// signalling, sleeps and log output per thread and prints a breakdown at the
+// end of the run (make INSTRUMENT=1); 0 compiles the hooks out
+#ifndef INSTRUMENT_MODE
+#define INSTRUMENT_MODE 0
+#endif
+
+// Threads the instrumentation keeps a record for (later threads are not counted)
+#define INSTRUMENT_MAX_THREADS 1024
+
+// Longest thread name in the instrumentation report
+#define INSTRUMENT_NAME_LEN 24
+
+// Runtime verbosity of the thread output (-v option): 0 = quiet,
+// 1 = thread and blocking events, 2 = every item written and read
+#define DEFAULT_LOG_LEVEL 2
 
 // ==============================================================================
 // SYSTEM LIMITS
 // ==============================================================================
 
-// Maximum queue size allowed
-#define MAX_QUEUE_SIZE 20
+// Maximum queue size allowed (also the highest growth limit -G accepts)
+#define MAX_QUEUE_SIZE (16 * 1024 * 1024)
+
+// Growth limit of grow-on-demand mode unless one is given (-G): enough to
+// absorb bursts, small enough that a consumer side that has fallen behind
+// does not turn the queue into hundreds of MB (or seconds-long SCAN passes)
+#define QUEUE_GROW_LIMIT_DEFAULT (64 * 1024)
 
 // Minimum queue size allowed
 #define MIN_QUEUE_SIZE 1
 
+// Queue storage at least this large (bytes) is mmap'ed and backed by
+// hugepages when the system allows it; smaller storage is cache-line aligned
+#define QUEUE_LARGE_ALLOC_BYTES (2 * 1024 * 1024)
+#define QUEUE_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#define CACHE_LINE_SIZE 64
+
+// QueueItem encoding: 0 = 24-byte item with int fields, 1 = 16-byte item
+// with narrowed priority/producer_id/sequence (make COMPACT_ITEMS=1)
+#ifndef QUEUE_COMPACT_ITEMS
+#define QUEUE_COMPACT_ITEMS 0
+#endif
+
+// The compact item stores producer ids in 16 bits
+#if QUEUE_COMPACT_ITEMS && MAX_PRODUCERS > 32767
+#error "MAX_PRODUCERS does not fit the 16-bit producer_id of QUEUE_COMPACT_ITEMS"
+#endif
+
+// Queue backends compiled in (make BACKENDS="scan bucket lockfree spsc");
+// a backend set to 0 is rejected by queue_init_with() and its code paths
+// drop out of the build
+#ifndef QUEUE_WITH_SCAN
+#define QUEUE_WITH_SCAN 1
+#endif
+#ifndef QUEUE_WITH_BUCKET
+#define QUEUE_WITH_BUCKET 1
+#endif
+#ifndef QUEUE_WITH_LOCKFREE
+#define QUEUE_WITH_LOCKFREE 1
+#endif
+#ifndef QUEUE_WITH_SPSC
+#define QUEUE_WITH_SPSC 1
+#endif
+
+#if !(QUEUE_WITH_SCAN || QUEUE_WITH_BUCKET || QUEUE_WITH_LOCKFREE || QUEUE_WITH_SPSC)
+#error "At least one queue backend must be compiled in"
+#endif
+
+// Adaptive wait strategy (-W adaptive): spin budget bounds in pause
+// iterations, sched_yield rounds before parking, and the park length below
+// which a longer spin would have avoided the park
+#define QUEUE_SPIN_MIN 16
+#define QUEUE_SPIN_LIMIT_DEFAULT 1024
+#define QUEUE_YIELD_ROUNDS 4
+#define QUEUE_SPIN_SHORT_PARK_NS 20000
+
+// Aging dequeue policy (-Q aging): default wait that raises an item by one
+// priority level
+#define QUEUE_AGING_DEFAULT_NS 1000000
+
+// Per-thread analytics counter slots; threads beyond this share one
+// mutex-protected overflow slot
+#define ANALYTICS_MAX_SLOTS 1024
+
+// Shared-memory queue tools: capacity used when a tool creates the queue
+#define DEFAULT_SHM_QUEUE_SIZE 1024
+
+// Trace replay tool: queue capacity unless -n is given
+#define DEFAULT_REPLAY_QUEUE_SIZE 64
+
+// Workload spec (-L option): per-producer rate overrides, size of the
+// weighted value table (power of two), default burst length, how close to
+// an arrival producers busy-wait instead of sleeping, the sleep granularity
+// below which the stop condition is not worth waiting on, and the schedule
+// lag beyond which an item counts as late
+#define WORKLOAD_MAX_OVERRIDES 64
+#define WORKLOAD_VALUE_TABLE_SIZE 4096
+#define WORKLOAD_DEFAULT_BURST 16
+#define WORKLOAD_SPIN_NS 50000
+#define WORKLOAD_SLEEP_MIN_NS 2000000
+#define WORKLOAD_LATE_NS 1000000
+
+// A scheduled run counts as saturated when consumers reach less than this
+// fraction of the offered rate, or more than 1% of the arrivals are late
+#define WORKLOAD_SATURATED_FRACTION 0.95
+#define WORKLOAD_MAX_FILE_BYTES (64 * 1024)
+
+// Consumer pipeline (-X option): stages, workers per stage, stage name
+// length, and the per-worker busy fraction at which a stage is reported
+// as the bottleneck
+#define PIPELINE_MAX_STAGES 8
+#define PIPELINE_MAX_WORKERS 256
+#define PIPELINE_NAME_LEN 16
+#define PIPELINE_BOTTLENECK_BUSY 0.90
+
+// Payload pool (-P option): body sizes and the arena address space one size
+// class may reserve (pages are only committed when slots are first used)
+#define PAYLOAD_MIN_SIZE 64
+#define PAYLOAD_MAX_SIZE (64 * 1024)
+#define PAYLOAD_CLASS_MAX_BYTES (256UL * 1024 * 1024)
+
+// Trace mode (-T option): per-thread trace files grow by this many bytes
+#define TRACE_CHUNK_BYTES (4 * 1024 * 1024)
+
+// Asynchronous logger: records buffered per thread (power of two) and the
+// number of thread rings; threads beyond this log synchronously
+#define LOGGER_RING_SIZE 4096
+#define LOGGER_MAX_RINGS 1024
+
 #endif
@@ -6,20 +6,34 @@
 #ifndef CONSUMER_H
 #define CONSUMER_H
 
+#include <stdint.h>
+#include "config.h"
 #include "queue.h"
+#include "shard.h"
 #include "analytics.h"
+#include "payload.h"
+#include "pipeline.h"
 
-// Consumer thread arguments structure
+// Consumer thread arguments structure - one per thread, padded to its own
+// cache line(s) so neighbouring entries of the argument table never share one
 typedef struct {
+    _Alignas(CACHE_LINE_SIZE)
     int id;                         // Consumer ID (1, 2, 3, ...)
-    Queue *queue;                   // Pointer to shared queue
+    Queue *queue;                   // Pointer to shared queue (home shard when sharded)
+    ShardedQueue *shards;           // Sharded mode: set of shard queues (NULL = single queue)
+    int shard;                      // Sharded mode: home shard index
     int max_wait;                   // Maximum wait time between reads
-    volatile int *timeout_flag;     // Pointer to global timeout flag
     Analytics *analytics;           // Pointer to analytics structure
+    int batch_size;                 // Items moved per queue operation
+    int bench_mode;                 // Non-zero: no sleeps and no per-item output
+    uint64_t pace_ns;               // Bench mode: pause between reads (0 = tight loop)
+    int pace_spin;                  // Bench mode: busy-wait the pause instead of sleeping
+    PayloadPool *payload;           // Payload mode: pool the bodies are released to
+    const char *trace_dir;          // Trace mode: directory for this thread's file (NULL = off)
+    Pipeline *pipeline;             // Pipeline mode: stages the items are handed to (NULL = none)
 } ConsumerArgs;
 
 // Function declarations
 void* consumer_thread(void *args);
-int queue_is_empty_check(Queue *q);
 
 #endif
@@ -0,0 +1,38 @@
+/*
+ * Histogram Header File
+ * Fixed-memory log-linear latency histogram (HDR-style)
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Each power of two is split into 2^HISTOGRAM_SUB_BITS linear sub-buckets,
+// giving a relative error below 1 / 2^HISTOGRAM_SUB_BITS (about 3%)
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+
+// Largest tracked magnitude: values up to 2^(HISTOGRAM_MAX_MAGNITUDE + 1) - 1
+// nanoseconds (about 73 minutes); larger values land in the last bucket
+#define HISTOGRAM_MAX_MAGNITUDE 41
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_MAGNITUDE - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_COUNT)
+
+// Histogram of nanosecond values - recording is one relaxed atomic add
+typedef struct {
+    atomic_ulong counts[HISTOGRAM_BUCKETS];     // Samples per bucket
+    atomic_ulong max;                           // Exact largest sample
+} LatencyHistogram;
+
+// Function declarations
+void histogram_reset(LatencyHistogram *h);
+void histogram_record(LatencyHistogram *h, uint64_t value);
+void histogram_record_owned(LatencyHistogram *h, uint64_t value);
+void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src);
+void histogram_subtract(LatencyHistogram *dst, const LatencyHistogram *src);
+uint64_t histogram_count(const LatencyHistogram *h);
+uint64_t histogram_percentile(const LatencyHistogram *h, double percentile);
+uint64_t histogram_max(const LatencyHistogram *h);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Instrumentation Header File
+ * Opt-in per-thread timing of the queue critical sections, condition
+ * variable signalling, sleeps and log output, with optional hardware
+ * counters; the hooks compile to the plain calls unless INSTRUMENT_MODE is 1
+ */
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
+#include "timing.h"
+
+// Timed activities
+typedef enum {
+    INSTRUMENT_LOCK_WAIT = 0,       // Acquiring a queue mutex (items = contended acquisitions)
+    INSTRUMENT_LOCK_HOLD,           // Holding it, condition variable waits excluded
+    INSTRUMENT_COND_WAIT,           // Parked on a queue condition variable
+    INSTRUMENT_SIGNAL,              // pthread_cond_signal/broadcast calls (items = broadcasts)
+    INSTRUMENT_SCAN,                // find_highest_priority_index (items = slots scanned)
+    INSTRUMENT_SHIFT,               // remove_at_index (items = items shifted)
+    INSTRUMENT_SLEEP,               // Sleeps and timed pauses
+    INSTRUMENT_LOG,                 // Submitting thread output to the logger
+    INSTRUMENT_KINDS
+} InstrumentKind;
+
+// Hardware counters read with perf_event_open
+typedef enum {
+    INSTRUMENT_PERF_CYCLES = 0,
+    INSTRUMENT_PERF_INSTRUCTIONS,
+    INSTRUMENT_PERF_CACHE_MISSES,
+    INSTRUMENT_PERF_COUNTERS
+} InstrumentPerf;
+
+// Per-thread record - written only by its thread, read once it has ended
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE)
+    char name[INSTRUMENT_NAME_LEN];
+    uint64_t start_ns;              // instrument_thread_begin()
+    uint64_t end_ns;                // instrument_thread_end() (0 = still running)
+    uint64_t count[INSTRUMENT_KINDS];
+    uint64_t ns[INSTRUMENT_KINDS];
+    uint64_t items[INSTRUMENT_KINDS];
+    uint64_t max_ns[INSTRUMENT_KINDS];
+    uint64_t hold_start_ns;         // Acquisition time of the mutex being held
+    int perf_fd[INSTRUMENT_PERF_COUNTERS];      // -1 = counter not open
+    uint64_t perf[INSTRUMENT_PERF_COUNTERS];    // Scaled counts read at the end
+    int perf_valid[INSTRUMENT_PERF_COUNTERS];
+} InstrumentThread;
+
+// Function declarations
+int instrument_init(int perf_counters);
+void instrument_thread_begin(const char *role, int id);
+void instrument_thread_end(void);
+void instrument_add(InstrumentKind kind, uint64_t start_ns, uint64_t items);
+void instrument_lock(pthread_mutex_t *mutex);
+void instrument_unlock(pthread_mutex_t *mutex);
+void instrument_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int instrument_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                              const struct timespec *deadline);
+void instrument_cond_signal(pthread_cond_t *cond, int broadcast);
+void instrument_print_report(double runtime);
+void instrument_shutdown(void);
+
+// Hooks - with INSTRUMENT_MODE 0 they are the plain calls (or nothing)
+#if INSTRUMENT_MODE
+#define INSTRUMENT_BEGIN(var)               uint64_t var = timing_now_ns()
+#define INSTRUMENT_END(kind, var, items)    instrument_add((kind), (var), (uint64_t)(items))
+#define INSTRUMENT_MUTEX_LOCK(m)            instrument_lock(m)
+#define INSTRUMENT_MUTEX_UNLOCK(m)          instrument_unlock(m)
+#define INSTRUMENT_COND_WAIT(c, m)          instrument_cond_wait((c), (m))
+#define INSTRUMENT_COND_TIMEDWAIT(c, m, t)  instrument_cond_timedwait((c), (m), (t))
+#define INSTRUMENT_COND_SIGNAL(c)           instrument_cond_signal((c), 0)
+#define INSTRUMENT_COND_BROADCAST(c)        instrument_cond_signal((c), 1)
+#define INSTRUMENT_THREAD_BEGIN(role, id)   instrument_thread_begin((role), (id))
+#define INSTRUMENT_THREAD_END()             instrument_thread_end()
+#else
+#define INSTRUMENT_BEGIN(var)               ((void)0)
+#define INSTRUMENT_END(kind, var, items)    ((void)0)
+#define INSTRUMENT_MUTEX_LOCK(m)            pthread_mutex_lock(m)
+#define INSTRUMENT_MUTEX_UNLOCK(m)          pthread_mutex_unlock(m)
+#define INSTRUMENT_COND_WAIT(c, m)          pthread_cond_wait((c), (m))
+#define INSTRUMENT_COND_TIMEDWAIT(c, m, t)  pthread_cond_timedwait((c), (m), (t))
+#define INSTRUMENT_COND_SIGNAL(c)           pthread_cond_signal(c)
+#define INSTRUMENT_COND_BROADCAST(c)        pthread_cond_broadcast(c)
+#define INSTRUMENT_THREAD_BEGIN(role, id)   ((void)0)
+#define INSTRUMENT_THREAD_END()             ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Logger Header File
+ * Asynchronous thread output: per-thread record rings, one writer thread
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "queue.h"
+#include "config.h"
+
+// Verbosity levels (higher levels include the lower ones)
+typedef enum {
+    LOG_LEVEL_QUIET = 0,    // No output from worker threads
+    LOG_LEVEL_EVENTS,       // Thread start/stop, BLOCKED and STARVED
+    LOG_LEVEL_ITEMS         // Every WRITE and READ
+} LogLevel;
+
+// Current verbosity; read on every log call, set once by logger_init
+extern LogLevel log_level;
+
+// Function declarations
+int logger_init(LogLevel level, FILE *out);
+void logger_shutdown(void);
+
+// Worker thread messages (formatted later by the writer thread)
+void log_producer_start(int producer_id);
+void log_producer_stop(int producer_id, int produced);
+void log_write(int producer_id, const QueueItem *item, int queue_size);
+void log_producer_blocked(int producer_id);
+void log_consumer_start(int consumer_id);
+void log_consumer_stop(int consumer_id, int consumed);
+void log_read(int consumer_id, const QueueItem *item, uint64_t latency_ns, int queue_size);
+void log_consumer_starved(int consumer_id);
+
+/*
+ * Check whether messages of the given level are printed
+ */
+static inline int log_enabled(LogLevel level) {
+    return log_level >= level;
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Payload Header File
+ * Preallocated size-class slab pool for message bodies: producers reserve
+ * a slot, write the body in place and commit; the queue carries only the
+ * 32-bit slot reference and consumers release the slot when done
+ */
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+
+// Slot reference: size class in the top bits, slot index below
+#define PAYLOAD_NONE UINT32_MAX
+#define PAYLOAD_CLASS_SHIFT 27
+#define PAYLOAD_SLOT_MASK ((1u << PAYLOAD_CLASS_SHIFT) - 1)
+
+// Size classes: powers of two from PAYLOAD_MIN_SIZE to PAYLOAD_MAX_SIZE
+#define PAYLOAD_CLASSES 11
+
+// One size class: a contiguous arena of equal slots and a free list
+typedef struct {
+    size_t slot_size;               // Bytes per slot (power of two)
+    uint32_t n_slots;               // Slots in the arena (0 = class unused)
+    unsigned char *arena;           // n_slots * slot_size bytes
+    size_t arena_bytes;             // Mapped size (queue_storage_free)
+    _Atomic uint32_t *next;         // Free-list links, one per slot
+    uint32_t *lengths;              // Committed body length per slot
+
+    // Free-list head: ABA tag in the high 32 bits, slot index below
+    _Alignas(CACHE_LINE_SIZE)
+    _Atomic uint64_t free_head;
+
+    // Usage, updated on reserve/release
+    _Alignas(CACHE_LINE_SIZE)
+    atomic_long in_use;             // Slots currently reserved
+    atomic_long peak_in_use;        // Highest in_use seen
+    atomic_long reserved;           // Successful reservations
+    atomic_long exhausted;          // Reservations refused (class full)
+} PayloadClass;
+
+// The pool: one class per power of two in [min_size, max_size]
+typedef struct {
+    PayloadClass classes[PAYLOAD_CLASSES];
+    size_t min_size;                // Smallest body size requested
+    size_t max_size;                // Largest body size requested
+} PayloadPool;
+
+// Usage of one class (for reports)
+typedef struct {
+    size_t slot_size;
+    uint32_t n_slots;
+    long in_use;
+    long peak_in_use;
+    long reserved;
+    long exhausted;
+} PayloadClassStats;
+
+// Function declarations
+PayloadPool* payload_pool_init(size_t min_size, size_t max_size, uint32_t slots_per_class,
+                               int numa_node);
+void payload_pool_destroy(PayloadPool *pool);
+void* payload_reserve(PayloadPool *pool, size_t size, uint32_t *ref);
+void payload_commit(PayloadPool *pool, uint32_t ref, size_t length);
+const void* payload_data(const PayloadPool *pool, uint32_t ref, size_t *length);
+void payload_release(PayloadPool *pool, uint32_t ref);
+int payload_pool_class_stats(const PayloadPool *pool, int cls, PayloadClassStats *stats);
+int payload_parse_sizes(const char *spec, size_t *min_size, size_t *max_size);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Pipeline Header File
+ * Consumer-side processing pipeline: stages run in order, each with its
+ * own input Queue, worker threads and Analytics
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "queue.h"
+#include "analytics.h"
+
+// Work of one stage on a batch of items, done in place before the items
+// move on to the next stage (NULL = busy-wait work_ns per item)
+typedef void (*PipelineStageFn)(QueueItem *items, int count, void *arg);
+
+// Description of one stage
+typedef struct {
+    char name[PIPELINE_NAME_LEN];   // Shown in the summary
+    int workers;                    // Worker threads of the stage
+    uint64_t work_ns;               // Built-in work: CPU time per item
+    PipelineStageFn fn;             // Custom work (NULL = built-in)
+    void *arg;                      // Passed to fn
+} PipelineStageSpec;
+
+struct PipelineStage;
+
+// Worker thread state - one per thread, padded to its own cache line(s);
+// the depth and busy-time counters are written only by their worker
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE)
+    struct PipelineStage *stage;    // Stage the worker belongs to
+    int id;                         // Worker index within the stage
+    long depth_sum;                 // Sum of input queue depths seen after each read
+    long depth_samples;             // Number of reads sampled
+    int depth_max;                  // Deepest input queue seen
+    uint64_t busy_ns;               // Time spent in the stage's work
+} PipelineWorker;
+
+// One stage: its input queue and the workers reading it
+typedef struct PipelineStage {
+    PipelineStageSpec spec;
+    int index;                      // Position in the pipeline (0 = first)
+    Queue *queue;                   // Input queue (written by the previous stage)
+    Queue *next;                    // Input queue of the next stage (NULL = last stage)
+    atomic_long *in_flight;         // Pipeline's count of items not yet out of the last stage
+    Analytics *analytics;           // Per-stage metrics (latency = time in this stage)
+    int batch_size;                 // Items moved per queue operation
+    pthread_t *threads;
+    PipelineWorker *workers;        // Cache-line aligned entries
+    int started;                    // Worker threads created
+} PipelineStage;
+
+// Pipeline - the stages plus the counters of the hand-off into the first
+typedef struct {
+    PipelineStage *stages;
+    int n_stages;
+    atomic_long in_flight;          // Items submitted that have not left the last stage
+    atomic_long entered;            // Items taken by pipeline_submit() so far
+    atomic_long entry_blocks;       // Submits that waited for space in the first stage
+    atomic_long entry_wait_ns;      // Time they waited
+} Pipeline;
+
+// Function declarations
+int pipeline_parse_spec(const char *text, PipelineStageSpec *specs, int max_stages);
+Pipeline* pipeline_create(const PipelineStageSpec *specs, int n_stages,
+                          const QueueOptions *opts, int n_submitters, int batch_size);
+int pipeline_start(Pipeline *p);
+int pipeline_submit(Pipeline *p, QueueItem *items, int n);
+int pipeline_idle(Pipeline *p);
+long pipeline_entered(Pipeline *p);
+void pipeline_close(Pipeline *p);
+void pipeline_join(Pipeline *p);
+void pipeline_print_summary(Pipeline *p, double runtime);
+void pipeline_destroy(Pipeline *p);
+
+#endif
@@ -7,35 +7,221 @@
 #define QUEUE_H
 
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
 
 // Queue item structure - represents one message in the queue
+// The timestamp comes first so the item has no interior padding (24 bytes,
+// including the reference to an optional payload body - see payload.h);
+// building with QUEUE_COMPACT_ITEMS=1 narrows the small fields to 16 bytes,
+// so four items share a cache line (needs producer ids below 32768, and
+// leaves no room for a payload reference)
+#if QUEUE_COMPACT_ITEMS
+#define QUEUE_ITEM_PAYLOAD 0
 typedef struct {
-    int value;           // Random data value (0-9)
-    int priority;        // Priority level (0, 5, or 9)
+    uint64_t timestamp;  // When it was produced, ns from timing_now_ns() (for latency)
+    int32_t sequence;    // Sequence number from this producer
+    int16_t producer_id; // Which producer created this item
+    int8_t priority;     // Priority level (0, 5, or 9)
+    int8_t value;        // Random data value (0-9)
+} QueueItem;
+_Static_assert(sizeof(QueueItem) == 16, "compact QueueItem must be 16 bytes");
+#else
+#define QUEUE_ITEM_PAYLOAD 1
+typedef struct {
+    uint64_t timestamp;  // When it was produced, ns from timing_now_ns() (for latency)
+    int16_t value;       // Random data value (0-9)
+    int16_t priority;    // Priority level (0, 5, or 9)
     int producer_id;     // Which producer created this item
-    double timestamp;    // When it was produced (for latency calculation)
     int sequence;        // Sequence number from this producer
+    uint32_t payload;    // Payload pool slot reference (PAYLOAD_NONE = no body)
 } QueueItem;
+_Static_assert(sizeof(QueueItem) == 24, "QueueItem must be 24 bytes");
+#endif
 
-// Queue structure - circular buffer with synchronization
+// How long a queue call was blocked on not_full / not_empty, and how each
+// wait ended (see QueueWaitStrategy)
+typedef struct {
+    int waited;                 // Non-zero if the call had to wait at least once
+    uint64_t wait_ns;           // Total time spent waiting (ns)
+    int spins;                  // Waits that ended while spinning
+    int yields;                 // Waits that ended while yielding the CPU
+    int parks;                  // Waits that parked on a condition variable
+} QueueWaitInfo;
+
+// What a thread does when the queue is full (producers) or empty (consumers)
+typedef enum {
+    QUEUE_WAIT_PARK = 0,        // Park on the condition variable at once
+    QUEUE_WAIT_ADAPTIVE         // Spin, then sched_yield, then park; the spin
+                                // budget follows recent wait durations
+} QueueWaitStrategy;
+
+// Which priority level a dequeue serves (BUCKET backend; the others are
+// strict (SCAN) or FIFO (LOCKFREE, SPSC))
+typedef enum {
+    QUEUE_POLICY_STRICT = 0,    // Highest non-empty level; low levels can starve
+    QUEUE_POLICY_AGING,         // Level + wait / aging_ns of each level's oldest item
+    QUEUE_POLICY_DRR            // Deficit round-robin, level p serves p + 1 items per round
+} QueueDequeuePolicy;
+
+// What an enqueue does when the queue is full (and cannot grow)
+typedef enum {
+    QUEUE_OVERFLOW_BLOCK = 0,       // Wait for space (or until the deadline / close)
+    QUEUE_OVERFLOW_DROP_NEWEST,     // Discard the item being enqueued
+    QUEUE_OVERFLOW_DROP_LOWEST,     // Evict the oldest lowest-priority item if it ranks
+                                    // below the new one, else discard the new one
+    QUEUE_OVERFLOW_OVERWRITE_OLDEST // Evict the item that has been queued longest
+} QueueOverflowPolicy;
+
+// Deadline of the blocking calls that wait until the queue is closed
+#define QUEUE_NO_DEADLINE UINT64_MAX
+
+// Storage backend - selects how the highest priority item is located
+typedef enum {
+    QUEUE_BACKEND_SCAN = 0,     // Single ring, linear scan + shift on dequeue (O(n))
+    QUEUE_BACKEND_BUCKET,       // Per-priority FIFO lists selected by a bitmap (O(1))
+    QUEUE_BACKEND_LOCKFREE,     // Lock-free bounded MPMC ring, FIFO only (ignores priority)
+    QUEUE_BACKEND_SPSC          // Wait-free ring for one producer and one consumer, FIFO only
+} QueueBackend;
+
+// Backend used unless one is chosen: the first one compiled in
+#if QUEUE_WITH_SCAN
+#define QUEUE_BACKEND_DEFAULT QUEUE_BACKEND_SCAN
+#elif QUEUE_WITH_BUCKET
+#define QUEUE_BACKEND_DEFAULT QUEUE_BACKEND_BUCKET
+#elif QUEUE_WITH_LOCKFREE
+#define QUEUE_BACKEND_DEFAULT QUEUE_BACKEND_LOCKFREE
+#else
+#define QUEUE_BACKEND_DEFAULT QUEUE_BACKEND_SPSC
+#endif
+
+// Options used to create a queue
 typedef struct {
+    int capacity;               // Maximum size of queue
+    QueueBackend backend;       // Storage backend
+    int grow;                   // Non-zero: double the storage instead of blocking when full
+    int max_capacity;           // Growth limit when grow is set (0 = QUEUE_GROW_LIMIT_DEFAULT)
+    int numa_node;              // NUMA node for the storage (-1 = first touch; needs libnuma)
+    QueueWaitStrategy wait_strategy;    // Blocking behaviour when full / empty
+    int spin_limit;             // ADAPTIVE: largest spin budget (pause iterations)
+    QueueDequeuePolicy policy;  // Level selection of the BUCKET backend
+    uint64_t aging_ns;          // AGING: wait that is worth one priority level
+    QueueOverflowPolicy overflow;   // Producer behaviour when full
+} QueueOptions;
+
+struct QueueOps;
+struct LockFreeCell;
+struct SpscIndices;
+
+// Queue structure - circular buffer with synchronization
+// Fields are grouped by who writes them: the read-mostly configuration, the
+// producer side, the consumer side, the parking counters and the lock each
+// start on their own cache line, so producers advancing the tail and
+// consumers advancing the head do not invalidate each other's line
+typedef struct Queue {
+    const struct QueueOps *ops; // Backend operations (see queue_backend.h)
     QueueItem *items;           // Array of queue items
     int capacity;               // Maximum size of queue
-    int size;                   // Current number of items
-    int head;                   // Index of front item (for dequeue)
-    int tail;                   // Index where next item will be added
+    QueueBackend backend;       // Storage backend in use
+    int grow;                   // Grow-on-demand enabled
+    int max_capacity;           // Capacity limit for growth
+    int grow_count;             // Number of times the storage was doubled
+    int numa_node;              // NUMA node the storage is bound to (-1 = none)
+    QueueWaitStrategy wait_strategy;    // Blocking behaviour when full / empty
+    int spin_limit;             // ADAPTIVE: largest spin budget (pause iterations)
+    QueueOverflowPolicy overflow;   // Producer behaviour when full
+    atomic_int closed;          // Set once by queue_close(); enqueues then fail,
+                                // dequeues fail once the queue is empty
+    size_t items_bytes;         // Allocated size of items[] (for unmapping)
+    size_t next_bytes;          // Allocated size of next[] (for unmapping)
+
+    // BUCKET backend: items[] is a slot pool, linked into per-priority FIFOs
+    int *next;                              // Next slot in the same list, -1 terminates
+    int free_head;                          // First unused slot
+    int level_head[QUEUE_PRIORITY_LEVELS];  // Oldest slot of each priority level
+    int level_tail[QUEUE_PRIORITY_LEVELS];  // Newest slot of each priority level
+    unsigned int level_bitmap;              // Bit p set when level p is non-empty
+    QueueDequeuePolicy policy;              // Level selection policy
+    uint64_t aging_ns;                      // AGING: wait worth one priority level
+    int drr_level;                          // DRR: level being served in this round
+    int drr_credit;                         // DRR: items it may still take this round
+
+    // LOCKFREE backend: Vyukov ring, one sequence number per cell
+    struct LockFreeCell *cells;             // Ring cells
+    size_t cells_bytes;                     // Allocated size of cells[] (for unmapping)
+
+    // SPSC backend: items[] is the ring, indices live on their own cache lines
+    struct SpscIndices *spsc;               // Head/tail and cached copies
+
+    // Producer side
+    _Alignas(CACHE_LINE_SIZE)
+    int tail;                               // Index where next item will be added
+    atomic_size_t enqueue_pos;              // LOCKFREE: next position to claim for enqueue
+    atomic_int producer_spin;               // ADAPTIVE: current spin budget of producers
+    atomic_long shed;                       // Items discarded or evicted by the overflow policy
+
+    // Consumer side
+    _Alignas(CACHE_LINE_SIZE)
+    int head;                               // Index of front item (for dequeue)
+    atomic_size_t dequeue_pos;              // LOCKFREE: next position to claim for dequeue
+    atomic_int consumer_spin;               // ADAPTIVE: current spin budget of consumers
+
+    // Parking counters: written only around a park, read by the other side
+    _Alignas(CACHE_LINE_SIZE)
+    atomic_int waiting_producers;           // Producers parked on not_full (LOCKFREE, SPSC)
+    atomic_int waiting_consumers;           // Consumers parked on not_empty (LOCKFREE, SPSC)
+
+    // Lock and the state only changed while holding it
+    _Alignas(CACHE_LINE_SIZE)
     pthread_mutex_t mutex;      // Protects queue data structure
+    atomic_int size;            // Current number of items (stored under the lock,
+                                // loaded without it by queue_get_size_approx)
+    atomic_int live_capacity;   // Copy of capacity for the same unlocked readers
+                                // (stored under the lock when the queue grows)
+    int batch_waiters;          // Dequeuers waiting for more than one item
     pthread_cond_t not_full;    // Condition variable: signals when space available
     pthread_cond_t not_empty;   // Condition variable: signals when data available
 } Queue;
 
 // Function declarations
 Queue* queue_init(int capacity);
+Queue* queue_init_with(const QueueOptions *opts);
+void queue_options_default(QueueOptions *opts, int capacity);
 int queue_enqueue(Queue *q, QueueItem item);
 int queue_dequeue(Queue *q, QueueItem *item);
+int queue_try_enqueue(Queue *q, QueueItem item);
+int queue_try_dequeue(Queue *q, QueueItem *item);
+int queue_enqueue_timed(Queue *q, QueueItem item, uint64_t deadline_ns);
+int queue_dequeue_timed(Queue *q, QueueItem *item, uint64_t deadline_ns);
+int queue_enqueue_batch(Queue *q, const QueueItem *items, int n, QueueWaitInfo *wait);
+int queue_dequeue_batch(Queue *q, QueueItem *items, int max, int min, QueueWaitInfo *wait);
+int queue_enqueue_batch_timed(Queue *q, const QueueItem *items, int n, uint64_t deadline_ns,
+                              QueueWaitInfo *wait);
+int queue_dequeue_batch_timed(Queue *q, QueueItem *items, int max, int min,
+                              uint64_t deadline_ns, QueueWaitInfo *wait);
+int queue_try_dequeue_batch(Queue *q, QueueItem *items, int max);
+int queue_peek_priority(Queue *q);
 void queue_destroy(Queue *q);
 int queue_is_full(Queue *q);
 int queue_is_empty(Queue *q);
 int queue_get_size(Queue *q);
+int queue_get_size_approx(Queue *q);
+int queue_get_capacity(Queue *q);
+long queue_get_shed(Queue *q);
+void queue_close(Queue *q);
+int queue_is_closed(Queue *q);
+
+// Backend name helpers (for command line parsing and reports)
+const char* queue_backend_name(QueueBackend backend);
+int queue_backend_from_name(const char *name, QueueBackend *backend);
+int queue_backend_available(QueueBackend backend);
+const char* queue_wait_strategy_name(QueueWaitStrategy strategy);
+int queue_wait_strategy_from_name(const char *name, QueueWaitStrategy *strategy, int *spin_limit);
+const char* queue_policy_name(QueueDequeuePolicy policy);
+int queue_policy_from_name(const char *name, QueueDequeuePolicy *policy, uint64_t *aging_ns);
+const char* queue_overflow_name(QueueOverflowPolicy overflow);
+int queue_overflow_from_name(const char *name, QueueOverflowPolicy *overflow);
 
 #endif
@@ -0,0 +1,189 @@
+/*
+ * Queue Backend Header File
+ * Internal interface implemented by each queue storage backend
+ */
+
+#ifndef QUEUE_BACKEND_H
+#define QUEUE_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "queue.h"
+#include "timing.h"
+#include "instrument.h"
+
+// Backend operations table - the public queue_* calls dispatch through it
+// enqueue/dequeue move batches; the single-item API passes n = 1
+// They wait until deadline_ns (timing_now_ns clock; QUEUE_NO_DEADLINE = until
+// the queue is closed, a past deadline = not at all); enqueue counts items
+// shed by the overflow policy as taken
+// wait is never NULL and starts zeroed; backends add the time they block
+typedef struct QueueOps {
+    int  (*init)(Queue *q);                                         // Allocate storage
+    void (*destroy)(Queue *q);                                      // Release storage
+    int  (*enqueue)(Queue *q, const QueueItem *items, int n,        // Blocking, returns count
+                    uint64_t deadline_ns, QueueWaitInfo *wait);
+    int  (*dequeue)(Queue *q, QueueItem *items, int max, int min,   // Blocking, returns count
+                    uint64_t deadline_ns, QueueWaitInfo *wait);
+    int  (*try_dequeue)(Queue *q, QueueItem *items, int max);       // Non-blocking, returns count
+    int  (*peek_priority)(Queue *q);                                // Next item's priority, -1 empty
+    int  (*size)(Queue *q);                                         // Current number of items
+    int  (*grow)(Queue *q);                                         // Double storage (NULL = none)
+} QueueOps;
+
+// Backend tables
+extern const QueueOps queue_ops_mutex;      // SCAN and BUCKET
+extern const QueueOps queue_ops_lockfree;   // LOCKFREE
+extern const QueueOps queue_ops_spsc;       // SPSC
+
+// Storage helpers shared by the backends
+void* queue_storage_alloc(size_t size, int node, size_t *bytes);
+void queue_storage_free(void *ptr, size_t bytes);
+
+/*
+ * The queue has been closed (blocking calls must return)
+ */
+static inline int queue_closed(Queue *q) {
+    return atomic_load_explicit(&q->closed, memory_order_acquire);
+}
+
+/*
+ * deadline_ns has passed (never for QUEUE_NO_DEADLINE, so the common case
+ * reads no clock)
+ */
+static inline int queue_deadline_passed(uint64_t deadline_ns) {
+    return deadline_ns != QUEUE_NO_DEADLINE && timing_now_ns() >= deadline_ns;
+}
+
+/*
+ * Park on cond (q->mutex held) until woken or until deadline_ns
+ * The condition variables use CLOCK_MONOTONIC; the deadline is moved onto
+ * it from the timing clock, which may be the cycle counter
+ */
+static inline void queue_park(Queue *q, pthread_cond_t *cond, uint64_t deadline_ns) {
+    if (deadline_ns == QUEUE_NO_DEADLINE) {
+        INSTRUMENT_COND_WAIT(cond, &q->mutex);
+        return;
+    }
+    
+    uint64_t now = timing_now_ns();
+    uint64_t left = deadline_ns > now ? deadline_ns - now : 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t abs_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec + left;
+    ts.tv_sec = (time_t)(abs_ns / 1000000000ULL);
+    ts.tv_nsec = (long)(abs_ns % 1000000000ULL);
+    INSTRUMENT_COND_TIMEDWAIT(cond, &q->mutex, &ts);
+}
+
+/*
+ * Account for a wait that started at start_ns (as returned by timing_now_ns)
+ */
+static inline void queue_wait_end(QueueWaitInfo *wait, uint64_t start_ns) {
+    uint64_t now = timing_now_ns();
+    wait->waited = 1;
+    wait->wait_ns += now > start_ns ? now - start_ns : 0;
+}
+
+/*
+ * Move an ADAPTIVE spin budget a quarter of the way towards target,
+ * within [QUEUE_SPIN_MIN, spin_limit]
+ */
+static inline void queue_spin_adapt(Queue *q, atomic_int *budget, int target) {
+    int current = atomic_load_explicit(budget, memory_order_relaxed);
+    int next = current + (target - current) / 4;
+    if (next < QUEUE_SPIN_MIN) {
+        next = QUEUE_SPIN_MIN;
+    }
+    if (next > q->spin_limit) {
+        next = q->spin_limit;
+    }
+    atomic_store_explicit(budget, next, memory_order_relaxed);
+}
+
+/*
+ * ADAPTIVE strategy, before parking: poll ready(q, arg) for up to
+ * *budget pause iterations, then for QUEUE_YIELD_ROUNDS sched_yield()
+ * rounds. ready() must also return true once the queue is closed.
+ * A wait that ends while spinning pulls the budget towards twice the
+ * spins it took; one that ends while yielding pushes it up if the wait was
+ * short, down otherwise. The time spent counts as waiting.
+ * Returns 1 if ready() became true (retry without parking), 0 to park
+ * (always 0 under QUEUE_WAIT_PARK)
+ */
+static inline int queue_spin_wait(Queue *q, atomic_int *budget, int (*ready)(Queue *, void *),
+                                  void *arg, QueueWaitInfo *wait) {
+    if (q->wait_strategy != QUEUE_WAIT_ADAPTIVE) {
+        return 0;
+    }
+    
+    uint64_t start = timing_now_ns();
+    int limit = atomic_load_explicit(budget, memory_order_relaxed);
+    for (int i = 0; i < limit; i++) {
+        if (ready(q, arg)) {
+            queue_spin_adapt(q, budget, 2 * i);
+            wait->spins++;
+            queue_wait_end(wait, start);
+            return 1;
+        }
+        cpu_relax();
+    }
+    
+    for (int y = 0; y < QUEUE_YIELD_ROUNDS; y++) {
+        sched_yield();
+        if (ready(q, arg)) {
+            queue_spin_adapt(q, budget, timing_now_ns() - start < QUEUE_SPIN_SHORT_PARK_NS ?
+                                        q->spin_limit : 0);
+            wait->yields++;
+            queue_wait_end(wait, start);
+            return 1;
+        }
+    }
+    
+    queue_wait_end(wait, start);
+    return 0;
+}
+
+/*
+ * Account for a park that started at start_ns. ADAPTIVE: a short park
+ * means a longer spin would have caught the wakeup, so the budget grows;
+ * a long one means spinning is wasted here, so it shrinks
+ */
+static inline void queue_park_end(Queue *q, atomic_int *budget, QueueWaitInfo *wait,
+                                  uint64_t start_ns) {
+    uint64_t before = wait->wait_ns;
+    queue_wait_end(wait, start_ns);
+    wait->parks++;
+    
+    if (q->wait_strategy == QUEUE_WAIT_ADAPTIVE) {
+        queue_spin_adapt(q, budget, wait->wait_ns - before < QUEUE_SPIN_SHORT_PARK_NS ?
+                                    q->spin_limit : 0);
+    }
+}
+
+/*
+ * Ring backends: wake parked threads (one, or all when all is set) if any
+ * are waiting. The fence pairs with the one in the parking path, so either
+ * the waiter sees our update on its retry or we see its waiting count here.
+ */
+static inline void queue_wake_parked(Queue *q, atomic_int *waiting, pthread_cond_t *cond, int all) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) > 0) {
+        INSTRUMENT_MUTEX_LOCK(&q->mutex);
+        if (all) {
+            INSTRUMENT_COND_BROADCAST(cond);
+        } else {
+            INSTRUMENT_COND_SIGNAL(cond);
+        }
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+    }
+}
+
+// SCAN backend priority search (not static so the benchmarks can time it)
+int find_highest_priority_index(Queue *q);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Reporter Header File
+ * Periodic metrics export: interval rates, queue depth and latency
+ * percentiles written to a CSV file or sent as StatsD/Prometheus text over UDP
+ */
+
+#ifndef REPORTER_H
+#define REPORTER_H
+
+#include <stdint.h>
+#include "queue.h"
+#include "analytics.h"
+
+// Where samples go
+typedef enum {
+    REPORTER_SINK_FILE = 0,     // One CSV row per interval appended to a file
+    REPORTER_SINK_STATSD,       // StatsD gauges, one UDP datagram per interval
+    REPORTER_SINK_PROMETHEUS    // Prometheus text exposition, one UDP datagram per interval
+} ReporterSink;
+
+// Reporter configuration
+typedef struct {
+    uint64_t interval_ns;       // Time between samples
+    ReporterSink sink;
+    char target[256];           // File path, or host for the UDP sinks
+    char port[16];              // UDP port
+} ReporterOptions;
+
+// Function declarations
+int reporter_parse_target(const char *spec, ReporterOptions *opts);
+int reporter_start(const ReporterOptions *opts, Analytics *a, Queue *const *queues, int n_queues);
+void reporter_stop(void);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Shard Header File
+ * Sharded queue: one Queue per producer group, consumers steal across shards
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "queue.h"
+
+// Set of per-shard queues sharing one "items available" notification
+typedef struct {
+    Queue **shards;             // One queue per shard
+    int n_shards;               // Number of shards
+    atomic_long pending;        // Items enqueued and not yet dequeued (all shards)
+    atomic_int sleepers;        // Consumers parked until pending > 0
+    atomic_int closed;          // Set by sharded_queue_close(); dequeues then fail
+    pthread_mutex_t mutex;      // Protects parking of consumers
+    pthread_cond_t not_empty;   // Signalled when work arrives in any shard
+} ShardedQueue;
+
+// Function declarations
+ShardedQueue* sharded_queue_init(int n_shards, const QueueOptions *opts, const int *nodes);
+void sharded_queue_destroy(ShardedQueue *sq);
+Queue* sharded_queue_shard(ShardedQueue *sq, int shard);
+int sharded_queue_home(ShardedQueue *sq, int thread_index);
+int sharded_enqueue_batch(ShardedQueue *sq, int shard, const QueueItem *items, int n,
+                          QueueWaitInfo *wait);
+int sharded_dequeue_batch(ShardedQueue *sq, int home, QueueItem *items, int max,
+                          QueueWaitInfo *wait, int *from_shard);
+void sharded_queue_close(ShardedQueue *sq);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Shared-Memory Queue Header File
+ * Priority FIFO queue in a named POSIX shared-memory segment, so producer
+ * and consumer processes can attach to the same queue by name
+ */
+
+#ifndef SHM_QUEUE_H
+#define SHM_QUEUE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "config.h"
+
+#define SHM_QUEUE_MAGIC 0x53484d51u     // "SHMQ"
+#define SHM_QUEUE_VERSION 1
+
+// Roles a process attaches with (counted in the segment)
+typedef enum {
+    SHM_ROLE_PRODUCER = 0,
+    SHM_ROLE_CONSUMER
+} ShmQueueRole;
+
+// Segment header - followed by QueueItem items[capacity] and int next[capacity]
+// at items_offset / next_offset. Holds no pointers: every process maps the
+// segment at its own address, so slots are linked by index (as in the
+// BUCKET backend)
+typedef struct {
+    uint32_t magic;                 // SHM_QUEUE_MAGIC once initialized
+    uint32_t version;               // SHM_QUEUE_VERSION
+    uint32_t item_size;             // sizeof(QueueItem) of the creator (must match)
+    int capacity;                   // Maximum number of items
+    size_t items_offset;            // Byte offset of items[] from the segment start
+    size_t next_offset;             // Byte offset of next[] from the segment start
+    size_t segment_bytes;           // Total segment size
+
+    // Attached processes
+    atomic_int ready;               // Set by the creator after initialization
+    atomic_int attached;            // Processes mapped (last one out unlinks)
+    atomic_int producers;           // Producer processes attached now
+    atomic_int producers_seen;      // Non-zero once any producer attached
+
+    // Wait words: bumped on every change a waiter may care about; waiters
+    // sleep in futex(FUTEX_WAIT) on them (condition variables keep hidden
+    // waiter state that a killed process would leave inconsistent)
+    _Alignas(CACHE_LINE_SIZE)
+    atomic_uint not_full_seq;       // Bumped when slots are freed
+    atomic_uint not_empty_seq;      // Bumped when items arrive or producers leave
+    atomic_int full_waiters;        // Processes' threads asleep on not_full_seq
+    atomic_int empty_waiters;       // Processes' threads asleep on not_empty_seq
+
+    // Lock and the state only changed while holding it (process-shared, robust)
+    _Alignas(CACHE_LINE_SIZE)
+    pthread_mutex_t mutex;
+    int size;                       // Current number of items
+    int free_head;                  // First unused slot
+    int level_head[QUEUE_PRIORITY_LEVELS];  // Oldest slot of each priority level
+    int level_tail[QUEUE_PRIORITY_LEVELS];  // Newest slot of each priority level
+    unsigned int level_bitmap;      // Bit p set when level p is non-empty
+    long recoveries;                // Mutex owners that died holding the lock
+} ShmQueueHeader;
+
+// Process-local handle on a mapped segment
+typedef struct {
+    ShmQueueHeader *hdr;            // Start of the mapping
+    QueueItem *items;               // hdr + items_offset
+    int *next;                      // hdr + next_offset
+    ShmQueueRole role;
+    int stopping;                   // Set by shm_queue_wake(): blocked calls return
+    char name[256];                 // Segment name (for unlinking)
+} ShmQueue;
+
+// Function declarations
+ShmQueue* shm_queue_open(const char *name, int capacity, ShmQueueRole role);
+void shm_queue_detach(ShmQueue *q);
+int shm_queue_enqueue_batch(ShmQueue *q, const QueueItem *items, int n, QueueWaitInfo *wait);
+int shm_queue_dequeue_batch(ShmQueue *q, QueueItem *items, int max, QueueWaitInfo *wait);
+int shm_queue_size(ShmQueue *q);
+void shm_queue_wake(ShmQueue *q);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Shutdown Header File
+ * Run timer, signal handling and interruptible sleeps for worker threads
+ */
+
+#ifndef SHUTDOWN_H
+#define SHUTDOWN_H
+
+#include <stdint.h>
+
+// Called once from the shutdown thread after the stop flag is set, to wake
+// threads blocked in queues (may lock mutexes - not a signal handler)
+typedef void (*ShutdownWakeFn)(void *arg);
+
+// Drain mode: reports whether every queue is empty (called from main)
+typedef int (*ShutdownEmptyFn)(void *arg);
+
+// Outcome of a drain-on-shutdown phase
+typedef struct {
+    int drained;                // Non-zero if a drain phase ran
+    int deadline_hit;           // Non-zero if the drain deadline ended it
+    uint64_t drain_ns;          // Time from the start of the drain to the final stop
+} ShutdownDrainStats;
+
+// Function declarations
+int shutdown_init(int timeout_seconds, uint64_t drain_limit_ns,
+                  ShutdownWakeFn wake, void *wake_arg);
+void shutdown_request(const char *reason);
+int shutdown_requested(void);
+int shutdown_draining(void);
+int shutdown_sleep_ns(uint64_t ns);
+void shutdown_drain_wait(ShutdownEmptyFn is_empty, void *arg);
+void shutdown_drain_stats(ShutdownDrainStats *stats);
+void shutdown_finish(void);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Timing Header File
+ * Monotonic nanosecond clock with an optional calibrated cycle-counter path
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Clock sources
+typedef enum {
+    TIMING_SOURCE_MONOTONIC = 0,    // clock_gettime(CLOCK_MONOTONIC)
+    TIMING_SOURCE_TSC               // rdtsc (x86-64) / cntvct_el0 (AArch64), calibrated
+} TimingSource;
+
+// Function declarations
+int timing_init(TimingSource source);
+uint64_t timing_now_ns(void);
+void timing_pause_ns(uint64_t ns, int spin);
+TimingSource timing_source(void);
+const char* timing_source_name(TimingSource source);
+int timing_source_from_name(const char *name, TimingSource *source);
+
+/*
+ * Hint to the CPU that we are in a spin-wait loop
+ */
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif
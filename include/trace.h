@@ -0,0 +1,120 @@
+/*
+ * Trace Header File
+ * Binary event traces: fixed-width records appended to an mmap'ed file per
+ * thread, read back by the replay tool
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "queue.h"
+#include "config.h"
+
+#define TRACE_MAGIC "PCQTRACE"
+#define TRACE_VERSION 1
+
+// Event types
+typedef enum {
+    TRACE_EVENT_ENQUEUE = 1,        // Item handed to the queue (timestamp = production time)
+    TRACE_EVENT_DEQUEUE,            // Item taken from the queue by a consumer
+    TRACE_EVENT_BLOCKED,            // Producer waited for space (sequence = wait in us)
+    TRACE_EVENT_STARVED             // Consumer waited for data (sequence = wait in us)
+} TraceEvent;
+
+// Role of the thread that wrote a file
+typedef enum {
+    TRACE_ROLE_PRODUCER = 0,
+    TRACE_ROLE_CONSUMER
+} TraceRole;
+
+// One event - 24 bytes, no interior padding
+typedef struct {
+    uint64_t timestamp;             // timing_now_ns() of the event
+    int32_t producer_id;            // Producer that created the item
+    int32_t sequence;               // Sequence number from that producer
+    int16_t priority;               // Priority level of the item
+    int16_t value;                  // Data value of the item
+    uint8_t event;                  // TraceEvent
+    uint8_t reserved[3];
+} TraceRecord;
+_Static_assert(sizeof(TraceRecord) == 24, "TraceRecord must be 24 bytes");
+
+// File header - followed by TraceRecord records[records]
+typedef struct {
+    char magic[8];                  // TRACE_MAGIC (not NUL terminated)
+    uint32_t version;               // TRACE_VERSION
+    uint32_t record_size;           // sizeof(TraceRecord) of the writer
+    uint32_t role;                  // TraceRole
+    int32_t thread_id;              // Producer or consumer id
+    uint64_t start_ns;              // timing_now_ns() when the file was opened
+    int64_t start_unix_ns;          // Wall clock at the same moment
+    uint64_t records;               // Records written (kept current at every growth)
+    uint32_t clock_source;          // TimingSource of the timestamps
+    uint8_t reserved[12];
+} TraceFileHeader;
+_Static_assert(sizeof(TraceFileHeader) == 64, "TraceFileHeader must be 64 bytes");
+
+// Per-thread writer - owned by one thread, so appending takes no lock
+typedef struct {
+    int fd;
+    unsigned char *map;             // Mapping of the whole file
+    size_t map_bytes;               // Current file and mapping size
+    TraceRecord *records;           // map + sizeof(TraceFileHeader)
+    uint64_t count;                 // Records written
+    uint64_t capacity;              // Records that fit the current mapping
+} TraceWriter;
+
+// Read-only view of a trace file
+typedef struct {
+    const TraceFileHeader *hdr;
+    const TraceRecord *records;
+    uint64_t count;
+    size_t map_bytes;
+} TraceFile;
+
+// Function declarations
+int trace_prepare_dir(const char *dir);
+TraceWriter* trace_open(const char *dir, TraceRole role, int thread_id);
+int trace_grow(TraceWriter *w);
+void trace_close(TraceWriter *w);
+void trace_totals(uint64_t *files, uint64_t *records);
+int trace_file_open(const char *path, TraceFile *file);
+void trace_file_close(TraceFile *file);
+const char* trace_event_name(int event);
+
+/*
+ * Append one event for item (w == NULL: tracing is off)
+ */
+static inline void trace_record(TraceWriter *w, TraceEvent event, const QueueItem *item,
+                                uint64_t timestamp) {
+    if (w == NULL || (w->count == w->capacity && trace_grow(w) != 0)) {
+        return;
+    }
+    
+    TraceRecord *r = &w->records[w->count++];
+    r->timestamp = timestamp;
+    r->producer_id = item->producer_id;
+    r->sequence = item->sequence;
+    r->priority = item->priority;
+    r->value = item->value;
+    r->event = (uint8_t)event;
+    r->reserved[0] = r->reserved[1] = r->reserved[2] = 0;
+}
+
+/*
+ * Append a wait event (BLOCKED / STARVED) of wait_ns; the producer_id
+ * field of the record carries the waiting thread's id
+ */
+static inline void trace_record_wait(TraceWriter *w, TraceEvent event, int id,
+                                     uint64_t wait_ns, uint64_t timestamp) {
+    QueueItem item;
+    memset(&item, 0, sizeof(item));
+    item.producer_id = id;
+    item.sequence = wait_ns / 1000 > INT32_MAX ? INT32_MAX : (int)(wait_ns / 1000);
+    trace_record(w, event, &item, timestamp);
+}
+
+#endif
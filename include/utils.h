@@ -8,21 +8,32 @@
 
 #include <time.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // HOST_NAME_MAX might not be defined on all systems
 #ifndef HOST_NAME_MAX
 #define HOST_NAME_MAX 255
 #endif
 
+// Per-thread pseudo-random generator (xoshiro256**): no shared state, no lock
+typedef struct {
+    uint64_t s[4];
+} RandomState;
+
 // Random number generation
 int random_range(int min, int max);
 int random_range_seed(int min, int max, unsigned int *seed);
+void random_state_seed(RandomState *rng, uint64_t seed);
+uint64_t random_next(RandomState *rng);
+int random_state_range(RandomState *rng, int min, int max);
+void random_fill_range(RandomState *rng, int *values, int n, int min, int max);
 
 // Timing utilities
 double get_timestamp(void);
 void sleep_random(int max_seconds);
 char* get_current_time_string(void);
 void format_time_hms(double seconds, char *buffer, size_t buffer_size);
+void format_duration_ns(uint64_t ns, char *buffer, size_t buffer_size);
 
 // System information
 void print_system_info(void);
@@ -0,0 +1,67 @@
+/*
+ * Workload Header File
+ * Workload specification (priority mix, arrival process, per-producer
+ * rates) and the per-producer arrival generator
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "utils.h"
+#include "config.h"
+
+// Arrival processes
+typedef enum {
+    WORKLOAD_ARRIVAL_SLEEP = 0,     // Random 1..max_wait s sleeps (or bench pacing) per batch
+    WORKLOAD_ARRIVAL_CONSTANT,      // One item every 1/rate seconds
+    WORKLOAD_ARRIVAL_POISSON,       // Exponential gaps with mean 1/rate
+    WORKLOAD_ARRIVAL_BURSTY         // Poisson bursts of burst items, rate items/s on average
+} WorkloadArrival;
+
+// Per-producer rate override
+typedef struct {
+    int producer_id;
+    double rate;                    // Items per second
+} WorkloadRate;
+
+// Workload specification - parsed once, shared read-only by all producers
+typedef struct {
+    WorkloadArrival arrival;
+    double rate;                    // Items per second per producer (scheduled arrivals)
+    WorkloadRate overrides[WORKLOAD_MAX_OVERRIDES];     // rate.<id>=<r> entries
+    int n_overrides;
+    int burst;                      // BURSTY: items per burst
+    int open_loop;                  // Arrivals keep their schedule whatever the queue does
+    uint64_t spin_ns;               // Busy-wait this close to an arrival instead of sleeping
+    int weights[3];                 // Priority mix: high, normal, low weights
+    int custom_mix;                 // Values come from value_table, not uniform 0-9
+    uint8_t value_table[WORKLOAD_VALUE_TABLE_SIZE];     // Values spread by weight
+} WorkloadSpec;
+
+// One producer's arrival schedule
+typedef struct {
+    const WorkloadSpec *spec;
+    double rate;                    // This producer's items per second
+    double next_ns;                 // Due time of the next arrival (timing_now_ns clock)
+    int burst_left;                 // BURSTY: items left in the current burst
+} WorkloadGen;
+
+// Function declarations
+void workload_spec_default(WorkloadSpec *spec);
+int workload_spec_parse(WorkloadSpec *spec, const char *text);
+int workload_spec_load(WorkloadSpec *spec, const char *path);
+int workload_scheduled(const WorkloadSpec *spec);
+double workload_rate_for(const WorkloadSpec *spec, int producer_id);
+void workload_fill_values(const WorkloadSpec *spec, RandomState *rng, int *values, int n);
+int workload_priority_of(int value);
+void workload_describe(const WorkloadSpec *spec, char *buffer, size_t size);
+const char* workload_arrival_name(WorkloadArrival arrival);
+void workload_gen_init(WorkloadGen *gen, const WorkloadSpec *spec, int producer_id,
+                       RandomState *rng, uint64_t start_ns);
+uint64_t workload_gen_due(const WorkloadGen *gen);
+void workload_gen_advance(WorkloadGen *gen, RandomState *rng);
+void workload_gen_rebase(WorkloadGen *gen, uint64_t now_ns);
+
+#endif
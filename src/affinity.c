@@ -0,0 +1,430 @@
+/*
+ * Affinity Implementation
+ *
+ * Reads the CPU topology of the CPUs this process may use from sysfs
+ * (package, core, NUMA node and the L2/L3 sharing groups) and turns a
+ * placement policy into one CPU per producer and consumer. Threads are
+ * pinned through pthread_attr_setaffinity_np() before they start, so they
+ * never run (and first-touch memory) anywhere else.
+ *
+ * Where the topology files are missing every CPU is treated as its own
+ * core on node 0, which still gives sensible compact/scatter placements.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+#include "affinity.h"
+#include "config.h"
+
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+
+/*
+ * Read the first integer of a sysfs file (also the first CPU of a CPU
+ * list such as "0-3,8-11"), or fallback when it cannot be read
+ */
+static int read_sysfs_int(const char *path, int fallback) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return fallback;
+    }
+    
+    int value;
+    if (fscanf(f, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(f);
+    return value;
+}
+
+/*
+ * NUMA node of a CPU: the nodeN link in its sysfs directory (0 if none)
+ */
+static int read_cpu_node(int cpu) {
+    char path[128];
+    snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d", cpu);
+    
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+    
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/*
+ * Fill in the L2 and L3 sharing groups of a CPU from its cache directories
+ */
+static void read_cpu_caches(AffinityCpu *c) {
+    c->l2 = -1;
+    c->l3 = -1;
+    
+    for (int index = 0; index < 16; index++) {
+        char path[160];
+        char type[32] = "";
+    
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/cache/index%d/type", c->cpu, index);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+            break;
+        }
+        if (fscanf(f, "%31s", type) != 1) {
+            type[0] = '\0';
+        }
+        fclose(f);
+        if (strcmp(type, "Instruction") == 0) {
+            continue;
+        }
+    
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/cache/index%d/level", c->cpu, index);
+        int level = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/cache/index%d/shared_cpu_list",
+                 c->cpu, index);
+        if (level == 2) {
+            c->l2 = read_sysfs_int(path, c->cpu);
+        } else if (level == 3) {
+            c->l3 = read_sysfs_int(path, c->cpu);
+        }
+    }
+}
+
+/*
+ * Compact order: node, package, L3, L2, core, then CPU number, so SMT
+ * siblings and cache neighbours end up next to each other
+ */
+static int compare_compact(const void *pa, const void *pb) {
+    const AffinityCpu *a = (const AffinityCpu *)pa;
+    const AffinityCpu *b = (const AffinityCpu *)pb;
+    
+    if (a->node != b->node) return a->node - b->node;
+    if (a->package != b->package) return a->package - b->package;
+    if (a->l3 != b->l3) return a->l3 - b->l3;
+    if (a->l2 != b->l2) return a->l2 - b->l2;
+    if (a->core != b->core) return a->core - b->core;
+    return a->cpu - b->cpu;
+}
+
+/*
+ * Number of distinct values of one field over all CPUs
+ * (field: 0 package, 1 node, 2 L2 group, 3 L3 group)
+ */
+static int count_distinct(const AffinityTopology *topo, int field) {
+    int count = 0;
+    
+    for (int i = 0; i < topo->n_cpus; i++) {
+        const AffinityCpu *c = &topo->cpus[i];
+        int value = field == 0 ? c->package : field == 1 ? c->node : field == 2 ? c->l2 : c->l3;
+        int seen = value < 0;
+        for (int j = 0; j < i && !seen; j++) {
+            const AffinityCpu *d = &topo->cpus[j];
+            seen = value == (field == 0 ? d->package : field == 1 ? d->node :
+                             field == 2 ? d->l2 : d->l3);
+        }
+        count += !seen;
+    }
+    return count;
+}
+
+/*
+ * Discover the CPUs in this process' affinity mask and their topology
+ * Returns 0 on success, -1 on error
+ */
+int affinity_topology_load(AffinityTopology *topo) {
+    cpu_set_t allowed;
+    memset(topo, 0, sizeof(*topo));
+    
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        fprintf(stderr, "Error: Cannot read the process CPU affinity\n");
+        return -1;
+    }
+    
+    topo->cpus = (AffinityCpu *)calloc((size_t)CPU_COUNT(&allowed), sizeof(AffinityCpu));
+    if (topo->cpus == NULL) {
+        fprintf(stderr, "Error: Failed to allocate the CPU topology\n");
+        return -1;
+    }
+    
+    for (int cpu = 0; cpu < CPU_SETSIZE && topo->n_cpus < CPU_COUNT(&allowed); cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+    
+        AffinityCpu *c = &topo->cpus[topo->n_cpus++];
+        char path[128];
+        c->cpu = cpu;
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/topology/physical_package_id", cpu);
+        c->package = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/topology/core_id", cpu);
+        c->core = read_sysfs_int(path, cpu);
+        c->node = read_cpu_node(cpu);
+        read_cpu_caches(c);
+    }
+    
+    // Hardware threads of one core: the lowest CPU number is rank 0
+    for (int i = 0; i < topo->n_cpus; i++) {
+        AffinityCpu *c = &topo->cpus[i];
+        for (int j = 0; j < topo->n_cpus; j++) {
+            const AffinityCpu *d = &topo->cpus[j];
+            if (d->package == c->package && d->core == c->core && d->cpu < c->cpu) {
+                c->smt_rank++;
+            }
+        }
+    }
+    
+    qsort(topo->cpus, (size_t)topo->n_cpus, sizeof(AffinityCpu), compare_compact);
+    
+    topo->n_packages = count_distinct(topo, 0);
+    topo->n_nodes = count_distinct(topo, 1);
+    topo->n_l2 = count_distinct(topo, 2);
+    topo->n_l3 = count_distinct(topo, 3);
+    
+    return 0;
+}
+
+/*
+ * Release the topology
+ */
+void affinity_topology_free(AffinityTopology *topo) {
+    free(topo->cpus);
+    topo->cpus = NULL;
+    topo->n_cpus = 0;
+}
+
+/*
+ * Scatter order: the first hardware thread of every core before any
+ * sibling, and consecutive entries on different nodes
+ * order[] receives indices into topo->cpus
+ */
+static void scatter_order(const AffinityTopology *topo, int *order) {
+    int n = topo->n_cpus;
+    int *core_rank = (int *)calloc((size_t)n, sizeof(int));
+    
+    // Rank of each CPU's core among the cores of its node (compact order)
+    for (int i = 0; i < n && core_rank != NULL; i++) {
+        const AffinityCpu *c = &topo->cpus[i];
+        for (int j = 0; j < i; j++) {
+            const AffinityCpu *d = &topo->cpus[j];
+            if (d->node == c->node && d->smt_rank == 0 &&
+                !(d->package == c->package && d->core == c->core)) {
+                core_rank[i]++;
+            }
+        }
+    }
+    
+    // Selection by (smt_rank, core rank, node); n is small, so O(n^2) is fine
+    int placed = 0;
+    char *used = (char *)calloc((size_t)n, 1);
+    while (placed < n) {
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            if (used != NULL && used[i]) {
+                continue;
+            }
+            if (best < 0) {
+                best = i;
+                continue;
+            }
+            const AffinityCpu *c = &topo->cpus[i];
+            const AffinityCpu *b = &topo->cpus[best];
+            int ci = core_rank != NULL ? core_rank[i] : i;
+            int cb = core_rank != NULL ? core_rank[best] : best;
+            if (c->smt_rank < b->smt_rank ||
+                (c->smt_rank == b->smt_rank && (ci < cb || (ci == cb && c->node < b->node)))) {
+                best = i;
+            }
+        }
+        if (used == NULL) {
+            // Out of memory: fall back to compact order
+            order[placed] = placed;
+        } else {
+            used[best] = 1;
+            order[placed] = best;
+        }
+        placed++;
+    }
+    
+    free(used);
+    free(core_rank);
+}
+
+/*
+ * Choose a CPU for every producer and consumer (-1 = not pinned)
+ * The arrays need n_producers and n_consumers entries
+ * Returns 0 on success, -1 on error
+ */
+int affinity_plan(const AffinityTopology *topo, AffinityPolicy policy,
+                  int n_producers, int n_consumers, int *producer_cpus, int *consumer_cpus) {
+    int n = topo->n_cpus;
+    
+    for (int i = 0; i < n_producers; i++) producer_cpus[i] = -1;
+    for (int i = 0; i < n_consumers; i++) consumer_cpus[i] = -1;
+    if (policy == AFFINITY_NONE || n == 0) {
+        return 0;
+    }
+    
+    int *order = (int *)malloc(sizeof(int) * (size_t)n);
+    if (order == NULL) {
+        fprintf(stderr, "Error: Failed to allocate the placement plan\n");
+        return -1;
+    }
+    
+    if (policy == AFFINITY_SCATTER) {
+        scatter_order(topo, order);
+    } else {
+        for (int i = 0; i < n; i++) {
+            order[i] = i;
+        }
+    }
+    
+    if (policy == AFFINITY_PAIR) {
+        // Pairs of neighbours in compact order within one L3 group (or
+        // node): SMT siblings / L2 neighbours first; an odd CPU out is
+        // shared by both threads of its pair
+        int *first = (int *)malloc(sizeof(int) * (size_t)n);
+        int *second = (int *)malloc(sizeof(int) * (size_t)n);
+        int n_pairs = 0;
+        if (first == NULL || second == NULL) {
+            fprintf(stderr, "Error: Failed to allocate the placement plan\n");
+            free(first);
+            free(second);
+            free(order);
+            return -1;
+        }
+    
+        for (int i = 0; i < n; i++) {
+            const AffinityCpu *c = &topo->cpus[i];
+            const AffinityCpu *next = i + 1 < n ? &topo->cpus[i + 1] : NULL;
+            first[n_pairs] = c->cpu;
+            if (next != NULL && next->node == c->node && next->l3 == c->l3) {
+                second[n_pairs] = next->cpu;
+                i++;
+            } else {
+                second[n_pairs] = c->cpu;
+            }
+            n_pairs++;
+        }
+    
+        for (int i = 0; i < n_producers; i++) producer_cpus[i] = first[i % n_pairs];
+        for (int i = 0; i < n_consumers; i++) consumer_cpus[i] = second[i % n_pairs];
+        free(first);
+        free(second);
+    } else {
+        // Compact and scatter hand out CPUs in order: producers, then consumers
+        for (int i = 0; i < n_producers; i++) {
+            producer_cpus[i] = topo->cpus[order[i % n]].cpu;
+        }
+        for (int i = 0; i < n_consumers; i++) {
+            consumer_cpus[i] = topo->cpus[order[(n_producers + i) % n]].cpu;
+        }
+    }
+    
+    free(order);
+    return 0;
+}
+
+/*
+ * NUMA node of a CPU, or -1 for an unpinned thread
+ */
+int affinity_node_of(const AffinityTopology *topo, int cpu) {
+    for (int i = 0; i < topo->n_cpus && cpu >= 0; i++) {
+        if (topo->cpus[i].cpu == cpu) {
+            return topo->cpus[i].node;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Pin threads created with attr to one CPU (cpu < 0 leaves attr alone)
+ * Returns 0 on success, -1 on error
+ */
+int affinity_attr_set_cpu(pthread_attr_t *attr, int cpu) {
+    if (cpu < 0) {
+        return 0;
+    }
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_attr_setaffinity_np(attr, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Error: Cannot set the affinity of a thread to CPU %d\n", cpu);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Non-zero if queue memory can be bound to a NUMA node (libnuma)
+ */
+int affinity_numa_available(void) {
+#ifdef HAVE_LIBNUMA
+    return numa_available() >= 0;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Print the topology and placement lines of the Runtime Configuration block
+ */
+void affinity_print(const AffinityTopology *topo, AffinityPolicy policy) {
+    printf("CPU Topology:          %d CPU(s), %d package(s), %d NUMA node(s), "
+           "%d L2 / %d L3 group(s)\n",
+           topo->n_cpus, topo->n_packages, topo->n_nodes, topo->n_l2, topo->n_l3);
+    printf("Thread Placement:      %s", affinity_policy_name(policy));
+    if (policy != AFFINITY_NONE) {
+        fputs(affinity_numa_available() ? " (queue memory on the consumers' node)" :
+              " (no libnuma: queue memory not node-bound)", stdout);
+    }
+    printf("\n");
+}
+
+/*
+ * Name of a placement policy (for reports)
+ */
+const char* affinity_policy_name(AffinityPolicy policy) {
+    switch (policy) {
+        case AFFINITY_NONE:
+            return "none";
+        case AFFINITY_COMPACT:
+            return "compact";
+        case AFFINITY_SCATTER:
+            return "scatter";
+        case AFFINITY_PAIR:
+            return "pair";
+    }
+    return "unknown";
+}
+
+/*
+ * Parse a placement policy name
+ * Returns 0 on success, -1 if the name is unknown
+ */
+int affinity_policy_from_name(const char *name, AffinityPolicy *policy) {
+    static const AffinityPolicy all[] = {
+        AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER, AFFINITY_PAIR
+    };
+    
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (strcmp(name, affinity_policy_name(all[i])) == 0) {
+            *policy = all[i];
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -10,8 +10,85 @@
 #include <pthread.h>
 #include <string.h>
 #include "analytics.h"
+#include "histogram.h"
+#include "utils.h"
 #include "config.h"
 
+// Source of unique Analytics ids (0 is never used, so empty cache entries miss)
+static atomic_ulong next_analytics_id = 1;
+
+// Per-thread cache of the slot this thread claimed in recently used instances
+#define ANALYTICS_SLOT_CACHE 4
+
+typedef struct {
+    unsigned long id;               // Analytics id this entry belongs to
+    AnalyticsSlot *slot;            // Slot claimed by this thread
+    int shared;                     // Slot is the shared overflow slot
+} SlotCacheEntry;
+
+static __thread SlotCacheEntry slot_cache[ANALYTICS_SLOT_CACHE];
+static __thread int slot_cache_next = 0;
+
+/*
+ * Reset a counter slot to its initial state
+ */
+static void slot_reset(AnalyticsSlot *s) {
+    atomic_init(&s->total_produced, 0);
+    atomic_init(&s->total_consumed, 0);
+    atomic_init(&s->producer_blocks, 0);
+    atomic_init(&s->consumer_blocks, 0);
+    atomic_init(&s->high_priority_consumed, 0);
+    atomic_init(&s->normal_priority_consumed, 0);
+    atomic_init(&s->low_priority_consumed, 0);
+    atomic_init(&s->produce_batches, 0);
+    atomic_init(&s->consume_batches, 0);
+    atomic_init(&s->producer_wait_ns, 0);
+    atomic_init(&s->consumer_wait_ns, 0);
+    atomic_init(&s->total_latency_ns, 0);
+    atomic_init(&s->min_latency_ns, -1);  // Sentinel value for uninitialized
+    atomic_init(&s->max_latency_ns, 0);
+    atomic_init(&s->drained, 0);
+    atomic_init(&s->payload_bytes, 0);
+    atomic_init(&s->payload_stalls, 0);
+    atomic_init(&s->producer_spins, 0);
+    atomic_init(&s->producer_yields, 0);
+    atomic_init(&s->producer_parks, 0);
+    atomic_init(&s->consumer_spins, 0);
+    atomic_init(&s->consumer_yields, 0);
+    atomic_init(&s->consumer_parks, 0);
+    atomic_init(&s->scheduled, 0);
+    atomic_init(&s->schedule_lag_ns, 0);
+    atomic_init(&s->schedule_lag_max_ns, 0);
+    atomic_init(&s->schedule_late, 0);
+    atomic_init(&s->hist, NULL);
+}
+
+/*
+ * Allocate a slot's histograms, cleared
+ * Returns NULL if out of memory
+ */
+static AnalyticsSlotHistograms* slot_histograms_alloc(void) {
+    AnalyticsSlotHistograms *h = NULL;
+    if (posix_memalign((void **)&h, CACHE_LINE_SIZE, sizeof(AnalyticsSlotHistograms)) != 0) {
+        return NULL;
+    }
+    
+    for (int c = 0; c < ANALYTICS_CLASSES; c++) {
+        histogram_reset(&h->latency[c]);
+    }
+    for (int r = 0; r < ANALYTICS_ROLES; r++) {
+        histogram_reset(&h->wait[r]);
+    }
+    return h;
+}
+
+/*
+ * Histograms of a claimed slot (only read by the slot's writer)
+ */
+static inline AnalyticsSlotHistograms* slot_hist(AnalyticsSlot *s) {
+    return atomic_load_explicit(&s->hist, memory_order_relaxed);
+}
+
 /*
  * Initialize analytics structure
  */
@@ -22,21 +99,47 @@ Analytics* analytics_init(void) {
         return NULL;
     }
     
+    // One slot per thread plus the shared overflow slot, cache-line aligned
+    a->slots = (AnalyticsSlot *)aligned_alloc(CACHE_LINE_SIZE,
+                                              sizeof(AnalyticsSlot) * (ANALYTICS_MAX_SLOTS + 1));
+    if (a->slots == NULL) {
+        fprintf(stderr, "Error: Failed to allocate analytics counter slots\n");
+        free(a);
+        return NULL;
+    }
+    
     // Initialize counters
-    a->total_produced = 0;
-    a->total_consumed = 0;
-    a->producer_blocks = 0;
-    a->consumer_blocks = 0;
-    a->total_latency = 0.0;
-    a->min_latency = -1.0;  // Sentinel value for uninitialized
-    a->max_latency = 0.0;
-    a->high_priority_consumed = 0;
-    a->normal_priority_consumed = 0;
-    a->low_priority_consumed = 0;
-    
-    // Initialize mutex for thread-safe access
+    for (int i = 0; i <= ANALYTICS_MAX_SLOTS; i++) {
+        slot_reset(&a->slots[i]);
+    }
+    atomic_init(&a->slots_used, 0);
+    a->shards = NULL;
+    a->n_shards = 0;
+    a->drain_ran = 0;
+    a->drain_deadline_hit = 0;
+    a->drain_ns = 0;
+    a->payload = NULL;
+    a->offered_rate = 0;
+    a->shed = 0;
+    a->open_loop = 0;
+    a->id = atomic_fetch_add(&next_analytics_id, 1);
+    
+    // The shared overflow slot's histograms exist from the start; the
+    // per-thread ones are allocated as threads claim their slots
+    AnalyticsSlotHistograms *overflow_hist = slot_histograms_alloc();
+    if (overflow_hist == NULL) {
+        fprintf(stderr, "Error: Failed to allocate analytics histograms\n");
+        free(a->slots);
+        free(a);
+        return NULL;
+    }
+    atomic_init(&a->slots[ANALYTICS_MAX_SLOTS].hist, overflow_hist);
+    
+    // Initialize mutex for the shared overflow slot
     if (pthread_mutex_init(&a->mutex, NULL) != 0) {
         fprintf(stderr, "Error: Failed to initialize analytics mutex\n");
+        free(overflow_hist);
+        free(a->slots);
         free(a);
         return NULL;
     }
@@ -48,88 +151,670 @@ Analytics* analytics_init(void) {
     return a;
 }
 
+/*
+ * Find (or claim on first use) the calling thread's slot
+ * Sets *shared when the thread got the overflow slot, which must then be
+ * updated under a->mutex (slot_release unlocks it)
+ */
+static AnalyticsSlot* slot_acquire(Analytics *a, int *shared) {
+    for (int i = 0; i < ANALYTICS_SLOT_CACHE; i++) {
+        if (slot_cache[i].id == a->id) {
+            *shared = slot_cache[i].shared;
+            if (*shared) {
+                pthread_mutex_lock(&a->mutex);
+            }
+            return slot_cache[i].slot;
+        }
+    }
+    
+    // First record from this thread: claim the next free slot
+    SlotCacheEntry entry;
+    int index = atomic_fetch_add(&a->slots_used, 1);
+    entry.id = a->id;
+    entry.shared = index >= ANALYTICS_MAX_SLOTS;
+    
+    // A thread whose histograms cannot be allocated records into the
+    // overflow slot instead
+    if (!entry.shared) {
+        AnalyticsSlotHistograms *hist = slot_histograms_alloc();
+        if (hist != NULL) {
+            atomic_store_explicit(&a->slots[index].hist, hist, memory_order_release);
+        } else {
+            entry.shared = 1;
+        }
+    }
+    entry.slot = &a->slots[entry.shared ? ANALYTICS_MAX_SLOTS : index];
+    
+    slot_cache[slot_cache_next] = entry;
+    slot_cache_next = (slot_cache_next + 1) % ANALYTICS_SLOT_CACHE;
+    
+    *shared = entry.shared;
+    if (*shared) {
+        pthread_mutex_lock(&a->mutex);
+    }
+    return entry.slot;
+}
+
+/*
+ * Finish an update started with slot_acquire
+ */
+static inline void slot_release(Analytics *a, int shared) {
+    if (shared) {
+        pthread_mutex_unlock(&a->mutex);
+    }
+}
+
+/*
+ * Add to a counter of a slot with a single writer (no read-modify-write)
+ */
+static inline void slot_add(atomic_long *counter, long value) {
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+/*
+ * Add one latency sample to a slot (sum, min, max)
+ */
+static inline void slot_add_latency(AnalyticsSlot *s, uint64_t latency_ns) {
+    long latency = (long)latency_ns;
+    long min = atomic_load_explicit(&s->min_latency_ns, memory_order_relaxed);
+    long max = atomic_load_explicit(&s->max_latency_ns, memory_order_relaxed);
+    
+    slot_add(&s->total_latency_ns, latency);
+    
+    // Update min/max latency
+    if (min < 0 || latency < min) {
+        atomic_store_explicit(&s->min_latency_ns, latency, memory_order_relaxed);
+    }
+    if (latency > max) {
+        atomic_store_explicit(&s->max_latency_ns, latency, memory_order_relaxed);
+    }
+}
+
 /*
  * Record a produce event
  */
 void analytics_record_produce(Analytics *a) {
     if (a == NULL) return;
     
-    pthread_mutex_lock(&a->mutex);
-    a->total_produced++;
-    pthread_mutex_unlock(&a->mutex);
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->total_produced, 1);
+    slot_release(a, shared);
 }
 
 /*
- * Record a consume event with latency measurement
+ * Record a batch write of count items
  */
-void analytics_record_consume(Analytics *a, double latency) {
+void analytics_record_produce_batch(Analytics *a, int count) {
     if (a == NULL) return;
     
-    pthread_mutex_lock(&a->mutex);
-    a->total_consumed++;
-    a->total_latency += latency;
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->total_produced, count);
+    slot_add(&s->produce_batches, 1);
+    slot_release(a, shared);
+}
+
+/*
+ * Record a batch read of count items
+ * Items themselves are recorded with analytics_record_consume_priority
+ */
+void analytics_record_consume_batch(Analytics *a, int count) {
+    if (a == NULL || count <= 0) return;
     
-    // Update min/max latency
-    if (a->min_latency < 0 || latency < a->min_latency) {
-        a->min_latency = latency;
-    }
-    if (latency > a->max_latency) {
-        a->max_latency = latency;
-    }
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->consume_batches, 1);
+    slot_release(a, shared);
+}
+
+/*
+ * Record a consume event with latency measurement
+ */
+void analytics_record_consume(Analytics *a, uint64_t latency_ns) {
+    if (a == NULL) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->total_consumed, 1);
+    slot_add_latency(s, latency_ns);
     
-    pthread_mutex_unlock(&a->mutex);
+    // Samples without priority information are histogrammed as normal
+    histogram_record_owned(&slot_hist(s)->latency[ANALYTICS_CLASS_NORMAL], latency_ns);
+    slot_release(a, shared);
 }
 
 /*
  * Record a consume event with priority information
  */
-void analytics_record_consume_priority(Analytics *a, int priority, double latency) {
+void analytics_record_consume_priority(Analytics *a, int priority, uint64_t latency_ns) {
     if (a == NULL) return;
     
-    pthread_mutex_lock(&a->mutex);
-    a->total_consumed++;
-    a->total_latency += latency;
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->total_consumed, 1);
     
     // Track by priority
+    int cls;
     if (priority == PRIORITY_HIGH) {
-        a->high_priority_consumed++;
+        slot_add(&s->high_priority_consumed, 1);
+        cls = ANALYTICS_CLASS_HIGH;
     } else if (priority == PRIORITY_NORMAL) {
-        a->normal_priority_consumed++;
+        slot_add(&s->normal_priority_consumed, 1);
+        cls = ANALYTICS_CLASS_NORMAL;
     } else {
-        a->low_priority_consumed++;
+        slot_add(&s->low_priority_consumed, 1);
+        cls = ANALYTICS_CLASS_LOW;
     }
     
-    // Update min/max latency
-    if (a->min_latency < 0 || latency < a->min_latency) {
-        a->min_latency = latency;
+    slot_add_latency(s, latency_ns);
+    histogram_record_owned(&slot_hist(s)->latency[cls], latency_ns);
+    slot_release(a, shared);
+}
+
+/*
+ * Record a producer block event (queue was full) and how long it lasted
+ */
+void analytics_record_producer_block(Analytics *a, uint64_t wait_ns) {
+    if (a == NULL) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->producer_blocks, 1);
+    slot_add(&s->producer_wait_ns, (long)wait_ns);
+    histogram_record_owned(&slot_hist(s)->wait[ANALYTICS_ROLE_PRODUCER], wait_ns);
+    slot_release(a, shared);
+}
+
+/*
+ * Record a consumer block event (queue was empty - starvation) and how
+ * long it lasted
+ */
+void analytics_record_consumer_block(Analytics *a, uint64_t wait_ns) {
+    if (a == NULL) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->consumer_blocks, 1);
+    slot_add(&s->consumer_wait_ns, (long)wait_ns);
+    histogram_record_owned(&slot_hist(s)->wait[ANALYTICS_ROLE_CONSUMER], wait_ns);
+    slot_release(a, shared);
+}
+
+/*
+ * Record how the waits of one queue call ended (QueueWaitInfo counts) for
+ * role (AnalyticsRole)
+ */
+void analytics_record_wait_phases(Analytics *a, int role, int spins, int yields, int parks) {
+    if (a == NULL) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    if (role == ANALYTICS_ROLE_PRODUCER) {
+        slot_add(&s->producer_spins, spins);
+        slot_add(&s->producer_yields, yields);
+        slot_add(&s->producer_parks, parks);
+    } else {
+        slot_add(&s->consumer_spins, spins);
+        slot_add(&s->consumer_yields, yields);
+        slot_add(&s->consumer_parks, parks);
+    }
+    slot_release(a, shared);
+}
+
+/*
+ * Enable per-shard counters for a sharded queue with n_shards shards
+ * Returns 0 on success, -1 on error
+ */
+int analytics_init_shards(Analytics *a, int n_shards) {
+    if (a == NULL || n_shards < 1) return -1;
+    
+    AnalyticsShard *shards = (AnalyticsShard *)aligned_alloc(CACHE_LINE_SIZE,
+                                                             sizeof(AnalyticsShard) * n_shards);
+    if (shards == NULL) {
+        fprintf(stderr, "Error: Failed to allocate shard counters\n");
+        return -1;
     }
-    if (latency > a->max_latency) {
-        a->max_latency = latency;
+    
+    for (int i = 0; i < n_shards; i++) {
+        atomic_init(&shards[i].produced, 0);
+        atomic_init(&shards[i].consumed_local, 0);
+        atomic_init(&shards[i].stolen, 0);
+        atomic_init(&shards[i].steals, 0);
     }
     
-    pthread_mutex_unlock(&a->mutex);
+    free(a->shards);
+    a->shards = shards;
+    a->n_shards = n_shards;
+    return 0;
 }
 
 /*
- * Record a producer block event (queue was full)
+ * Record count items written to a shard
+ * Shard counters are shared by the threads of the shard (atomic add)
  */
-void analytics_record_producer_block(Analytics *a) {
+void analytics_record_shard_produce(Analytics *a, int shard, int count) {
+    if (a == NULL || shard < 0 || shard >= a->n_shards) return;
+    
+    atomic_fetch_add_explicit(&a->shards[shard].produced, count, memory_order_relaxed);
+}
+
+/*
+ * Record count items taken from a shard, stolen by a consumer of another
+ * shard when stolen is set
+ */
+void analytics_record_shard_consume(Analytics *a, int shard, int count, int stolen) {
+    if (a == NULL || shard < 0 || shard >= a->n_shards) return;
+    
+    AnalyticsShard *s = &a->shards[shard];
+    if (stolen) {
+        atomic_fetch_add_explicit(&s->stolen, count, memory_order_relaxed);
+        atomic_fetch_add_explicit(&s->steals, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&s->consumed_local, count, memory_order_relaxed);
+    }
+}
+
+/*
+ * Record count items consumed after the drain phase started
+ */
+void analytics_record_drain_batch(Analytics *a, int count) {
+    if (a == NULL || count <= 0) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->drained, count);
+    slot_release(a, shared);
+}
+
+/*
+ * Report the drain phase of the run (called once, after the threads stop)
+ */
+void analytics_set_drain(Analytics *a, uint64_t drain_ns, int deadline_hit) {
+    if (a == NULL) return;
+    
+    a->drain_ran = 1;
+    a->drain_ns = drain_ns;
+    a->drain_deadline_hit = deadline_hit;
+}
+
+/*
+ * Report pool usage for a payload-carrying run (the pool outlives the summary)
+ */
+void analytics_set_payload_pool(Analytics *a, const PayloadPool *pool) {
     if (a == NULL) return;
     
-    pthread_mutex_lock(&a->mutex);
-    a->producer_blocks++;
-    pthread_mutex_unlock(&a->mutex);
+    a->payload = pool;
+}
+
+/*
+ * Record bytes of payload bodies processed by a consumer
+ */
+void analytics_record_payload_consume(Analytics *a, long bytes) {
+    if (a == NULL || bytes <= 0) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->payload_bytes, bytes);
+    slot_release(a, shared);
 }
 
 /*
- * Record a consumer block event (queue was empty - starvation)
+ * Record a producer wait for a free payload slot (pool exhausted)
  */
-void analytics_record_consumer_block(Analytics *a) {
+void analytics_record_payload_stall(Analytics *a) {
     if (a == NULL) return;
     
-    pthread_mutex_lock(&a->mutex);
-    a->consumer_blocks++;
-    pthread_mutex_unlock(&a->mutex);
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->payload_stalls, 1);
+    slot_release(a, shared);
+}
+
+/*
+ * Report the offered load of a scheduled workload (items/s summed over
+ * all producers) so the summary can compare it with what was achieved
+ */
+void analytics_set_offered_load(Analytics *a, double rate, int open_loop) {
+    if (a == NULL) return;
+    
+    a->offered_rate = rate;
+    a->open_loop = open_loop;
+}
+
+/*
+ * Report how many produced items the overflow policy discarded or evicted,
+ * so the summary does not count them as lost
+ */
+void analytics_set_shed(Analytics *a, long shed) {
+    if (a == NULL) return;
+    
+    a->shed = shed;
+}
+
+/*
+ * Record count scheduled arrivals written by one enqueue: the sum and
+ * maximum of how long after their due time the queue took them, and how
+ * many of them were late
+ */
+void analytics_record_schedule_lag(Analytics *a, int count, uint64_t lag_sum_ns,
+                                   uint64_t lag_max_ns, int late) {
+    if (a == NULL || count <= 0) return;
+    
+    int shared;
+    AnalyticsSlot *s = slot_acquire(a, &shared);
+    slot_add(&s->scheduled, count);
+    slot_add(&s->schedule_lag_ns, (long)lag_sum_ns);
+    slot_add(&s->schedule_late, late);
+    if ((long)lag_max_ns > atomic_load_explicit(&s->schedule_lag_max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&s->schedule_lag_max_ns, (long)lag_max_ns, memory_order_relaxed);
+    }
+    slot_release(a, shared);
+}
+
+/*
+ * Print offered against achieved load of a scheduled workload
+ * The queue keeps up while the consumers match the offered rate and
+ * arrivals are handed over on time; a saturated queue shows up as a
+ * shortfall (closed loop) or a growing schedule lag (open loop)
+ */
+static void print_offered_load(Analytics *a, const AnalyticsTotals *t, double runtime) {
+    char buffer[32];
+    double produce_rate = runtime > 0 ? t->total_produced / runtime : 0.0;
+    double consume_rate = runtime > 0 ? t->total_consumed / runtime : 0.0;
+    
+    printf("\n--- Offered Load ---\n");
+    printf("Offered Rate:             %.0f items/sec (%s loop)\n", a->offered_rate,
+           a->open_loop ? "open" : "closed");
+    printf("Achieved Rate:            %.0f items/sec produced, %.0f consumed (%.1f%% of offered)\n",
+           produce_rate, consume_rate, 100.0 * consume_rate / a->offered_rate);
+    if (t->scheduled > 0) {
+        format_duration_ns((uint64_t)(t->schedule_lag_ns / t->scheduled), buffer, sizeof(buffer));
+        printf("Schedule Lag:             mean %s", buffer);
+        format_duration_ns((uint64_t)t->schedule_lag_max_ns, buffer, sizeof(buffer));
+        printf(", max %s\n", buffer);
+        format_duration_ns(WORKLOAD_LATE_NS, buffer, sizeof(buffer));
+        printf("Late Arrivals:            %ld (%.2f%% more than %s late)\n", t->schedule_late,
+               100.0 * t->schedule_late / t->scheduled, buffer);
+    }
+    
+    int saturated = consume_rate < a->offered_rate * WORKLOAD_SATURATED_FRACTION ||
+                    (t->scheduled > 0 && t->schedule_late > t->scheduled / 100);
+    printf("Load Status:              %s\n", saturated ?
+           "SATURATED (the queue does not sustain the offered rate)" : "KEEPING UP");
+}
+
+/*
+ * Print per-size-class slot usage of the payload pool
+ */
+static void print_payload_pool(Analytics *a, const AnalyticsTotals *t, double runtime) {
+    printf("\n--- Payload Pool ---\n");
+    printf("%-10s %10s %10s %10s %12s %10s\n",
+           "Class", "Slots", "In Use", "Peak", "Reserved", "Exhausted");
+    
+    for (int cls = 0; cls < PAYLOAD_CLASSES; cls++) {
+        PayloadClassStats st;
+        if (payload_pool_class_stats(a->payload, cls, &st) != 0) {
+            continue;
+        }
+        char label[32];
+        if (st.slot_size >= 1024) {
+            snprintf(label, sizeof(label), "%zuKB", st.slot_size / 1024);
+        } else {
+            snprintf(label, sizeof(label), "%zuB", st.slot_size);
+        }
+        printf("%-10s %10u %10ld %10ld %12ld %10ld\n", label, st.n_slots,
+               st.in_use, st.peak_in_use, st.reserved, st.exhausted);
+    }
+    
+    printf("Payload Bytes Consumed:   %ld", t->payload_bytes);
+    if (runtime > 0) {
+        printf(" (%.1f MB/s)", t->payload_bytes / runtime / (1024.0 * 1024.0));
+    }
+    printf("\n");
+    if (t->total_consumed > 0) {
+        printf("Mean Payload Size:        %.0f bytes\n", (double)t->payload_bytes / t->total_consumed);
+    }
+    printf("Producer Slot Waits:      %ld\n", t->payload_stalls);
+}
+
+/*
+ * Print per-shard load and steals, and how unevenly producers loaded them
+ * Imbalance is the busiest shard's load over the mean (1.00 = even)
+ */
+static void print_shards(Analytics *a) {
+    long total_produced = 0;
+    long total_stolen = 0;
+    long max_produced = 0;
+    
+    printf("\n--- Shards ---\n");
+    printf("%-10s %12s %12s %12s %10s\n", "Shard", "Produced", "Local", "Stolen", "Steals");
+    
+    for (int i = 0; i < a->n_shards; i++) {
+        AnalyticsShard *s = &a->shards[i];
+        long produced = atomic_load_explicit(&s->produced, memory_order_relaxed);
+        long local = atomic_load_explicit(&s->consumed_local, memory_order_relaxed);
+        long stolen = atomic_load_explicit(&s->stolen, memory_order_relaxed);
+        long steals = atomic_load_explicit(&s->steals, memory_order_relaxed);
+        
+        printf("S%-9d %12ld %12ld %12ld %10ld\n", i, produced, local, stolen, steals);
+        
+        total_produced += produced;
+        total_stolen += stolen;
+        if (produced > max_produced) {
+            max_produced = produced;
+        }
+    }
+    
+    if (total_produced > 0) {
+        double mean = (double)total_produced / a->n_shards;
+        printf("Shard Imbalance:          %.2f (busiest shard / mean load)\n", max_produced / mean);
+        printf("Stolen Items:             %.1f%% of produced\n", 100.0 * total_stolen / total_produced);
+    }
+}
+
+/*
+ * Number of per-thread slots claimed so far
+ */
+static int slots_claimed(Analytics *a) {
+    int used = atomic_load_explicit(&a->slots_used, memory_order_acquire);
+    return used > ANALYTICS_MAX_SLOTS ? ANALYTICS_MAX_SLOTS : used;
+}
+
+/*
+ * Merge every claimed slot into one set of totals
+ * Lock-free: reads may run concurrently with the hot-path writers
+ */
+void analytics_collect(Analytics *a, AnalyticsTotals *t) {
+    memset(t, 0, sizeof(*t));
+    t->min_latency_ns = -1;
+    
+    if (a == NULL) return;
+    
+    int used = slots_claimed(a);
+    
+    for (int i = 0; i <= used; i++) {
+        // The last pass reads the shared overflow slot
+        AnalyticsSlot *s = &a->slots[i == used ? ANALYTICS_MAX_SLOTS : i];
+        
+        t->total_produced += atomic_load_explicit(&s->total_produced, memory_order_relaxed);
+        t->total_consumed += atomic_load_explicit(&s->total_consumed, memory_order_relaxed);
+        t->producer_blocks += atomic_load_explicit(&s->producer_blocks, memory_order_relaxed);
+        t->consumer_blocks += atomic_load_explicit(&s->consumer_blocks, memory_order_relaxed);
+        t->high_priority_consumed += atomic_load_explicit(&s->high_priority_consumed, memory_order_relaxed);
+        t->normal_priority_consumed += atomic_load_explicit(&s->normal_priority_consumed, memory_order_relaxed);
+        t->low_priority_consumed += atomic_load_explicit(&s->low_priority_consumed, memory_order_relaxed);
+        t->produce_batches += atomic_load_explicit(&s->produce_batches, memory_order_relaxed);
+        t->consume_batches += atomic_load_explicit(&s->consume_batches, memory_order_relaxed);
+        t->producer_wait_ns += atomic_load_explicit(&s->producer_wait_ns, memory_order_relaxed);
+        t->consumer_wait_ns += atomic_load_explicit(&s->consumer_wait_ns, memory_order_relaxed);
+        t->total_latency_ns += atomic_load_explicit(&s->total_latency_ns, memory_order_relaxed);
+        t->drained += atomic_load_explicit(&s->drained, memory_order_relaxed);
+        t->payload_bytes += atomic_load_explicit(&s->payload_bytes, memory_order_relaxed);
+        t->payload_stalls += atomic_load_explicit(&s->payload_stalls, memory_order_relaxed);
+        t->producer_spins += atomic_load_explicit(&s->producer_spins, memory_order_relaxed);
+        t->producer_yields += atomic_load_explicit(&s->producer_yields, memory_order_relaxed);
+        t->producer_parks += atomic_load_explicit(&s->producer_parks, memory_order_relaxed);
+        t->consumer_spins += atomic_load_explicit(&s->consumer_spins, memory_order_relaxed);
+        t->consumer_yields += atomic_load_explicit(&s->consumer_yields, memory_order_relaxed);
+        t->consumer_parks += atomic_load_explicit(&s->consumer_parks, memory_order_relaxed);
+        t->scheduled += atomic_load_explicit(&s->scheduled, memory_order_relaxed);
+        t->schedule_lag_ns += atomic_load_explicit(&s->schedule_lag_ns, memory_order_relaxed);
+        t->schedule_late += atomic_load_explicit(&s->schedule_late, memory_order_relaxed);
+        long lag_max = atomic_load_explicit(&s->schedule_lag_max_ns, memory_order_relaxed);
+        if (lag_max > t->schedule_lag_max_ns) {
+            t->schedule_lag_max_ns = lag_max;
+        }
+        
+        // Merge per-thread min/max latency
+        long min = atomic_load_explicit(&s->min_latency_ns, memory_order_relaxed);
+        long max = atomic_load_explicit(&s->max_latency_ns, memory_order_relaxed);
+        if (min >= 0 && (t->min_latency_ns < 0 || min < t->min_latency_ns)) {
+            t->min_latency_ns = min;
+        }
+        if (max > t->max_latency_ns) {
+            t->max_latency_ns = max;
+        }
+    }
+}
+
+/*
+ * Histograms of the i-th slot visited by a merge over the used slots (the
+ * last visit, i == used, is the shared overflow slot); NULL while a slot
+ * is still being claimed
+ */
+static AnalyticsSlotHistograms* slot_hist_at(Analytics *a, int i, int used) {
+    AnalyticsSlot *s = &a->slots[i == used ? ANALYTICS_MAX_SLOTS : i];
+    return atomic_load_explicit(&s->hist, memory_order_acquire);
+}
+
+/*
+ * Copy the latency histogram of one class, or of all classes merged when
+ * cls is ANALYTICS_CLASSES, merged from every slot
+ */
+void analytics_latency_histogram(Analytics *a, int cls, LatencyHistogram *out) {
+    histogram_reset(out);
+    if (a == NULL) return;
+    
+    int used = slots_claimed(a);
+    for (int i = 0; i <= used; i++) {
+        AnalyticsSlotHistograms *h = slot_hist_at(a, i, used);
+        if (h == NULL) {
+            continue;
+        }
+        for (int c = 0; c < ANALYTICS_CLASSES; c++) {
+            if (cls == ANALYTICS_CLASSES || cls == c) {
+                histogram_merge(out, &h->latency[c]);
+            }
+        }
+    }
+}
+
+/*
+ * Copy the blocked-time histogram of one role (AnalyticsRole), merged
+ * from every slot
+ */
+void analytics_wait_histogram(Analytics *a, int role, LatencyHistogram *out) {
+    histogram_reset(out);
+    if (a == NULL || role < 0 || role >= ANALYTICS_ROLES) return;
+    
+    int used = slots_claimed(a);
+    for (int i = 0; i <= used; i++) {
+        AnalyticsSlotHistograms *h = slot_hist_at(a, i, used);
+        if (h != NULL) {
+            histogram_merge(out, &h->wait[role]);
+        }
+    }
+}
+
+/*
+ * Print one row of the latency percentile table
+ */
+static void print_percentile_row(const char *label, const LatencyHistogram *h) {
+    static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+    char buffer[32];
+    
+    printf("%-10s %10llu", label, (unsigned long long)histogram_count(h));
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        format_duration_ns(histogram_percentile(h, percentiles[i]), buffer, sizeof(buffer));
+        printf(" %10s", buffer);
+    }
+    format_duration_ns(histogram_max(h), buffer, sizeof(buffer));
+    printf(" %10s\n", buffer);
+}
+
+/*
+ * Print p50/p90/p99/p99.9/p99.99/max for all items and for each priority
+ * class (the tail of the low class shows whether a fair dequeue policy
+ * bounds its wait)
+ */
+static void print_latency_percentiles(Analytics *a) {
+    static const char *labels[ANALYTICS_CLASSES] = { "High", "Normal", "Low" };
+    LatencyHistogram *h = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    if (h == NULL) {
+        fprintf(stderr, "Warning: No memory for latency percentiles\n");
+        return;
+    }
+    
+    printf("\n--- Latency Percentiles ---\n");
+    printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+           "Class", "Count", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    
+    analytics_latency_histogram(a, ANALYTICS_CLASSES, h);
+    print_percentile_row("All", h);
+    
+    for (int c = 0; c < ANALYTICS_CLASSES; c++) {
+        analytics_latency_histogram(a, c, h);
+        if (histogram_count(h) > 0) {
+            print_percentile_row(labels[c], h);
+        }
+    }
+    
+    free(h);
+}
+
+/*
+ * Print total and p50/p90/p99/p99.9/p99.99/max blocked time per role
+ */
+static void print_wait_times(Analytics *a, const AnalyticsTotals *t) {
+    static const char *labels[ANALYTICS_ROLES] = { "Producer", "Consumer" };
+    const long totals[ANALYTICS_ROLES] = { t->producer_wait_ns, t->consumer_wait_ns };
+    char buffer[32];
+    
+    LatencyHistogram *h = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    if (h == NULL) {
+        fprintf(stderr, "Warning: No memory for wait time percentiles\n");
+        return;
+    }
+    
+    printf("\n--- Wait Times (blocked in queue) ---\n");
+    for (int r = 0; r < ANALYTICS_ROLES; r++) {
+        format_duration_ns((uint64_t)totals[r], buffer, sizeof(buffer));
+        printf("%s Wait Total:      %s\n", labels[r], buffer);
+    }
+    
+    printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+           "Role", "Waits", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    for (int r = 0; r < ANALYTICS_ROLES; r++) {
+        analytics_wait_histogram(a, r, h);
+        if (histogram_count(h) > 0) {
+            print_percentile_row(labels[r], h);
+        }
+    }
+    
+    // How the waits ended: spinning and yielding avoid the park and wakeup
+    const long phases[ANALYTICS_ROLES][3] = {
+        { t->producer_spins, t->producer_yields, t->producer_parks },
+        { t->consumer_spins, t->consumer_yields, t->consumer_parks },
+    };
+    printf("%-10s %10s %10s %10s\n", "Ended by", "Spin", "Yield", "Park");
+    for (int r = 0; r < ANALYTICS_ROLES; r++) {
+        printf("%-10s %10ld %10ld %10ld\n", labels[r], phases[r][0], phases[r][1], phases[r][2]);
+    }
+    
+    free(h);
 }
 
 /*
@@ -141,19 +826,24 @@ void analytics_print_summary(Analytics *a, double runtime, int n_producers, int
         return;
     }
     
-    pthread_mutex_lock(&a->mutex);
+    AnalyticsTotals totals;
+    AnalyticsTotals *t = &totals;
+    analytics_collect(a, t);
     
     printf("--- Performance Metrics ---\n\n");
     
     // Production/Consumption metrics
-    printf("Total Items Produced:     %ld\n", a->total_produced);
-    printf("Total Items Consumed:     %ld\n", a->total_consumed);
-    printf("Items Lost/In-Flight:     %ld\n", a->total_produced - a->total_consumed);
+    printf("Total Items Produced:     %ld\n", t->total_produced);
+    printf("Total Items Consumed:     %ld\n", t->total_consumed);
+    if (a->shed > 0) {
+        printf("Items Shed:               %ld (overflow policy)\n", a->shed);
+    }
+    printf("Items Lost/In-Flight:     %ld\n", t->total_produced - t->total_consumed - a->shed);
     
     // Throughput calculations
     if (runtime > 0) {
-        double produce_rate = (double)a->total_produced / runtime;
-        double consume_rate = (double)a->total_consumed / runtime;
+        double produce_rate = (double)t->total_produced / runtime;
+        double consume_rate = (double)t->total_consumed / runtime;
         printf("\nProduction Rate:          %.2f items/second\n", produce_rate);
         printf("Consumption Rate:         %.2f items/second\n", consume_rate);
         printf("Per-Producer Rate:        %.2f items/sec/producer\n", produce_rate / n_producers);
@@ -161,60 +851,140 @@ void analytics_print_summary(Analytics *a, double runtime, int n_producers, int
     }
     
     // Latency metrics
-    if (a->total_consumed > 0) {
-        double avg_latency = a->total_latency / a->total_consumed;
+    if (t->total_consumed > 0) {
+        char buffer[32];
         printf("\n--- Latency Statistics ---\n");
-        printf("Average Latency:          %.3f seconds\n", avg_latency);
-        printf("Minimum Latency:          %.3f seconds\n", a->min_latency);
-        printf("Maximum Latency:          %.3f seconds\n", a->max_latency);
+        format_duration_ns((uint64_t)(t->total_latency_ns / t->total_consumed), buffer, sizeof(buffer));
+        printf("Average Latency:          %s\n", buffer);
+        format_duration_ns((uint64_t)t->min_latency_ns, buffer, sizeof(buffer));
+        printf("Minimum Latency:          %s\n", buffer);
+        format_duration_ns((uint64_t)t->max_latency_ns, buffer, sizeof(buffer));
+        printf("Maximum Latency:          %s\n", buffer);
+    }
+    
+    // Tail latency (per priority class)
+    if (t->total_consumed > 0) {
+        print_latency_percentiles(a);
     }
     
     // Priority distribution
-    if (a->total_consumed > 0) {
+    if (t->total_consumed > 0) {
         printf("\n--- Priority Distribution ---\n");
         printf("High Priority (9):        %ld (%.1f%%)\n", 
-               a->high_priority_consumed,
-               100.0 * a->high_priority_consumed / a->total_consumed);
+               t->high_priority_consumed,
+               100.0 * t->high_priority_consumed / t->total_consumed);
         printf("Normal Priority (5):      %ld (%.1f%%)\n", 
-               a->normal_priority_consumed,
-               100.0 * a->normal_priority_consumed / a->total_consumed);
+               t->normal_priority_consumed,
+               100.0 * t->normal_priority_consumed / t->total_consumed);
         printf("Low Priority (0):         %ld (%.1f%%)\n", 
-               a->low_priority_consumed,
-               100.0 * a->low_priority_consumed / a->total_consumed);
+               t->low_priority_consumed,
+               100.0 * t->low_priority_consumed / t->total_consumed);
+    }
+    
+    // Batching (items moved per queue operation)
+    if (t->produce_batches != t->total_produced || t->consume_batches != t->total_consumed) {
+        printf("\n--- Batching ---\n");
+        printf("Write Batches:            %ld (%.2f items/batch)\n", t->produce_batches,
+               t->produce_batches > 0 ? (double)t->total_produced / t->produce_batches : 0.0);
+        printf("Read Batches:             %ld (%.2f items/batch)\n", t->consume_batches,
+               t->consume_batches > 0 ? (double)t->total_consumed / t->consume_batches : 0.0);
     }
     
     // Blocking events (key metric for analysis)
     printf("\n--- Blocking Events (Critical Metric) ---\n");
-    printf("Producer Blocks:          %ld times (queue full)\n", a->producer_blocks);
-    printf("Consumer Blocks:          %ld times (queue empty/starved)\n", a->consumer_blocks);
+    printf("Producer Blocks:          %ld times (queue full)\n", t->producer_blocks);
+    printf("Consumer Blocks:          %ld times (queue empty/starved)\n", t->consumer_blocks);
     
-    if (a->total_produced > 0) {
-        double producer_block_rate = 100.0 * a->producer_blocks / a->total_produced;
+    if (t->total_produced > 0) {
+        double producer_block_rate = 100.0 * t->producer_blocks / t->total_produced;
         printf("Producer Block Rate:      %.2f%% of write attempts\n", producer_block_rate);
     }
     
-    if (a->total_consumed > 0) {
-        double consumer_block_rate = 100.0 * a->consumer_blocks / a->total_consumed;
+    if (t->total_consumed > 0) {
+        double consumer_block_rate = 100.0 * t->consumer_blocks / t->total_consumed;
         printf("Consumer Block Rate:      %.2f%% of read attempts\n", consumer_block_rate);
     }
     
+    // Sharded queue load and work stealing
+    if (a->n_shards > 0) {
+        print_shards(a);
+    }
+    
+    // Scheduled workload: offered against achieved load
+    if (a->offered_rate > 0) {
+        print_offered_load(a, t, runtime);
+    }
+    
+    // Zero-copy payload bodies
+    if (a->payload != NULL) {
+        print_payload_pool(a, t, runtime);
+    }
+    
+    // Time spent blocked (backpressure)
+    if (t->producer_blocks > 0 || t->consumer_blocks > 0) {
+        print_wait_times(a, t);
+    }
+    
+    // Items rescued by the drain-on-shutdown phase
+    if (a->drain_ran) {
+        char buffer[32];
+        format_duration_ns(a->drain_ns, buffer, sizeof(buffer));
+        printf("\n--- Drain on Shutdown ---\n");
+        printf("Drain Time:               %s (%s)\n", buffer,
+               a->drain_deadline_hit ? "deadline reached" : "queue emptied");
+        printf("Items Drained:            %ld\n", t->drained);
+        printf("Items Left in Queue:      %ld\n", t->total_produced - t->total_consumed - a->shed);
+    }
+    
     // System utilization assessment
     printf("\n--- System Utilization Assessment ---\n");
-    if (a->producer_blocks > a->total_produced * 0.2) {
+    if (t->producer_blocks > t->total_produced * 0.2) {
         printf("Queue Status:             FREQUENTLY FULL (consider increasing size)\n");
-    } else if (a->consumer_blocks > a->total_consumed * 0.2) {
+    } else if (t->consumer_blocks > t->total_consumed * 0.2) {
         printf("Queue Status:             FREQUENTLY EMPTY (underutilized/consumers starved)\n");
     } else {
         printf("Queue Status:             WELL-BALANCED\n");
     }
     
     // Efficiency metrics
-    if (a->total_produced > 0 && a->total_consumed > 0) {
-        double efficiency = 100.0 * a->total_consumed / a->total_produced;
+    if (t->total_produced > 0 && t->total_consumed > 0) {
+        double efficiency = 100.0 * t->total_consumed / t->total_produced;
         printf("System Efficiency:        %.1f%% (consumed/produced)\n", efficiency);
     }
+}
+
+/*
+ * Print raw queue throughput for benchmark-mode runs
+ * Rates are per queue operation (one batch), ns/op is wall time per
+ * operation across all threads of that role
+ */
+void analytics_print_benchmark(Analytics *a, double runtime, int n_producers, int n_consumers) {
+    if (a == NULL || runtime <= 0) {
+        return;
+    }
+    
+    AnalyticsTotals t;
+    analytics_collect(a, &t);
+    
+    printf("\n--- Benchmark Results ---\n");
+    printf("Items Moved:              %ld (%.0f items/sec)\n",
+           t.total_consumed, t.total_consumed / runtime);
+    
+    if (t.produce_batches > 0) {
+        double ops = t.produce_batches / runtime;
+        printf("Write Ops:                %ld (%.0f ops/sec, %.1f ns/op, %.1f ns/op/thread)\n",
+               t.produce_batches, ops, 1e9 / ops, 1e9 * n_producers / ops);
+        printf("Write Block Rate:         %.2f%% of write ops\n",
+               100.0 * t.producer_blocks / t.produce_batches);
+    }
     
-    pthread_mutex_unlock(&a->mutex);
+    if (t.consume_batches > 0) {
+        double ops = t.consume_batches / runtime;
+        printf("Read Ops:                 %ld (%.0f ops/sec, %.1f ns/op, %.1f ns/op/thread)\n",
+               t.consume_batches, ops, 1e9 / ops, 1e9 * n_consumers / ops);
+        printf("Read Block Rate:          %.2f%% of read ops\n",
+               100.0 * t.consumer_blocks / t.consume_batches);
+    }
 }
 
 /*
@@ -230,6 +1000,11 @@ void analytics_destroy(Analytics *a) {
     }
     
     pthread_mutex_destroy(&a->mutex);
+    for (int i = 0; i <= ANALYTICS_MAX_SLOTS; i++) {
+        free(atomic_load_explicit(&a->slots[i].hist, memory_order_relaxed));
+    }
+    free(a->shards);
+    free(a->slots);
     free(a);
     
     if (DEBUG_MODE) {
@@ -238,18 +1013,17 @@ void analytics_destroy(Analytics *a) {
 }
 
 /*
- * Get current statistics snapshot (thread-safe)
+ * Get current statistics snapshot (thread-safe, does not lock)
  */
 void analytics_get_snapshot(Analytics *a, long *produced, long *consumed, 
                             long *prod_blocks, long *cons_blocks) {
     if (a == NULL) return;
     
-    pthread_mutex_lock(&a->mutex);
-    
-    if (produced) *produced = a->total_produced;
-    if (consumed) *consumed = a->total_consumed;
-    if (prod_blocks) *prod_blocks = a->producer_blocks;
-    if (cons_blocks) *cons_blocks = a->consumer_blocks;
+    AnalyticsTotals t;
+    analytics_collect(a, &t);
     
-    pthread_mutex_unlock(&a->mutex);
+    if (produced) *produced = t.total_produced;
+    if (consumed) *consumed = t.total_consumed;
+    if (prod_blocks) *prod_blocks = t.producer_blocks;
+    if (cons_blocks) *cons_blocks = t.consumer_blocks;
 }
@@ -3,6 +3,8 @@
  * 
  * Each consumer thread reads items from the shared queue and displays them.
  * Implements priority-based consumption as specified in the coursework.
+ * In pipeline mode the items read are then handed to the first stage of
+ * the processing pipeline.
  */
 
 #include <stdio.h>
@@ -12,18 +14,13 @@
 #include "consumer.h"
 #include "queue.h"
 #include "utils.h"
+#include "timing.h"
+#include "logger.h"
+#include "shutdown.h"
+#include "trace.h"
+#include "instrument.h"
 #include "config.h"
 
-/*
- * Helper function to check if queue is empty without blocking
- */
-int queue_is_empty_check(Queue *q) {
-    pthread_mutex_lock(&q->mutex);
-    int is_empty = queue_is_empty(q);
-    pthread_mutex_unlock(&q->mutex);
-    return is_empty;
-}
-
 /*
  * Consumer thread function
  * Continuously reads from queue and processes items until timeout
@@ -39,74 +36,138 @@ void* consumer_thread(void *args) {
     int consumer_id = cargs->id;
     Queue *queue = cargs->queue;
     int max_wait = cargs->max_wait;
-    volatile int *timeout_flag = cargs->timeout_flag;
     Analytics *analytics = cargs->analytics;
     
-    printf("[C%d] Consumer thread started\n", consumer_id);
+    int batch_size = cargs->batch_size > 0 ? cargs->batch_size : 1;
+    int bench_mode = cargs->bench_mode;
+    
+    QueueItem *batch = (QueueItem *)malloc(sizeof(QueueItem) * batch_size);
+    if (batch == NULL) {
+        fprintf(stderr, "[C%d] Error: Failed to allocate batch buffer\n", consumer_id);
+        return NULL;
+    }
+    
+    INSTRUMENT_THREAD_BEGIN("consumer", consumer_id);
+    log_consumer_start(consumer_id);
+    
+    // Trace mode: this thread's own file (no tracing if it cannot be created)
+    TraceWriter *trace = cargs->trace_dir != NULL ?
+                         trace_open(cargs->trace_dir, TRACE_ROLE_CONSUMER, consumer_id) : NULL;
     
-    // Create thread-local random seed
-    unsigned int local_seed = (unsigned int)(get_timestamp() * 1000) + consumer_id + 100;
+    // Thread-local generator for the sleep times
+    RandomState rng;
+    random_state_seed(&rng, timing_now_ns() ^ ((uint64_t)(consumer_id + 100) << 48));
     int items_consumed = 0;
     
     // Main consumer loop - continues until timeout
-    while (!(*timeout_flag)) {
-        QueueItem item;
-        
+    while (!shutdown_requested()) {
         // Check timeout before potentially blocking on empty queue
-        if (*timeout_flag) {
+        if (shutdown_requested()) {
             break;
         }
         
-        // Track if we're about to block
-        int was_empty = queue_is_empty_check(queue);
+        // Attempt to read up to one batch from queue (may block if empty)
+        // The queue reports whether it actually blocked on an empty queue
+        QueueWaitInfo wait;
+        int from_shard = cargs->shard;
+        int result = cargs->shards != NULL ?
+                     sharded_dequeue_batch(cargs->shards, cargs->shard, batch, batch_size,
+                                           &wait, &from_shard) :
+                     queue_dequeue_batch(queue, batch, batch_size, 1, &wait);
         
-        // Attempt to read from queue (may block if empty)
-        int result = queue_dequeue(queue, &item);
+        if (wait.waited) {
+            // We were blocked waiting for data
+            analytics_record_consumer_block(analytics, wait.wait_ns);
+            analytics_record_wait_phases(analytics, ANALYTICS_ROLE_CONSUMER,
+                                         wait.spins, wait.yields, wait.parks);
+            log_consumer_starved(consumer_id);
+            trace_record_wait(trace, TRACE_EVENT_STARVED, consumer_id, wait.wait_ns,
+                              timing_now_ns());
+        }
         
-        if (result == 0) {
-            items_consumed++;
+        if (result > 0) {
+            items_consumed += result;
+            analytics_record_consume_batch(analytics, result);
+            if (cargs->shards != NULL) {
+                analytics_record_shard_consume(analytics, from_shard, result,
+                                               from_shard != cargs->shard);
+            }
+            if (shutdown_draining()) {
+                analytics_record_drain_batch(analytics, result);
+            }
             
             // Calculate latency (time from production to consumption)
-            double current_time = get_timestamp();
-            double latency = current_time - item.timestamp;
-            
-            // Display consumed item
-            printf("[C%d] READ  <- seq=%d, value=%d, priority=%d, from P%d, latency=%.3fs, queue_size=%d\n",
-                   consumer_id, item.sequence, item.value, item.priority, 
-                   item.producer_id, latency, queue_get_size(queue));
+            uint64_t current_time = timing_now_ns();
+            int queue_size = log_enabled(LOG_LEVEL_ITEMS) ? queue_get_size_approx(queue) : 0;
             
-            // Record analytics with priority information
-            analytics_record_consume_priority(analytics, item.priority, latency);
+            for (int b = 0; b < result; b++) {
+                QueueItem *item = &batch[b];
+                uint64_t latency = current_time > item->timestamp ?
+                                   current_time - item->timestamp : 0;
+                
+                // Display consumed item
+                log_read(consumer_id, item, latency, queue_size);
+                
+                // Record analytics with priority information
+                analytics_record_consume_priority(analytics, item->priority, latency);
+                trace_record(trace, TRACE_EVENT_DEQUEUE, item, current_time);
+#if QUEUE_ITEM_PAYLOAD
+                // Process the body in place, then hand the slot back
+                if (item->payload != PAYLOAD_NONE && cargs->payload != NULL) {
+                    size_t length;
+                    const unsigned char *body =
+                        (const unsigned char *)payload_data(cargs->payload, item->payload, &length);
+                    if (body[0] != (unsigned char)item->sequence ||
+                        body[length - 1] != (unsigned char)item->sequence) {
+                        fprintf(stderr, "[C%d] Error: Corrupt payload from P%d seq %d\n",
+                                consumer_id, item->producer_id, item->sequence);
+                    }
+                    analytics_record_payload_consume(analytics, (long)length);
+                    payload_release(cargs->payload, item->payload);
+                }
+#endif
+            }
             
-            if (was_empty) {
-                // We were blocked waiting for data
-                analytics_record_consumer_block(analytics);
-                printf("[C%d] STARVED (queue was empty, waited for data)\n", consumer_id);
+            // Pipeline mode: the stages do the real work (payload bodies
+            // were released above, only the items move on)
+            if (cargs->pipeline != NULL && pipeline_submit(cargs->pipeline, batch, result) < result) {
+                break; // Stopped while the first stage was full
             }
             
         } else {
             // Error reading from queue
-            if (!(*timeout_flag)) {
+            if (!shutdown_requested()) {
                 fprintf(stderr, "[C%d] Error: Failed to dequeue item\n", consumer_id);
             }
             break;
         }
         
+        // Drain phase: read again at once until the queue is empty
+        if (shutdown_draining()) {
+            continue;
+        }
+        
+        // Bench mode: optional fixed pacing instead of the random sleep
+        if (bench_mode) {
+            timing_pause_ns(cargs->pace_ns, cargs->pace_spin);
+            continue;
+        }
+        
         // Wait for random time before next read
-        int wait_time = random_range_seed(1, max_wait, &local_seed);
+        int wait_time = random_state_range(&rng, 1, max_wait);
         
         if (DEBUG_MODE) {
             printf("[C%d] Sleeping for %d second(s)...\n", consumer_id, wait_time);
         }
         
-        // Sleep in small increments to check timeout flag
-        for (int i = 0; i < wait_time && !(*timeout_flag); i++) {
-            sleep(1);
-        }
+        // Sleep on the stop condition so shutdown interrupts the wait at once
+        shutdown_sleep_ns((uint64_t)wait_time * 1000000000ULL);
     }
     
-    printf("[C%d] Consumer thread terminating (consumed %d items)\n", 
-           consumer_id, items_consumed);
+    log_consumer_stop(consumer_id, items_consumed);
+    trace_close(trace);
+    INSTRUMENT_THREAD_END();
     
+    free(batch);
     return NULL;
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+/*
+ * Histogram Implementation
+ * 
+ * Log-linear bucketing: values below HISTOGRAM_SUB_COUNT get one bucket
+ * each, every larger power of two is split into HISTOGRAM_SUB_COUNT equal
+ * buckets. Memory is fixed, recording is O(1) and lock-free, and
+ * percentiles are read by walking the cumulative counts.
+ */
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "histogram.h"
+
+/*
+ * Map a value onto its bucket index
+ */
+static inline int bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return (int)value;
+    }
+    
+    int magnitude = 63 - __builtin_clzll(value);
+    if (magnitude > HISTOGRAM_MAX_MAGNITUDE) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    
+    // Top HISTOGRAM_SUB_BITS + 1 bits select the sub-bucket
+    int shift = magnitude - HISTOGRAM_SUB_BITS;
+    int sub = (int)(value >> shift) - HISTOGRAM_SUB_COUNT;
+    return (magnitude - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+/*
+ * Highest value that maps onto a bucket
+ */
+static uint64_t bucket_upper_value(int index) {
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    
+    int magnitude = index / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+    int shift = magnitude - HISTOGRAM_SUB_BITS;
+    uint64_t sub = (uint64_t)(index % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT);
+    return ((sub + 1) << shift) - 1;
+}
+
+/*
+ * Clear all buckets
+ */
+void histogram_reset(LatencyHistogram *h) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        atomic_init(&h->counts[i], 0);
+    }
+    atomic_init(&h->max, 0);
+}
+
+/*
+ * Record one sample (thread-safe, lock-free)
+ */
+void histogram_record(LatencyHistogram *h, uint64_t value) {
+    atomic_fetch_add_explicit(&h->counts[bucket_index(value)], 1, memory_order_relaxed);
+    
+    // The exact maximum only needs a CAS while a new maximum is being set
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max, &max, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+/*
+ * Record one sample into a histogram only the calling thread writes
+ * (relaxed load and store, no read-modify-write); concurrent readers
+ * still see whole counts
+ */
+void histogram_record_owned(LatencyHistogram *h, uint64_t value) {
+    atomic_ulong *count = &h->counts[bucket_index(value)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    
+    if (value > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+    }
+}
+
+/*
+ * Add the counts of src into dst
+ */
+void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        uint64_t count = atomic_load_explicit(&src->counts[i], memory_order_relaxed);
+        if (count > 0) {
+            atomic_fetch_add_explicit(&dst->counts[i], count, memory_order_relaxed);
+        }
+    }
+    
+    uint64_t max = atomic_load_explicit(&src->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&dst->max, memory_order_relaxed)) {
+        atomic_store_explicit(&dst->max, max, memory_order_relaxed);
+    }
+}
+
+/*
+ * Remove the counts of src (an earlier copy of dst) from dst, leaving the
+ * samples recorded in between; the maximum becomes the upper bound of the
+ * highest remaining bucket, capped at the exact maximum
+ */
+void histogram_subtract(LatencyHistogram *dst, const LatencyHistogram *src) {
+    int highest = -1;
+    
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        uint64_t count = atomic_load_explicit(&dst->counts[i], memory_order_relaxed);
+        uint64_t earlier = atomic_load_explicit(&src->counts[i], memory_order_relaxed);
+        count = count > earlier ? count - earlier : 0;
+        atomic_store_explicit(&dst->counts[i], count, memory_order_relaxed);
+        if (count > 0) {
+            highest = i;
+        }
+    }
+    
+    uint64_t max = atomic_load_explicit(&dst->max, memory_order_relaxed);
+    uint64_t bound = highest >= 0 ? bucket_upper_value(highest) : 0;
+    atomic_store_explicit(&dst->max, bound < max ? bound : max, memory_order_relaxed);
+}
+
+/*
+ * Total number of samples
+ */
+uint64_t histogram_count(const LatencyHistogram *h) {
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+    }
+    return total;
+}
+
+/*
+ * Value at the given percentile (0-100), reported as the upper bound of
+ * the bucket holding it and capped at the exact maximum
+ */
+uint64_t histogram_percentile(const LatencyHistogram *h, double percentile) {
+    uint64_t total = histogram_count(h);
+    if (total == 0) {
+        return 0;
+    }
+    
+    // Rank of the sample we are looking for (1-based)
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > total) {
+        rank = total;
+    }
+    
+    uint64_t max = histogram_max(h);
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t value = bucket_upper_value(i);
+            return value < max ? value : max;
+        }
+    }
+    
+    return max;
+}
+
+/*
+ * Largest recorded sample
+ */
+uint64_t histogram_max(const LatencyHistogram *h) {
+    return atomic_load_explicit(&h->max, memory_order_relaxed);
+}
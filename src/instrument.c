@@ -0,0 +1,446 @@
+/*
+ * Instrumentation Implementation
+ *
+ * Each instrumented thread registers a cache-line aligned record that only
+ * it writes, so the hooks in the hot paths take no lock and share no cache
+ * line; the records are read once the threads have been joined.
+ *
+ * With INSTRUMENT_MODE 0 the hooks in instrument.h are the plain pthread
+ * calls and nothing here is called. With INSTRUMENT_MODE 1 every queue
+ * mutex acquisition is tried first, so an uncontended lock costs a single
+ * clock read and only contended ones are timed as lock wait.
+ *
+ * Hardware counters (-I) are opened per thread with perf_event_open on the
+ * calling thread only (user space, any CPU) and scaled by the time they
+ * were scheduled on the PMU when the kernel had to multiplex them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "instrument.h"
+#include "timing.h"
+#include "utils.h"
+#include "config.h"
+
+static InstrumentThread *records[INSTRUMENT_MAX_THREADS];
+static atomic_int record_count = 0;
+static int perf_enabled = 0;
+static atomic_int perf_errno = 0;           // First perf_event_open failure (0 = none)
+
+// Record of the calling thread (NULL = not instrumented)
+static __thread InstrumentThread *self = NULL;
+
+static const char *kind_names[INSTRUMENT_KINDS] = {
+    "Lock wait", "Lock hold", "Cond wait", "Signal", "Scan", "Shift", "Sleep", "Log"
+};
+
+/*
+ * Select whether threads open hardware counters (call before any thread starts)
+ * Returns 0 on success, -1 if counters are requested but the platform has none
+ */
+int instrument_init(int perf_counters) {
+#ifdef __linux__
+    perf_enabled = perf_counters;
+    return 0;
+#else
+    if (perf_counters) {
+        fprintf(stderr, "Error: hardware counters need perf_event_open (Linux)\n");
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+/*
+ * Open one counter for the calling thread
+ * Returns the file descriptor, or -1
+ */
+static int perf_open(InstrumentPerf counter) {
+#ifdef __linux__
+    static const uint64_t configs[INSTRUMENT_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[counter];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+        int expected = 0;
+        atomic_compare_exchange_strong(&perf_errno, &expected, errno);
+    }
+    return fd;
+#else
+    (void)counter;
+    return -1;
+#endif
+}
+
+/*
+ * Register the calling thread as "<role> <id>" and start its counters
+ * Threads beyond INSTRUMENT_MAX_THREADS (or without memory) are not counted
+ */
+void instrument_thread_begin(const char *role, int id) {
+    int index = atomic_fetch_add(&record_count, 1);
+    if (index >= INSTRUMENT_MAX_THREADS) {
+        return;
+    }
+    
+    InstrumentThread *r = (InstrumentThread *)aligned_alloc(CACHE_LINE_SIZE,
+                                                            sizeof(InstrumentThread));
+    if (r == NULL) {
+        return;
+    }
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "%s %d", role, id);
+    for (int c = 0; c < INSTRUMENT_PERF_COUNTERS; c++) {
+        r->perf_fd[c] = perf_enabled ? perf_open((InstrumentPerf)c) : -1;
+    }
+    r->start_ns = timing_now_ns();
+    
+    records[index] = r;
+    self = r;
+}
+
+/*
+ * Stop the calling thread's clock and read its counters
+ */
+void instrument_thread_end(void) {
+    InstrumentThread *r = self;
+    if (r == NULL) {
+        return;
+    }
+    
+    r->end_ns = timing_now_ns();
+    for (int c = 0; c < INSTRUMENT_PERF_COUNTERS; c++) {
+        if (r->perf_fd[c] < 0) {
+            continue;
+        }
+        // value, time enabled, time running
+        uint64_t v[3];
+        if (read(r->perf_fd[c], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] > 0) {
+            r->perf[c] = v[2] < v[1] ? (uint64_t)((double)v[0] * v[1] / v[2]) : v[0];
+            r->perf_valid[c] = 1;
+        }
+        close(r->perf_fd[c]);
+        r->perf_fd[c] = -1;
+    }
+    self = NULL;
+}
+
+/*
+ * Account one span of kind that started at start_ns
+ */
+void instrument_add(InstrumentKind kind, uint64_t start_ns, uint64_t items) {
+    InstrumentThread *r = self;
+    if (r == NULL) {
+        return;
+    }
+    
+    uint64_t ns = timing_now_ns() - start_ns;
+    r->count[kind]++;
+    r->ns[kind] += ns;
+    r->items[kind] += items;
+    if (ns > r->max_ns[kind]) {
+        r->max_ns[kind] = ns;
+    }
+}
+
+/*
+ * Lock a queue mutex, timing the wait if it is contended
+ */
+void instrument_lock(pthread_mutex_t *mutex) {
+    InstrumentThread *r = self;
+    if (r == NULL) {
+        pthread_mutex_lock(mutex);
+        return;
+    }
+    
+    uint64_t start = timing_now_ns();
+    uint64_t contended = 0;
+    if (pthread_mutex_trylock(mutex) != 0) {
+        pthread_mutex_lock(mutex);
+        contended = 1;
+    }
+    instrument_add(INSTRUMENT_LOCK_WAIT, start, contended);
+    r->hold_start_ns = timing_now_ns();
+}
+
+/*
+ * Unlock a queue mutex, accounting the time it was held
+ */
+void instrument_unlock(pthread_mutex_t *mutex) {
+    InstrumentThread *r = self;
+    if (r != NULL) {
+        instrument_add(INSTRUMENT_LOCK_HOLD, r->hold_start_ns, 0);
+    }
+    pthread_mutex_unlock(mutex);
+}
+
+/*
+ * Wait on a queue condition variable; the mutex is not held while parked,
+ * so the hold so far is closed and a new one starts on wake-up
+ */
+void instrument_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+    InstrumentThread *r = self;
+    if (r == NULL) {
+        pthread_cond_wait(cond, mutex);
+        return;
+    }
+    
+    instrument_add(INSTRUMENT_LOCK_HOLD, r->hold_start_ns, 0);
+    uint64_t start = timing_now_ns();
+    pthread_cond_wait(cond, mutex);
+    instrument_add(INSTRUMENT_COND_WAIT, start, 0);
+    r->hold_start_ns = timing_now_ns();
+}
+
+/*
+ * instrument_cond_wait() with a CLOCK_MONOTONIC deadline
+ * Returns the pthread_cond_timedwait() result
+ */
+int instrument_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                              const struct timespec *deadline) {
+    InstrumentThread *r = self;
+    if (r == NULL) {
+        return pthread_cond_timedwait(cond, mutex, deadline);
+    }
+    
+    instrument_add(INSTRUMENT_LOCK_HOLD, r->hold_start_ns, 0);
+    uint64_t start = timing_now_ns();
+    int result = pthread_cond_timedwait(cond, mutex, deadline);
+    instrument_add(INSTRUMENT_COND_WAIT, start, 0);
+    r->hold_start_ns = timing_now_ns();
+    return result;
+}
+
+/*
+ * Signal or broadcast a queue condition variable, timing the call
+ */
+void instrument_cond_signal(pthread_cond_t *cond, int broadcast) {
+    uint64_t start = timing_now_ns();
+    if (broadcast) {
+        pthread_cond_broadcast(cond);
+    } else {
+        pthread_cond_signal(cond);
+    }
+    instrument_add(INSTRUMENT_SIGNAL, start, (uint64_t)broadcast);
+}
+
+/*
+ * Lifetime of a record (threads that never ended count up to now)
+ */
+static uint64_t record_lifetime(const InstrumentThread *r, uint64_t now) {
+    uint64_t end = r->end_ns != 0 ? r->end_ns : now;
+    return end > r->start_ns ? end - r->start_ns : 0;
+}
+
+/*
+ * Print one row of the critical section table
+ */
+static void print_section_row(const InstrumentThread *r) {
+    char wait[32], hold[32], hold_max[32], cond[32], scan[32], shift[32];
+    format_duration_ns(r->ns[INSTRUMENT_LOCK_WAIT], wait, sizeof(wait));
+    format_duration_ns(r->ns[INSTRUMENT_LOCK_HOLD], hold, sizeof(hold));
+    format_duration_ns(r->max_ns[INSTRUMENT_LOCK_HOLD], hold_max, sizeof(hold_max));
+    format_duration_ns(r->ns[INSTRUMENT_COND_WAIT], cond, sizeof(cond));
+    format_duration_ns(r->ns[INSTRUMENT_SCAN], scan, sizeof(scan));
+    format_duration_ns(r->ns[INSTRUMENT_SHIFT], shift, sizeof(shift));
+    
+    uint64_t scans = r->count[INSTRUMENT_SCAN];
+    uint64_t shifts = r->count[INSTRUMENT_SHIFT];
+    printf("%-14s %9llu %9llu %9s %9s %9s %8llu %9s %9llu %9.1f %9s %9.1f %9s\n", r->name,
+           (unsigned long long)r->count[INSTRUMENT_LOCK_WAIT],
+           (unsigned long long)r->items[INSTRUMENT_LOCK_WAIT], wait, hold, hold_max,
+           (unsigned long long)r->count[INSTRUMENT_COND_WAIT], cond,
+           (unsigned long long)r->count[INSTRUMENT_SIGNAL],
+           scans > 0 ? (double)r->items[INSTRUMENT_SCAN] / scans : 0.0, scan,
+           shifts > 0 ? (double)r->items[INSTRUMENT_SHIFT] / shifts : 0.0, shift);
+}
+
+/*
+ * Print one row of the time breakdown table (shares of the thread lifetime)
+ * Signals are sent with the mutex held, so they are taken out of the hold
+ * time to keep the columns disjoint; scan and shift time stay in the hold
+ */
+static void print_breakdown_row(const InstrumentThread *r, uint64_t lifetime) {
+    uint64_t signal = r->ns[INSTRUMENT_SIGNAL];
+    uint64_t hold = r->ns[INSTRUMENT_LOCK_HOLD];
+    uint64_t shown[] = {
+        r->ns[INSTRUMENT_LOCK_WAIT], hold > signal ? hold - signal : 0,
+        r->ns[INSTRUMENT_COND_WAIT], signal, r->ns[INSTRUMENT_SLEEP], r->ns[INSTRUMENT_LOG]
+    };
+    
+    char life[32];
+    format_duration_ns(lifetime, life, sizeof(life));
+    printf("%-14s %9s", r->name, life);
+    
+    uint64_t accounted = 0;
+    for (size_t i = 0; i < sizeof(shown) / sizeof(shown[0]); i++) {
+        accounted += shown[i];
+        printf(" %8.1f%%", lifetime > 0 ? 100.0 * shown[i] / lifetime : 0.0);
+    }
+    double other = lifetime > accounted ? 100.0 * (lifetime - accounted) / lifetime : 0.0;
+    printf(" %8.1f%%\n", other);
+}
+
+/*
+ * Print one row of the hardware counter table
+ */
+static void print_perf_row(const InstrumentThread *r) {
+    char values[INSTRUMENT_PERF_COUNTERS][32];
+    for (int c = 0; c < INSTRUMENT_PERF_COUNTERS; c++) {
+        if (r->perf_valid[c]) {
+            snprintf(values[c], sizeof(values[c]), "%llu", (unsigned long long)r->perf[c]);
+        } else {
+            snprintf(values[c], sizeof(values[c]), "n/a");
+        }
+    }
+    
+    char ipc[32], mpki[32];
+    snprintf(ipc, sizeof(ipc), "n/a");
+    snprintf(mpki, sizeof(mpki), "n/a");
+    uint64_t cycles = r->perf[INSTRUMENT_PERF_CYCLES];
+    uint64_t instructions = r->perf[INSTRUMENT_PERF_INSTRUCTIONS];
+    if (r->perf_valid[INSTRUMENT_PERF_CYCLES] && r->perf_valid[INSTRUMENT_PERF_INSTRUCTIONS] &&
+        cycles > 0) {
+        snprintf(ipc, sizeof(ipc), "%.2f", (double)instructions / cycles);
+    }
+    if (r->perf_valid[INSTRUMENT_PERF_CACHE_MISSES] &&
+        r->perf_valid[INSTRUMENT_PERF_INSTRUCTIONS] && instructions > 0) {
+        snprintf(mpki, sizeof(mpki), "%.2f",
+                 1000.0 * r->perf[INSTRUMENT_PERF_CACHE_MISSES] / instructions);
+    }
+    printf("%-14s %16s %16s %6s %14s %8s\n", r->name, values[INSTRUMENT_PERF_CYCLES],
+           values[INSTRUMENT_PERF_INSTRUCTIONS], ipc, values[INSTRUMENT_PERF_CACHE_MISSES], mpki);
+}
+
+/*
+ * Print the per-thread breakdown (call after the threads have been joined)
+ */
+void instrument_print_report(double runtime) {
+    int n = atomic_load(&record_count);
+    if (n > INSTRUMENT_MAX_THREADS) {
+        n = INSTRUMENT_MAX_THREADS;
+    }
+    
+    // Totals row: sums over all threads, maxima of the maxima
+    InstrumentThread *total = (InstrumentThread *)aligned_alloc(CACHE_LINE_SIZE,
+                                                                sizeof(InstrumentThread));
+    if (total == NULL) {
+        fprintf(stderr, "Error: Failed to allocate instrumentation totals\n");
+        return;
+    }
+    memset(total, 0, sizeof(*total));
+    snprintf(total->name, sizeof(total->name), "Total");
+    for (int c = 0; c < INSTRUMENT_PERF_COUNTERS; c++) {
+        total->perf_valid[c] = 1;
+    }
+    
+    uint64_t now = timing_now_ns();
+    uint64_t total_lifetime = 0;
+    int counted = 0;
+    for (int i = 0; i < n; i++) {
+        const InstrumentThread *r = records[i];
+        if (r == NULL) {
+            continue;
+        }
+        counted++;
+        total_lifetime += record_lifetime(r, now);
+        for (int k = 0; k < INSTRUMENT_KINDS; k++) {
+            total->count[k] += r->count[k];
+            total->ns[k] += r->ns[k];
+            total->items[k] += r->items[k];
+            if (r->max_ns[k] > total->max_ns[k]) {
+                total->max_ns[k] = r->max_ns[k];
+            }
+        }
+        for (int c = 0; c < INSTRUMENT_PERF_COUNTERS; c++) {
+            total->perf[c] += r->perf[c];
+            total->perf_valid[c] &= r->perf_valid[c];
+        }
+    }
+    
+    printf("\n--- Instrumentation ---\n");
+    printf("Threads Instrumented:     %d", counted);
+    if (atomic_load(&record_count) > INSTRUMENT_MAX_THREADS) {
+        printf(" (first %d of %d)", INSTRUMENT_MAX_THREADS, atomic_load(&record_count));
+    }
+    printf(" over %.2f s\n", runtime);
+    if (counted == 0) {
+        free(total);
+        return;
+    }
+    
+    printf("\nCritical sections:\n");
+    printf("%-14s %9s %9s %9s %9s %9s %8s %9s %9s %9s %9s %9s %9s\n", "Thread", "Locks",
+           "Contended", kind_names[INSTRUMENT_LOCK_WAIT], "Hold", "Hold max", "Parks",
+           kind_names[INSTRUMENT_COND_WAIT], "Signals", "Slots/scn", "Scan",
+           "Items/sft", "Shift");
+    for (int i = 0; i < n; i++) {
+        if (records[i] != NULL) {
+            print_section_row(records[i]);
+        }
+    }
+    print_section_row(total);
+    
+    printf("\nTime breakdown (share of thread lifetime):\n");
+    printf("%-14s %9s %9s %9s %9s %9s %9s %9s %9s\n", "Thread", "Lifetime",
+           kind_names[INSTRUMENT_LOCK_WAIT], "Hold", kind_names[INSTRUMENT_COND_WAIT],
+           kind_names[INSTRUMENT_SIGNAL], kind_names[INSTRUMENT_SLEEP],
+           kind_names[INSTRUMENT_LOG], "Other");
+    for (int i = 0; i < n; i++) {
+        if (records[i] != NULL) {
+            print_breakdown_row(records[i], record_lifetime(records[i], now));
+        }
+    }
+    print_breakdown_row(total, total_lifetime);
+    
+    if (perf_enabled) {
+        printf("\nHardware counters (user space):\n");
+        int err = atomic_load(&perf_errno);
+        if (err != 0) {
+            printf("perf_event_open failed for some counters: %s\n", strerror(err));
+        }
+        printf("%-14s %16s %16s %6s %14s %8s\n", "Thread", "Cycles", "Instructions", "IPC",
+               "Cache misses", "MPKI");
+        for (int i = 0; i < n; i++) {
+            if (records[i] != NULL) {
+                print_perf_row(records[i]);
+            }
+        }
+        print_perf_row(total);
+    }
+    
+    free(total);
+}
+
+/*
+ * Free the thread records
+ */
+void instrument_shutdown(void) {
+    int n = atomic_load(&record_count);
+    if (n > INSTRUMENT_MAX_THREADS) {
+        n = INSTRUMENT_MAX_THREADS;
+    }
+    for (int i = 0; i < n; i++) {
+        free(records[i]);
+        records[i] = NULL;
+    }
+    atomic_store(&record_count, 0);
+}
@@ -0,0 +1,400 @@
+/*
+ * Logger Implementation
+ *
+ * Worker threads never call printf for per-item output. Each thread appends
+ * fixed-size binary records to its own single-producer/single-consumer
+ * ring; one writer thread drains all rings, merges them by timestamp so the
+ * output stays chronological, formats the lines and writes them in large
+ * batches. Only the writer touches the output stream lock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "logger.h"
+#include "timing.h"
+#include "instrument.h"
+#include "config.h"
+
+// Writer sleep when all rings are empty
+#define LOGGER_IDLE_NS 1000000L
+
+// Formatted output is written out in chunks of this size
+#define LOGGER_BUFFER_SIZE (64 * 1024)
+
+// Record types
+typedef enum {
+    LOG_PRODUCER_START = 0,
+    LOG_PRODUCER_STOP,
+    LOG_WRITE,
+    LOG_PRODUCER_BLOCKED,
+    LOG_CONSUMER_START,
+    LOG_CONSUMER_STOP,
+    LOG_READ,
+    LOG_CONSUMER_STARVED
+} LogRecordType;
+
+// One buffered message - everything needed to format the line later
+typedef struct {
+    uint64_t timestamp;         // timing_now_ns() when logged (merge key)
+    uint64_t latency_ns;        // READ: item latency
+    int type;                   // LogRecordType
+    int thread_id;              // Producer or consumer id
+    int sequence;               // Item sequence, or item count for STOP
+    int value;
+    int priority;
+    int producer_id;
+    int queue_size;
+} LogRecord;
+
+// Per-thread ring; head and tail live on separate cache lines
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;   // Next record to drain (writer)
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;   // Next free record (owning thread)
+    _Alignas(CACHE_LINE_SIZE) LogRecord records[LOGGER_RING_SIZE];
+} LogRing;
+
+LogLevel log_level = DEFAULT_LOG_LEVEL;
+
+static FILE *log_out = NULL;
+static pthread_t writer_thread;
+static atomic_int writer_running = 0;
+static atomic_int writer_stop = 0;
+
+// Ring registry, appended under registry_mutex and read by the writer
+static LogRing *rings[LOGGER_MAX_RINGS];
+static atomic_int ring_count = 0;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Ring of the calling thread (NULL until its first message)
+static __thread LogRing *thread_ring = NULL;
+static __thread int thread_ring_failed = 0;
+
+/*
+ * Format one record into buf, returns the number of characters written
+ */
+static int format_record(const LogRecord *r, char *buf, size_t size) {
+    switch (r->type) {
+        case LOG_PRODUCER_START:
+            return snprintf(buf, size, "[P%d] Producer thread started\n", r->thread_id);
+        case LOG_PRODUCER_STOP:
+            return snprintf(buf, size, "[P%d] Producer thread terminating (produced %d items)\n",
+                            r->thread_id, r->sequence);
+        case LOG_WRITE:
+            return snprintf(buf, size, "[P%d] WRITE -> seq=%d, value=%d, priority=%d, queue_size=%d\n",
+                            r->thread_id, r->sequence, r->value, r->priority, r->queue_size);
+        case LOG_PRODUCER_BLOCKED:
+            return snprintf(buf, size, "[P%d] BLOCKED (queue was full, waited for space)\n",
+                            r->thread_id);
+        case LOG_CONSUMER_START:
+            return snprintf(buf, size, "[C%d] Consumer thread started\n", r->thread_id);
+        case LOG_CONSUMER_STOP:
+            return snprintf(buf, size, "[C%d] Consumer thread terminating (consumed %d items)\n",
+                            r->thread_id, r->sequence);
+        case LOG_READ:
+            return snprintf(buf, size, "[C%d] READ  <- seq=%d, value=%d, priority=%d, from P%d, "
+                            "latency=%.6fs, queue_size=%d\n",
+                            r->thread_id, r->sequence, r->value, r->priority, r->producer_id,
+                            r->latency_ns / 1e9, r->queue_size);
+        case LOG_CONSUMER_STARVED:
+            return snprintf(buf, size, "[C%d] STARVED (queue was empty, waited for data)\n",
+                            r->thread_id);
+    }
+    return 0;
+}
+
+/*
+ * Claim a ring for the calling thread
+ * Returns NULL when the registry is full (the thread then logs synchronously)
+ */
+static LogRing* ring_register(void) {
+    LogRing *ring = NULL;
+    
+    pthread_mutex_lock(&registry_mutex);
+    int n = atomic_load_explicit(&ring_count, memory_order_relaxed);
+    if (n < LOGGER_MAX_RINGS &&
+        posix_memalign((void **)&ring, CACHE_LINE_SIZE, sizeof(LogRing)) == 0) {
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        rings[n] = ring;
+        atomic_store_explicit(&ring_count, n + 1, memory_order_release);
+    } else {
+        ring = NULL;
+    }
+    pthread_mutex_unlock(&registry_mutex);
+    
+    return ring;
+}
+
+/*
+ * Queue a record for the writer, or print it directly if there is no writer
+ * A full ring makes the caller yield until the writer catches up, so no
+ * output is lost
+ */
+static void log_submit(LogRecord *r) {
+    r->timestamp = timing_now_ns();
+    
+    if (thread_ring == NULL && !thread_ring_failed &&
+        atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        thread_ring = ring_register();
+        thread_ring_failed = thread_ring == NULL;
+    }
+    
+    LogRing *ring = thread_ring;
+    if (ring == NULL || !atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        char line[256];
+        int len = format_record(r, line, sizeof(line));
+        fwrite(line, 1, (size_t)len, log_out != NULL ? log_out : stdout);
+        INSTRUMENT_END(INSTRUMENT_LOG, r->timestamp, 0);
+        return;
+    }
+    
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= LOGGER_RING_SIZE) {
+        sched_yield();
+    }
+    
+    ring->records[tail & (LOGGER_RING_SIZE - 1)] = *r;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    INSTRUMENT_END(INSTRUMENT_LOG, r->timestamp, 0);
+}
+
+/*
+ * Drain every ring once, merging records by timestamp
+ * Returns the number of records written
+ */
+static long drain_rings(char *buf) {
+    int n = atomic_load_explicit(&ring_count, memory_order_acquire);
+    size_t head[LOGGER_MAX_RINGS];
+    size_t tail[LOGGER_MAX_RINGS];
+    size_t used = 0;
+    long drained = 0;
+    
+    // Snapshot what is available now; later records wait for the next pass
+    for (int i = 0; i < n; i++) {
+        head[i] = atomic_load_explicit(&rings[i]->head, memory_order_relaxed);
+        tail[i] = atomic_load_explicit(&rings[i]->tail, memory_order_acquire);
+    }
+    
+    for (;;) {
+        int next = -1;
+        uint64_t oldest = 0;
+    
+        for (int i = 0; i < n; i++) {
+            if (head[i] == tail[i]) {
+                continue;
+            }
+            uint64_t ts = rings[i]->records[head[i] & (LOGGER_RING_SIZE - 1)].timestamp;
+            if (next < 0 || ts < oldest) {
+                next = i;
+                oldest = ts;
+            }
+        }
+    
+        if (next < 0) {
+            break;
+        }
+    
+        if (LOGGER_BUFFER_SIZE - used < 256) {
+            fwrite(buf, 1, used, log_out);
+            used = 0;
+        }
+    
+        LogRecord *r = &rings[next]->records[head[next] & (LOGGER_RING_SIZE - 1)];
+        used += (size_t)format_record(r, buf + used, LOGGER_BUFFER_SIZE - used);
+        head[next]++;
+        drained++;
+    }
+    
+    if (used > 0) {
+        fwrite(buf, 1, used, log_out);
+    }
+    
+    // Hand the drained records back to their threads
+    for (int i = 0; i < n; i++) {
+        atomic_store_explicit(&rings[i]->head, head[i], memory_order_release);
+    }
+    
+    return drained;
+}
+
+/*
+ * Writer thread: drain until asked to stop, then drain what is left
+ */
+static void* logger_writer(void *arg) {
+    (void)arg;
+    char *buf = (char *)malloc(LOGGER_BUFFER_SIZE);
+    if (buf == NULL) {
+        fprintf(stderr, "Error: Failed to allocate logger buffer\n");
+        return NULL;
+    }
+    
+    struct timespec idle = { 0, LOGGER_IDLE_NS };
+    
+    while (!atomic_load_explicit(&writer_stop, memory_order_acquire)) {
+        if (drain_rings(buf) == 0) {
+            fflush(log_out);
+            nanosleep(&idle, NULL);
+        }
+    }
+    
+    while (drain_rings(buf) > 0) {
+    }
+    fflush(log_out);
+    
+    free(buf);
+    return NULL;
+}
+
+/*
+ * Set the verbosity and start the writer thread
+ * Returns 0 on success, -1 if the writer could not be started (messages
+ * are then printed synchronously)
+ */
+int logger_init(LogLevel level, FILE *out) {
+    log_level = level;
+    log_out = out != NULL ? out : stdout;
+    
+    // Nothing is buffered when worker output is off
+    if (level == LOG_LEVEL_QUIET) {
+        return 0;
+    }
+    
+    atomic_store(&writer_stop, 0);
+    if (pthread_create(&writer_thread, NULL, logger_writer, NULL) != 0) {
+        fprintf(stderr, "Warning: Failed to start logger thread, logging synchronously\n");
+        return -1;
+    }
+    atomic_store_explicit(&writer_running, 1, memory_order_release);
+    
+    return 0;
+}
+
+/*
+ * Flush all buffered messages and stop the writer thread
+ * Call after the worker threads have been joined
+ */
+void logger_shutdown(void) {
+    if (atomic_load(&writer_running)) {
+        atomic_store_explicit(&writer_stop, 1, memory_order_release);
+        pthread_join(writer_thread, NULL);
+        atomic_store(&writer_running, 0);
+    }
+    
+    for (int i = 0; i < atomic_load(&ring_count); i++) {
+        free(rings[i]);
+        rings[i] = NULL;
+    }
+    atomic_store(&ring_count, 0);
+    
+    if (log_out != NULL) {
+        fflush(log_out);
+    }
+}
+
+/*
+ * Producer thread started
+ */
+void log_producer_start(int producer_id) {
+    if (!log_enabled(LOG_LEVEL_EVENTS)) {
+        return;
+    }
+    
+    LogRecord r = { .type = LOG_PRODUCER_START, .thread_id = producer_id };
+    log_submit(&r);
+}
+
+/*
+ * Producer thread terminating
+ */
+void log_producer_stop(int producer_id, int produced) {
+    if (!log_enabled(LOG_LEVEL_EVENTS)) {
+        return;
+    }
+    
+    LogRecord r = { .type = LOG_PRODUCER_STOP, .thread_id = producer_id, .sequence = produced };
+    log_submit(&r);
+}
+
+/*
+ * Item handed to the queue
+ */
+void log_write(int producer_id, const QueueItem *item, int queue_size) {
+    if (!log_enabled(LOG_LEVEL_ITEMS)) {
+        return;
+    }
+    
+    LogRecord r = {
+        .type = LOG_WRITE, .thread_id = producer_id, .sequence = item->sequence,
+        .value = item->value, .priority = item->priority, .queue_size = queue_size
+    };
+    log_submit(&r);
+}
+
+/*
+ * Producer had to wait for space
+ */
+void log_producer_blocked(int producer_id) {
+    if (!log_enabled(LOG_LEVEL_EVENTS)) {
+        return;
+    }
+    
+    LogRecord r = { .type = LOG_PRODUCER_BLOCKED, .thread_id = producer_id };
+    log_submit(&r);
+}
+
+/*
+ * Consumer thread started
+ */
+void log_consumer_start(int consumer_id) {
+    if (!log_enabled(LOG_LEVEL_EVENTS)) {
+        return;
+    }
+    
+    LogRecord r = { .type = LOG_CONSUMER_START, .thread_id = consumer_id };
+    log_submit(&r);
+}
+
+/*
+ * Consumer thread terminating
+ */
+void log_consumer_stop(int consumer_id, int consumed) {
+    if (!log_enabled(LOG_LEVEL_EVENTS)) {
+        return;
+    }
+    
+    LogRecord r = { .type = LOG_CONSUMER_STOP, .thread_id = consumer_id, .sequence = consumed };
+    log_submit(&r);
+}
+
+/*
+ * Item taken from the queue
+ */
+void log_read(int consumer_id, const QueueItem *item, uint64_t latency_ns, int queue_size) {
+    if (!log_enabled(LOG_LEVEL_ITEMS)) {
+        return;
+    }
+    
+    LogRecord r = {
+        .type = LOG_READ, .thread_id = consumer_id, .sequence = item->sequence,
+        .value = item->value, .priority = item->priority, .producer_id = item->producer_id,
+        .queue_size = queue_size, .latency_ns = latency_ns
+    };
+    log_submit(&r);
+}
+
+/*
+ * Consumer had to wait for data
+ */
+void log_consumer_starved(int consumer_id) {
+    if (!log_enabled(LOG_LEVEL_EVENTS)) {
+        return;
+    }
+    
+    LogRecord r = { .type = LOG_CONSUMER_STARVED, .thread_id = consumer_id };
+    log_submit(&r);
+}
@@ -11,49 +11,210 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h>
-#include <signal.h>
 #include <string.h>
 #include "config.h"
 #include "queue.h"
 #include "producer.h"
 #include "consumer.h"
 #include "utils.h"
+#include "timing.h"
+#include "logger.h"
+#include "shard.h"
+#include "shutdown.h"
+#include "reporter.h"
 #include "analytics.h"
-
-// Global timeout flag - volatile as it's accessed by multiple threads
-volatile int timeout_flag = 0;
+#include "affinity.h"
+#include "payload.h"
+#include "trace.h"
+#include "workload.h"
+#include "pipeline.h"
+#include "instrument.h"
 
 // Global analytics structure
 Analytics *global_analytics = NULL;
 
-// Global queue pointer for timeout handler
+// Global queue pointers for the shutdown wake-up (global_shards in sharded mode)
 Queue *global_queue = NULL;
+ShardedQueue *global_shards = NULL;
+
+// Pipeline mode: stages consumers hand their items to (for the wake-up)
+Pipeline *global_pipeline = NULL;
 
-// Signal handler for timeout
-void timeout_handler(int signum) {
-    (void)signum; // Suppress unused parameter warning
-    timeout_flag = 1;
-    printf("\n[TIMEOUT] Timeout reached, signaling all threads to terminate...\n");
-    
-    // Wake up all threads waiting on condition variables
-    if (global_queue != NULL) {
-        pthread_mutex_lock(&global_queue->mutex);
-        pthread_cond_broadcast(&global_queue->not_full);
-        pthread_cond_broadcast(&global_queue->not_empty);
-        pthread_mutex_unlock(&global_queue->mutex);
+// Items the overflow policy discarded or evicted, over every queue
+static long queues_shed(void) {
+    if (global_shards == NULL) {
+        return queue_get_shed(global_queue);
+    }
+    
+    long shed = 0;
+    for (int i = 0; i < global_shards->n_shards; i++) {
+        shed += queue_get_shed(sharded_queue_shard(global_shards, i));
+    }
+    return shed;
+}
+
+// Drain mode: non-zero once no queue holds items (no producer is left)
+// In pipeline mode a batch a consumer has dequeued but not yet submitted
+// is in no queue and not yet in flight. The producers are joined before
+// the drain is waited for, so their delivered total is final: the drain
+// is over once that many items have entered the pipeline and left it.
+static int queues_empty(void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    
+    if (global_shards != NULL) {
+        for (int i = 0; i < global_shards->n_shards; i++) {
+            if (queue_get_size_approx(sharded_queue_shard(global_shards, i)) > 0) {
+                return 0;
+            }
+        }
+    } else if (queue_get_size_approx(global_queue) > 0) {
+        return 0;
     }
+    
+    if (global_pipeline != NULL) {
+        long produced = 0;
+        analytics_get_snapshot(global_analytics, &produced, NULL, NULL, NULL);
+        if (pipeline_entered(global_pipeline) < produced - queues_shed()) {
+            return 0;
+        }
+    }
+    return pipeline_idle(global_pipeline);
+}
+
+// Called by the shutdown thread once the stop flag is set
+static void close_queues(void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    
+    // Closing wakes every thread waiting on the queues' condition variables
+    queue_close(global_queue);
+    sharded_queue_close(global_shards);
+    pipeline_close(global_pipeline);
+}
+
+// Thread tables, sized at runtime from the thread counts
+typedef struct {
+    pthread_t *producer_threads;
+    pthread_t *consumer_threads;
+    ProducerArgs *producer_args;    // Cache-line aligned entries (no false sharing)
+    ConsumerArgs *consumer_args;
+    int *producer_cpus;             // Placement plan (-1 = unpinned)
+    int *consumer_cpus;
+} ThreadTables;
+
+static void thread_tables_free(ThreadTables *t) {
+    free(t->producer_threads);
+    free(t->consumer_threads);
+    free(t->producer_args);
+    free(t->consumer_args);
+    free(t->producer_cpus);
+    free(t->consumer_cpus);
+    memset(t, 0, sizeof(*t));
+}
+
+static int thread_tables_alloc(ThreadTables *t, int n_producers, int n_consumers) {
+    t->producer_threads = (pthread_t *)calloc((size_t)n_producers, sizeof(pthread_t));
+    t->consumer_threads = (pthread_t *)calloc((size_t)n_consumers, sizeof(pthread_t));
+    t->producer_args = (ProducerArgs *)aligned_alloc(CACHE_LINE_SIZE,
+                                                     sizeof(ProducerArgs) * (size_t)n_producers);
+    t->consumer_args = (ConsumerArgs *)aligned_alloc(CACHE_LINE_SIZE,
+                                                     sizeof(ConsumerArgs) * (size_t)n_consumers);
+    t->producer_cpus = (int *)malloc(sizeof(int) * (size_t)n_producers);
+    t->consumer_cpus = (int *)malloc(sizeof(int) * (size_t)n_consumers);
+    if (t->producer_threads == NULL || t->consumer_threads == NULL ||
+        t->producer_args == NULL || t->consumer_args == NULL ||
+        t->producer_cpus == NULL || t->consumer_cpus == NULL) {
+        fprintf(stderr, "Error: Failed to allocate thread tables\n");
+        thread_tables_free(t);
+        return -1;
+    }
+    return 0;
+}
+
+// Positional thread count: a number, or "auto" to size from the online CPUs
+static int parse_thread_count(const char *arg, int *is_auto) {
+    *is_auto = strcmp(arg, "auto") == 0;
+    return *is_auto ? 0 : atoi(arg);
+}
+
+// Create a thread pinned to cpu (cpu < 0: no pinning)
+static int create_thread(pthread_t *thread, int cpu, void *(*fn)(void *), void *arg) {
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0) {
+        return -1;
+    }
+    
+    int rc = affinity_attr_set_cpu(&attr, cpu);
+    if (rc == 0) {
+        rc = pthread_create(thread, &attr, fn, arg);
+    }
+    pthread_attr_destroy(&attr);
+    return rc;
 }
 
 /*
  * Display usage information
  */
 void print_usage(const char *program_name) {
-    fprintf(stderr, "Usage: %s <n_producers> <n_consumers> <queue_size> <timeout_seconds>\n", program_name);
-    fprintf(stderr, "  n_producers: Number of producer threads (1-%d)\n", MAX_PRODUCERS);
-    fprintf(stderr, "  n_consumers: Number of consumer threads (1-%d)\n", MAX_CONSUMERS);
-    fprintf(stderr, "  queue_size:  Maximum queue entries (1-20)\n");
+    fprintf(stderr, "Usage: %s [options] <n_producers> <n_consumers> <queue_size> <timeout_seconds>\n", program_name);
+    fprintf(stderr, "  n_producers: Number of producer threads (1-%d, or auto)\n", MAX_PRODUCERS);
+    fprintf(stderr, "  n_consumers: Number of consumer threads (1-%d, or auto)\n", MAX_CONSUMERS);
+    fprintf(stderr, "               (auto fills the online CPUs: half each when both are auto,\n");
+    fprintf(stderr, "               otherwise the CPUs the other role leaves free)\n");
+    fprintf(stderr, "  queue_size:  Maximum queue entries (%d-%d)\n", MIN_QUEUE_SIZE, MAX_QUEUE_SIZE);
     fprintf(stderr, "  timeout_seconds: Runtime duration in seconds\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -q <backend>  Queue backend: scan (default), bucket, lockfree or spsc\n");
+    fprintf(stderr, "                (spsc is chosen automatically for 1 producer and 1 consumer)\n");
+    fprintf(stderr, "  -W <wait>     Full/empty queue waits: park (default), or adaptive[:<max_spins>]\n");
+    fprintf(stderr, "                to spin, then yield, then park (default max %d spins)\n",
+            QUEUE_SPIN_LIMIT_DEFAULT);
+    fprintf(stderr, "  -Q <policy>   Dequeue policy: strict (default), aging[:<msec>] (+1 level per msec\n");
+    fprintf(stderr, "                waited, default %.1f) or drr (round-robin, level p takes p+1 items)\n",
+            QUEUE_AGING_DEFAULT_NS / 1e6);
+    fprintf(stderr, "                to bound the wait of low priority items (bucket backend)\n");
+    fprintf(stderr, "  -O <policy>   Overflow policy of a full queue: block (default), drop-newest,\n");
+    fprintf(stderr, "                drop-lowest (scan/bucket) or overwrite-oldest (not spsc); not with -S\n");
+    fprintf(stderr, "  -g            Grow the queue (doubling) instead of blocking producers\n");
+    fprintf(stderr, "                (bucket backend unless -q is given)\n");
+    fprintf(stderr, "  -G <n>        Growth limit of -g in entries (default %d, implies -g)\n",
+            QUEUE_GROW_LIMIT_DEFAULT);
+    fprintf(stderr, "  -S <n>        Sharded mode: n queues of queue_size entries (1-n_producers),\n");
+    fprintf(stderr, "                producers write to their own shard, consumers steal across shards\n");
+    fprintf(stderr, "  -d <msec>     Drain on shutdown: producers stop at the timeout, consumers\n");
+    fprintf(stderr, "                empty the queue for at most msec before stopping\n");
+    fprintf(stderr, "  -R <msec>     Report live metrics every msec (interval rates, depth, latency)\n");
+    fprintf(stderr, "  -o <target>   Metrics target for -R: file path (CSV, default metrics.csv),\n");
+    fprintf(stderr, "                statsd:host:port or prom:host:port (UDP)\n");
+    fprintf(stderr, "  -A <policy>   Thread placement: none (default), compact, scatter or pair\n");
+    fprintf(stderr, "                (pair puts producer i and consumer i on CPUs sharing a cache)\n");
+    fprintf(stderr, "  -P <sizes>    Payload mode: each item carries a body of <min>-<max> bytes\n");
+    fprintf(stderr, "                (e.g. 64-64k) written in place in a preallocated slot pool\n");
+    fprintf(stderr, "  -T <dir>      Trace mode: binary event trace per thread in dir (see trace_replay)\n");
+    fprintf(stderr, "  -X <stages>   Pipeline mode: consumers hand items to stages name:workers[:usec],...\n");
+    fprintf(stderr, "                each with its own queue and workers (usec = work per item)\n");
+    fprintf(stderr, "  -L <spec>     Workload: key=value,... or @file with one setting per line\n");
+    fprintf(stderr, "                arrival=sleep|constant|poisson|bursty, rate=<items/s per producer>,\n");
+    fprintf(stderr, "                rate.<id>=<items/s>, burst=<n> (default %d), priority=<high:normal:low>,\n",
+            WORKLOAD_DEFAULT_BURST);
+    fprintf(stderr, "                mode=open|closed (open keeps the schedule under backpressure),\n");
+    fprintf(stderr, "                spin=<usec> busy-waited before each arrival (default %d)\n",
+            WORKLOAD_SPIN_NS / 1000);
+    fprintf(stderr, "  -I            Instrumentation: also read cycle, instruction and cache-miss\n");
+    fprintf(stderr, "                counters per thread (build with INSTRUMENT=1)\n");
+    fprintf(stderr, "  -c <clock>    Timestamp clock: monotonic (default) or tsc\n");
+    fprintf(stderr, "  -b <n>        Items per batch write/read (1-%d, default %d)\n",
+            MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  -v <level>    Thread output: 0 quiet, 1 events, 2 every item (default %d)\n",
+            DEFAULT_LOG_LEVEL);
+    fprintf(stderr, "  -B            Benchmark mode: no sleeps or per-item output, report ops/sec\n");
+    fprintf(stderr, "  -p <usec>     Benchmark mode: pause between operations (default 0 = tight loop)\n");
+    fprintf(stderr, "  -s            Benchmark mode: busy-wait the pause instead of nanosleep\n");
     fprintf(stderr, "\nExample: %s 5 3 10 30\n", program_name);
+    fprintf(stderr, "         %s -B -q lockfree -b 32 4 4 1024 5\n", program_name);
+    fprintf(stderr, "         %s -B -A scatter auto auto 4096 5\n", program_name);
+    fprintf(stderr, "         %s -B -q bucket -L arrival=poisson,rate=200k,mode=open 4 4 1024 5\n",
+            program_name);
+    fprintf(stderr, "         %s -B -X decode:1:2,process:4:10,ack:1:1 2 2 1024 5\n", program_name);
 }
 
 /*
@@ -72,8 +233,9 @@ int validate_arguments(int n_producers, int n_consumers, int queue_size, int tim
         valid = 0;
     }
     
-    if (queue_size < 1 || queue_size > 20) {
-        fprintf(stderr, "Error: queue_size must be between 1 and 20\n");
+    if (queue_size < MIN_QUEUE_SIZE || queue_size > MAX_QUEUE_SIZE) {
+        fprintf(stderr, "Error: queue_size must be between %d and %d\n",
+                MIN_QUEUE_SIZE, MAX_QUEUE_SIZE);
         valid = 0;
     }
     
@@ -86,21 +248,324 @@ int validate_arguments(int n_producers, int n_consumers, int queue_size, int tim
 }
 
 int main(int argc, char *argv[]) {
-    // Parse command line arguments
-    if (argc != 5) {
+    QueueBackend backend = QUEUE_BACKEND_DEFAULT;
+    int backend_explicit = 0;
+    int grow = 0;
+    int grow_limit = QUEUE_GROW_LIMIT_DEFAULT;
+    int batch_size = DEFAULT_BATCH_SIZE;
+    TimingSource clock_source = TIMING_SOURCE_MONOTONIC;
+    int bench_mode = 0;
+    long pace_us = 0;
+    int pace_spin = 0;
+    int log_level_opt = -1;
+    int n_shards = 0;
+    long drain_ms = 0;
+    long report_ms = 0;
+    const char *report_target = "metrics.csv";
+    AffinityPolicy placement = AFFINITY_NONE;
+    size_t payload_min = 0;
+    size_t payload_max = 0;
+    const char *trace_dir = NULL;
+    QueueWaitStrategy wait_strategy = QUEUE_WAIT_PARK;
+    int spin_limit = QUEUE_SPIN_LIMIT_DEFAULT;
+    QueueDequeuePolicy policy = QUEUE_POLICY_STRICT;
+    uint64_t aging_ns = QUEUE_AGING_DEFAULT_NS;
+    QueueOverflowPolicy overflow = QUEUE_OVERFLOW_BLOCK;
+    WorkloadSpec workload;
+    PipelineStageSpec stage_specs[PIPELINE_MAX_STAGES];
+    int n_stages = 0;
+    int opt;
+    
+    workload_spec_default(&workload);
+    
+    // Parse command line options
+    while ((opt = getopt(argc, argv, "q:W:Q:O:gG:b:c:Bp:sv:S:d:R:o:A:P:T:L:X:I")) != -1) {
+        switch (opt) {
+            case 'q':
+                if (queue_backend_from_name(optarg, &backend) != 0) {
+                    fprintf(stderr, "Error: Unknown queue backend '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                backend_explicit = 1;
+                break;
+            case 'W':
+                if (queue_wait_strategy_from_name(optarg, &wait_strategy, &spin_limit) != 0) {
+                    fprintf(stderr, "Error: Unknown wait strategy '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'Q':
+                if (queue_policy_from_name(optarg, &policy, &aging_ns) != 0) {
+                    fprintf(stderr, "Error: Unknown dequeue policy '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'O':
+                if (queue_overflow_from_name(optarg, &overflow) != 0) {
+                    fprintf(stderr, "Error: Unknown overflow policy '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'g':
+                grow = 1;
+                break;
+            case 'G':
+                grow_limit = atoi(optarg);
+                if (grow_limit < MIN_QUEUE_SIZE || grow_limit > MAX_QUEUE_SIZE) {
+                    fprintf(stderr, "Error: growth limit must be between %d and %d\n",
+                            MIN_QUEUE_SIZE, MAX_QUEUE_SIZE);
+                    return EXIT_FAILURE;
+                }
+                grow = 1;
+                break;
+            case 'b':
+                batch_size = atoi(optarg);
+                if (batch_size < 1 || batch_size > MAX_BATCH_SIZE) {
+                    fprintf(stderr, "Error: batch size must be between 1 and %d\n", MAX_BATCH_SIZE);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                if (timing_source_from_name(optarg, &clock_source) != 0) {
+                    fprintf(stderr, "Error: Unknown clock '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B':
+                bench_mode = 1;
+                break;
+            case 'I':
+                if (!INSTRUMENT_MODE) {
+                    fprintf(stderr, "Error: hardware counters need a build with INSTRUMENT=1\n");
+                    return EXIT_FAILURE;
+                }
+                if (instrument_init(1) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                pace_us = atol(optarg);
+                if (pace_us < 0) {
+                    fprintf(stderr, "Error: pacing must not be negative\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's':
+                pace_spin = 1;
+                break;
+            case 'S':
+                n_shards = atoi(optarg);
+                if (n_shards < 1) {
+                    fprintf(stderr, "Error: shard count must be at least 1\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'd':
+                drain_ms = atol(optarg);
+                if (drain_ms < 1) {
+                    fprintf(stderr, "Error: drain deadline must be at least 1 ms\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                report_ms = atol(optarg);
+                if (report_ms < 1) {
+                    fprintf(stderr, "Error: report interval must be at least 1 ms\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                report_target = optarg;
+                break;
+            case 'A':
+                if (affinity_policy_from_name(optarg, &placement) != 0) {
+                    fprintf(stderr, "Error: Unknown placement policy '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                if (payload_parse_sizes(optarg, &payload_min, &payload_max) != 0) {
+                    fprintf(stderr, "Error: payload sizes must be <min>-<max> bytes within 1-%d\n",
+                            PAYLOAD_MAX_SIZE);
+                    return EXIT_FAILURE;
+                }
+                if (!QUEUE_ITEM_PAYLOAD) {
+                    fprintf(stderr, "Error: payload mode needs the 24-byte QueueItem "
+                            "(built with COMPACT_ITEMS=1)\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'T':
+                trace_dir = optarg;
+                break;
+            case 'X':
+                n_stages = pipeline_parse_spec(optarg, stage_specs, PIPELINE_MAX_STAGES);
+                if (n_stages < 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'L':
+                if (workload_spec_parse(&workload, optarg) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'v':
+                log_level_opt = atoi(optarg);
+                if (log_level_opt < LOG_LEVEL_QUIET || log_level_opt > LOG_LEVEL_ITEMS) {
+                    fprintf(stderr, "Error: verbosity must be between %d and %d\n",
+                            LOG_LEVEL_QUIET, LOG_LEVEL_ITEMS);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    
+    // Parse positional arguments
+    if (argc - optind != 4) {
         print_usage(argv[0]);
         return EXIT_FAILURE;
     }
     
-    int n_producers = atoi(argv[1]);
-    int n_consumers = atoi(argv[2]);
-    int queue_size = atoi(argv[3]);
-    int timeout = atoi(argv[4]);
+    int producers_auto;
+    int consumers_auto;
+    int n_producers = parse_thread_count(argv[optind], &producers_auto);
+    int n_consumers = parse_thread_count(argv[optind + 1], &consumers_auto);
+    int queue_size = atoi(argv[optind + 2]);
+    int timeout = atoi(argv[optind + 3]);
+    
+    // Auto sizing: spread the online CPUs over the roles left to "auto"
+    long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online_cpus < 1) {
+        online_cpus = 1;
+    }
+    if (producers_auto && consumers_auto) {
+        n_producers = online_cpus / 2 > 0 ? (int)(online_cpus / 2) : 1;
+        n_consumers = online_cpus - n_producers > 0 ? (int)(online_cpus - n_producers) : 1;
+    } else if (producers_auto) {
+        n_producers = online_cpus - n_consumers > 0 ? (int)(online_cpus - n_consumers) : 1;
+    } else if (consumers_auto) {
+        n_consumers = online_cpus - n_producers > 0 ? (int)(online_cpus - n_producers) : 1;
+    }
     
     // Validate arguments
     if (!validate_arguments(n_producers, n_consumers, queue_size, timeout)) {
         return EXIT_FAILURE;
     }
+    if (n_shards > n_producers) {
+        fprintf(stderr, "Error: shard count must not exceed n_producers (%d)\n", n_producers);
+        return EXIT_FAILURE;
+    }
+    if (pace_us > 0 && workload_scheduled(&workload)) {
+        fprintf(stderr, "Error: -p pacing and a scheduled workload (-L rate) are exclusive\n");
+        return EXIT_FAILURE;
+    }
+    
+    ReporterOptions report_opts;
+    report_opts.interval_ns = (uint64_t)report_ms * 1000000;
+    if (report_ms > 0 && reporter_parse_target(report_target, &report_opts) != 0) {
+        fprintf(stderr, "Error: Invalid metrics target '%s'\n", report_target);
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    // A 1:1 run needs no locking at all: use the SPSC ring unless told otherwise
+    // (growth and sharding need a backend that allows several threads per queue)
+    int backend_auto = 0;
+    if (!backend_explicit && QUEUE_WITH_SPSC &&
+        n_producers == 1 && n_consumers == 1 && !grow && n_shards == 0 &&
+        (overflow == QUEUE_OVERFLOW_BLOCK || overflow == QUEUE_OVERFLOW_DROP_NEWEST)) {
+        backend = QUEUE_BACKEND_SPSC;
+        backend_auto = 1;
+    }
+    if (policy != QUEUE_POLICY_STRICT && !backend_explicit) {
+        backend = QUEUE_BACKEND_BUCKET;
+        backend_auto = 0;
+    }
+    // A grown SCAN ring makes every dequeue an O(n) pass over the backlog
+    if (grow && !backend_explicit && backend == QUEUE_BACKEND_SCAN && QUEUE_WITH_BUCKET) {
+        backend = QUEUE_BACKEND_BUCKET;
+    }
+    if (!queue_backend_available(backend)) {
+        fprintf(stderr, "Error: the %s backend is not compiled in (make BACKENDS=...)\n",
+                queue_backend_name(backend));
+        return EXIT_FAILURE;
+    }
+    if (policy != QUEUE_POLICY_STRICT && backend != QUEUE_BACKEND_BUCKET) {
+        fprintf(stderr, "Error: dequeue policy %s needs the bucket backend\n",
+                queue_policy_name(policy));
+        return EXIT_FAILURE;
+    }
+    if (backend == QUEUE_BACKEND_SPSC && (n_producers > 1 || n_consumers > 1)) {
+        fprintf(stderr, "Error: the spsc backend needs exactly 1 producer and 1 consumer\n");
+        return EXIT_FAILURE;
+    }
+    if (backend == QUEUE_BACKEND_SPSC && grow) {
+        fprintf(stderr, "Error: the spsc backend has a fixed capacity (no -g)\n");
+        return EXIT_FAILURE;
+    }
+    if (backend == QUEUE_BACKEND_SCAN && grow) {
+        fprintf(stderr, "Warning: with -g every scan dequeue walks the whole grown queue "
+                        "(up to %d entries); the bucket backend dequeues in O(1)\n",
+                grow_limit > queue_size ? grow_limit : queue_size);
+    }
+    if ((overflow == QUEUE_OVERFLOW_DROP_LOWEST &&
+         (backend == QUEUE_BACKEND_LOCKFREE || backend == QUEUE_BACKEND_SPSC)) ||
+        (overflow == QUEUE_OVERFLOW_OVERWRITE_OLDEST && backend == QUEUE_BACKEND_SPSC)) {
+        fprintf(stderr, "Error: overflow policy %s is not supported by the %s backend\n",
+                queue_overflow_name(overflow), queue_backend_name(backend));
+        return EXIT_FAILURE;
+    }
+    if (overflow != QUEUE_OVERFLOW_BLOCK && payload_max > 0) {
+        fprintf(stderr, "Error: shed items would keep their payload slots (no -O with -P)\n");
+        return EXIT_FAILURE;
+    }
+    if (overflow != QUEUE_OVERFLOW_BLOCK && n_shards > 0) {
+        // The set's pending count follows the items taken, not the net change
+        fprintf(stderr, "Error: shed items would leave the shards' pending count high (no -O with -S)\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Trace mode: the directory the threads create their files in
+    if (trace_dir != NULL && trace_prepare_dir(trace_dir) != 0) {
+        return EXIT_FAILURE;
+    }
+    
+    // Thread and argument tables for the requested counts
+    ThreadTables tables;
+    if (thread_tables_alloc(&tables, n_producers, n_consumers) != 0) {
+        return EXIT_FAILURE;
+    }
+    
+    // Plan thread placement from the CPU topology; queue storage goes on
+    // the node of the consumers that read it
+    int *producer_cpus = tables.producer_cpus;
+    int *consumer_cpus = tables.consumer_cpus;
+    AffinityTopology topology;
+    if (affinity_topology_load(&topology) != 0 ||
+        affinity_plan(&topology, placement, n_producers, n_consumers,
+                      producer_cpus, consumer_cpus) != 0) {
+        affinity_topology_free(&topology);
+        thread_tables_free(&tables);
+        return EXIT_FAILURE;
+    }
+    
+    // Select the timestamp clock before any thread reads it
+    // (an unusable cycle counter falls back to the monotonic clock)
+    timing_init(clock_source);
+    
+    // Benchmark runs are quiet unless a verbosity is given explicitly
+    if (log_level_opt < 0) {
+        log_level_opt = bench_mode ? LOG_LEVEL_QUIET : DEFAULT_LOG_LEVEL;
+    }
     
     // Print program header
     printf("================================================================================\n");
@@ -113,6 +578,70 @@ int main(int argc, char *argv[]) {
     // Print runtime parameters
     printf("\n--- Runtime Configuration ---\n");
     print_run_parameters(n_producers, n_consumers, queue_size, timeout);
+    if (producers_auto || consumers_auto) {
+        printf("Thread Counts:         auto (%ld online CPU(s))\n", online_cpus);
+    }
+    affinity_print(&topology, placement);
+    printf("Queue Backend:         %s%s\n", queue_backend_name(backend),
+           backend_auto ? " (auto: 1 producer, 1 consumer)" : "");
+    if (wait_strategy == QUEUE_WAIT_ADAPTIVE) {
+        printf("Wait Strategy:         adaptive (spin up to %d, yield, then park)\n", spin_limit);
+    } else {
+        printf("Wait Strategy:         %s\n", queue_wait_strategy_name(wait_strategy));
+    }
+    if (policy == QUEUE_POLICY_AGING) {
+        printf("Dequeue Policy:        aging (+1 level per %.3f ms waited, low overtakes high after %.3f ms)\n",
+               aging_ns / 1e6, aging_ns * (PRIORITY_HIGH - PRIORITY_LOW) / 1e6);
+    } else if (policy == QUEUE_POLICY_DRR) {
+        printf("Dequeue Policy:        drr (level p takes p+1 items per round)\n");
+    } else if (backend == QUEUE_BACKEND_LOCKFREE || backend == QUEUE_BACKEND_SPSC) {
+        printf("Dequeue Policy:        fifo (the %s backend ignores priority)\n",
+               queue_backend_name(backend));
+    } else {
+        printf("Dequeue Policy:        %s\n", queue_policy_name(policy));
+    }
+    printf("Overflow Policy:       %s\n", queue_overflow_name(overflow));
+    printf("Batch Size:            %d\n", batch_size);
+    char workload_text[160];
+    workload_describe(&workload, workload_text, sizeof(workload_text));
+    printf("Workload:              %s\n", workload_text);
+    printf("Clock Source:          %s\n", timing_source_name(timing_source()));
+    printf("Verbosity:             %d\n", log_level_opt);
+    if (n_shards > 0) {
+        printf("Sharded Mode:          ENABLED (%d shard(s) of %d entries, work stealing)\n",
+               n_shards, queue_size);
+    }
+    if (report_ms > 0) {
+        printf("Metrics Reporter:      every %ld ms to %s\n", report_ms, report_target);
+    }
+    if (payload_max > 0) {
+        printf("Payload Bodies:        %zu-%zu bytes (zero-copy slot pool)\n",
+               payload_min, payload_max);
+    }
+    if (trace_dir != NULL) {
+        printf("Trace Files:           %s/{producer,consumer}-<id>.trace\n", trace_dir);
+    }
+    if (n_stages > 0) {
+        printf("Pipeline:              ");
+        for (int s = 0; s < n_stages; s++) {
+            printf("%s%s (%d worker(s), %.1f us/item)", s > 0 ? " -> " : "", stage_specs[s].name,
+                   stage_specs[s].workers, stage_specs[s].work_ns / 1000.0);
+        }
+        printf("\n");
+    }
+    if (drain_ms > 0) {
+        printf("Drain On Shutdown:     ENABLED (deadline %ld ms)\n", drain_ms);
+    }
+    if (bench_mode) {
+        printf("Benchmark Mode:        ENABLED (pacing %ld us, %s)\n", pace_us,
+               pace_spin ? "busy-wait" : "nanosleep");
+    }
+    if (grow) {
+        printf("Grow On Demand:        ENABLED (up to %d entries)\n",
+               grow_limit > queue_size ? grow_limit : queue_size);
+    } else {
+        printf("Grow On Demand:        DISABLED\n");
+    }
     
     // Print compiled defaults
     printf("\n--- Compiled Model Parameters ---\n");
@@ -126,69 +655,222 @@ int main(int argc, char *argv[]) {
     printf("================================================================================\n\n");
     
     // Initialize queue
-    Queue *queue = queue_init(queue_size);
-    if (queue == NULL) {
+    QueueOptions queue_opts;
+    queue_options_default(&queue_opts, queue_size);
+    queue_opts.backend = backend;
+    queue_opts.grow = grow;
+    queue_opts.max_capacity = grow_limit;
+    queue_opts.wait_strategy = wait_strategy;
+    queue_opts.spin_limit = spin_limit;
+    queue_opts.policy = policy;
+    queue_opts.aging_ns = aging_ns;
+    queue_opts.overflow = overflow;
+    queue_opts.numa_node = affinity_node_of(&topology, consumer_cpus[0]);
+    
+    // Sharded mode: one queue per shard, otherwise one shared queue
+    // (a shard lives on the node of its home consumer, else its producer)
+    Queue *queue = NULL;
+    ShardedQueue *shards = NULL;
+    if (n_shards > 0) {
+        int *shard_nodes = (int *)malloc(sizeof(int) * (size_t)n_shards);
+        if (shard_nodes != NULL) {
+            for (int s = 0; s < n_shards; s++) {
+                shard_nodes[s] = affinity_node_of(&topology, s < n_consumers ?
+                                                  consumer_cpus[s] : producer_cpus[s]);
+            }
+        }
+        shards = sharded_queue_init(n_shards, &queue_opts, shard_nodes);
+        free(shard_nodes);
+    } else {
+        queue = queue_init_with(&queue_opts);
+    }
+    affinity_topology_free(&topology);
+    if (queue == NULL && shards == NULL) {
         fprintf(stderr, "Error: Failed to initialize queue\n");
+        thread_tables_free(&tables);
         return EXIT_FAILURE;
     }
     
-    // Set global queue pointer for timeout handler
+    // Set global queue pointers for timeout handler
     global_queue = queue;
+    global_shards = shards;
     
     // Initialize analytics
     global_analytics = analytics_init();
-    if (global_analytics == NULL) {
+    if (global_analytics == NULL ||
+        (shards != NULL && analytics_init_shards(global_analytics, n_shards) != 0)) {
         fprintf(stderr, "Error: Failed to initialize analytics\n");
+        analytics_destroy(global_analytics);
         queue_destroy(queue);
+        sharded_queue_destroy(shards);
+        thread_tables_free(&tables);
         return EXIT_FAILURE;
     }
     
-    // Setup timeout signal handler
-    signal(SIGALRM, timeout_handler);
-    alarm(timeout);
+    // Payload mode: body slots for every item that can be queued or held
+    // in a batch at once (fewer for large classes, see payload_pool_init)
+    PayloadPool *payload = NULL;
+    if (payload_max > 0) {
+        uint32_t slots = (uint32_t)queue_size * (shards != NULL ? (uint32_t)n_shards : 1) +
+                         (uint32_t)(n_producers + n_consumers) * (uint32_t)batch_size;
+        payload = payload_pool_init(payload_min, payload_max, slots, queue_opts.numa_node);
+        if (payload == NULL) {
+            analytics_destroy(global_analytics);
+            queue_destroy(queue);
+            sharded_queue_destroy(shards);
+            thread_tables_free(&tables);
+            return EXIT_FAILURE;
+        }
+        analytics_set_payload_pool(global_analytics, payload);
+    }
+    
+    // Scheduled workload: the summary compares the offered load with the result
+    if (workload_scheduled(&workload)) {
+        double offered = 0;
+        for (int i = 1; i <= n_producers; i++) {
+            offered += workload_rate_for(&workload, i);
+        }
+        analytics_set_offered_load(global_analytics, offered, workload.open_loop);
+    }
+    
+    // Pipeline mode: stage queues built like the main queue, sized like it
+    if (n_stages > 0) {
+        global_pipeline = pipeline_create(stage_specs, n_stages, &queue_opts, n_consumers, batch_size);
+        if (global_pipeline == NULL) {
+            analytics_destroy(global_analytics);
+            queue_destroy(queue);
+            sharded_queue_destroy(shards);
+            payload_pool_destroy(payload);
+            thread_tables_free(&tables);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // Start the run timer and signal handling thread first: every thread
+    // created afterwards inherits its signal mask
+    if (shutdown_init(timeout, (uint64_t)drain_ms * 1000000,
+                      close_queues, NULL) != 0) {
+        analytics_destroy(global_analytics);
+        queue_destroy(queue);
+        sharded_queue_destroy(shards);
+        payload_pool_destroy(payload);
+        pipeline_destroy(global_pipeline);
+        thread_tables_free(&tables);
+        return EXIT_FAILURE;
+    }
+    
+    // Start the asynchronous logger before any worker output
+    logger_init((LogLevel)log_level_opt, stdout);
+    
+    // Start the live metrics reporter (reads the queues and analytics lock-free)
+    if (report_ms > 0 &&
+        reporter_start(&report_opts, global_analytics,
+                       shards != NULL ? shards->shards : &queue,
+                       shards != NULL ? n_shards : 1) != 0) {
+        shutdown_finish();
+        logger_shutdown();
+        analytics_destroy(global_analytics);
+        queue_destroy(queue);
+        sharded_queue_destroy(shards);
+        payload_pool_destroy(payload);
+        pipeline_destroy(global_pipeline);
+        thread_tables_free(&tables);
+        return EXIT_FAILURE;
+    }
+    
+    // Pipeline workers first, so the stages are ready for the first items
+    if (global_pipeline != NULL) {
+        printf("[INIT] Starting %d pipeline stage(s)...\n", n_stages);
+        if (pipeline_start(global_pipeline) != 0) {
+            shutdown_request(NULL); // Stop the workers already started
+            pipeline_join(global_pipeline);
+            shutdown_finish();
+            reporter_stop();
+            logger_shutdown();
+            analytics_destroy(global_analytics);
+            queue_destroy(queue);
+            sharded_queue_destroy(shards);
+            payload_pool_destroy(payload);
+            pipeline_destroy(global_pipeline);
+            thread_tables_free(&tables);
+            return EXIT_FAILURE;
+        }
+    }
     
     // Create producer threads
-    pthread_t producer_threads[MAX_PRODUCERS];
-    ProducerArgs producer_args[MAX_PRODUCERS];
+    pthread_t *producer_threads = tables.producer_threads;
+    ProducerArgs *producer_args = tables.producer_args;
     
     printf("[INIT] Creating %d producer thread(s)...\n", n_producers);
     for (int i = 0; i < n_producers; i++) {
         producer_args[i].id = i + 1;
-        producer_args[i].queue = queue;
+        producer_args[i].shards = shards;
+        producer_args[i].shard = shards != NULL ? sharded_queue_home(shards, i) : 0;
+        producer_args[i].queue = shards != NULL ?
+                                 sharded_queue_shard(shards, producer_args[i].shard) : queue;
         producer_args[i].max_wait = DEFAULT_MAX_PRODUCER_WAIT;
-        producer_args[i].timeout_flag = &timeout_flag;
         producer_args[i].analytics = global_analytics;
+        producer_args[i].batch_size = batch_size;
+        producer_args[i].bench_mode = bench_mode;
+        producer_args[i].pace_ns = (uint64_t)pace_us * 1000;
+        producer_args[i].pace_spin = pace_spin;
+        producer_args[i].payload = payload;
+        producer_args[i].trace_dir = trace_dir;
+        producer_args[i].workload = &workload;
         
-        if (pthread_create(&producer_threads[i], NULL, producer_thread, &producer_args[i]) != 0) {
+        if (create_thread(&producer_threads[i], producer_cpus[i],
+                          producer_thread, &producer_args[i]) != 0) {
             fprintf(stderr, "Error: Failed to create producer thread %d\n", i + 1);
-            timeout_flag = 1; // Signal other threads to stop
+            shutdown_request(NULL); // Signal other threads to stop
             // Clean up already created threads
             for (int j = 0; j < i; j++) {
                 pthread_join(producer_threads[j], NULL);
             }
+            pipeline_join(global_pipeline);
+            shutdown_finish();
+            reporter_stop();
+            logger_shutdown();
             analytics_destroy(global_analytics);
             queue_destroy(queue);
+            sharded_queue_destroy(shards);
+            payload_pool_destroy(payload);
+            pipeline_destroy(global_pipeline);
+            thread_tables_free(&tables);
             return EXIT_FAILURE;
         }
-        printf("[INIT] Producer P%d created (PID: %d, TID: %lu)\n", 
+        printf("[INIT] Producer P%d created (PID: %d, TID: %lu)", 
                i + 1, getpid(), (unsigned long)producer_threads[i]);
+        if (producer_cpus[i] >= 0) {
+            printf(" on CPU %d", producer_cpus[i]);
+        }
+        printf("\n");
     }
     
     // Create consumer threads
-    pthread_t consumer_threads[MAX_CONSUMERS];
-    ConsumerArgs consumer_args[MAX_CONSUMERS];
+    pthread_t *consumer_threads = tables.consumer_threads;
+    ConsumerArgs *consumer_args = tables.consumer_args;
     
     printf("[INIT] Creating %d consumer thread(s)...\n", n_consumers);
     for (int i = 0; i < n_consumers; i++) {
         consumer_args[i].id = i + 1;
-        consumer_args[i].queue = queue;
+        consumer_args[i].shards = shards;
+        consumer_args[i].shard = shards != NULL ? sharded_queue_home(shards, i) : 0;
+        consumer_args[i].queue = shards != NULL ?
+                                 sharded_queue_shard(shards, consumer_args[i].shard) : queue;
         consumer_args[i].max_wait = DEFAULT_MAX_CONSUMER_WAIT;
-        consumer_args[i].timeout_flag = &timeout_flag;
         consumer_args[i].analytics = global_analytics;
+        consumer_args[i].batch_size = batch_size;
+        consumer_args[i].bench_mode = bench_mode;
+        consumer_args[i].pace_ns = (uint64_t)pace_us * 1000;
+        consumer_args[i].pace_spin = pace_spin;
+        consumer_args[i].payload = payload;
+        consumer_args[i].trace_dir = trace_dir;
+        consumer_args[i].pipeline = global_pipeline;
         
-        if (pthread_create(&consumer_threads[i], NULL, consumer_thread, &consumer_args[i]) != 0) {
+        if (create_thread(&consumer_threads[i], consumer_cpus[i],
+                          consumer_thread, &consumer_args[i]) != 0) {
             fprintf(stderr, "Error: Failed to create consumer thread %d\n", i + 1);
-            timeout_flag = 1; // Signal other threads to stop
+            shutdown_request(NULL); // Signal other threads to stop
             // Clean up
             for (int j = 0; j < n_producers; j++) {
                 pthread_join(producer_threads[j], NULL);
@@ -196,19 +878,31 @@ int main(int argc, char *argv[]) {
             for (int j = 0; j < i; j++) {
                 pthread_join(consumer_threads[j], NULL);
             }
+            pipeline_join(global_pipeline);
+            shutdown_finish();
+            reporter_stop();
+            logger_shutdown();
             analytics_destroy(global_analytics);
             queue_destroy(queue);
+            sharded_queue_destroy(shards);
+            payload_pool_destroy(payload);
+            pipeline_destroy(global_pipeline);
+            thread_tables_free(&tables);
             return EXIT_FAILURE;
         }
-        printf("[INIT] Consumer C%d created (PID: %d, TID: %lu)\n", 
+        printf("[INIT] Consumer C%d created (PID: %d, TID: %lu)", 
                i + 1, getpid(), (unsigned long)consumer_threads[i]);
+        if (consumer_cpus[i] >= 0) {
+            printf(" on CPU %d", consumer_cpus[i]);
+        }
+        printf("\n");
     }
     
     printf("\n[RUNNING] All threads created. Model is now executing...\n");
     printf("[RUNNING] Press Ctrl+C to stop early, or wait for timeout.\n\n");
     
     // Record start time
-    double start_time = get_timestamp();
+    uint64_t start_time = timing_now_ns();
     
     // Wait for all producer threads to complete
     for (int i = 0; i < n_producers; i++) {
@@ -218,6 +912,9 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    // Drain mode: consumers keep reading until the queue is empty
+    shutdown_drain_wait(queues_empty, NULL);
+    
     // Wait for all consumer threads to complete
     for (int i = 0; i < n_consumers; i++) {
         pthread_join(consumer_threads[i], NULL);
@@ -226,9 +923,25 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    // Pipeline mode: the stage workers stop with the run as well
+    pipeline_join(global_pipeline);
+    
     // Calculate runtime
-    double end_time = get_timestamp();
-    double runtime = end_time - start_time;
+    uint64_t end_time = timing_now_ns();
+    double runtime = (end_time - start_time) / 1e9;
+    
+    shutdown_finish();
+    reporter_stop();
+    
+    ShutdownDrainStats drain;
+    shutdown_drain_stats(&drain);
+    if (drain.drained) {
+        analytics_set_drain(global_analytics, drain.drain_ns, drain.deadline_hit);
+    }
+    analytics_set_shed(global_analytics, queues_shed());
+    
+    // Flush buffered thread output before the summary
+    logger_shutdown();
     
     // Print final summary
     printf("\n================================================================================\n");
@@ -239,6 +952,41 @@ int main(int argc, char *argv[]) {
     
     // Print analytics summary
     analytics_print_summary(global_analytics, runtime, n_producers, n_consumers);
+    if (bench_mode) {
+        analytics_print_benchmark(global_analytics, runtime, n_producers, n_consumers);
+    }
+    pipeline_print_summary(global_pipeline, runtime);
+    if (INSTRUMENT_MODE) {
+        instrument_print_report(runtime);
+    }
+    
+    if (trace_dir != NULL) {
+        uint64_t trace_files, trace_records;
+        trace_totals(&trace_files, &trace_records);
+        printf("\n--- Trace ---\n");
+        printf("Trace Files:              %llu in %s\n", (unsigned long long)trace_files, trace_dir);
+        printf("Trace Records:            %llu (%zu bytes each)\n",
+               (unsigned long long)trace_records, sizeof(TraceRecord));
+    }
+    
+    if (overflow != QUEUE_OVERFLOW_BLOCK) {
+        long shed = queues_shed();
+        AnalyticsTotals totals;
+        analytics_collect(global_analytics, &totals);
+        printf("\n--- Overflow ---\n");
+        printf("Items Shed:               %ld (%.2f%% of produced, %s)\n", shed,
+               totals.total_produced > 0 ? 100.0 * shed / totals.total_produced : 0.0,
+               queue_overflow_name(overflow));
+    }
+    
+    if (grow) {
+        printf("\n--- Queue Growth ---\n");
+        for (int i = 0; i < (shards != NULL ? n_shards : 1); i++) {
+            Queue *q = shards != NULL ? sharded_queue_shard(shards, i) : queue;
+            printf("Final Capacity:           %d entries (%d doubling(s))\n",
+                   queue_get_capacity(q), q->grow_count);
+        }
+    }
     
     printf("\n================================================================================\n");
     printf("                    All threads terminated cleanly\n");
@@ -247,6 +995,11 @@ int main(int argc, char *argv[]) {
     // Cleanup
     analytics_destroy(global_analytics);
     queue_destroy(queue);
+    sharded_queue_destroy(shards);
+    payload_pool_destroy(payload);
+    pipeline_destroy(global_pipeline);
+    thread_tables_free(&tables);
+    instrument_shutdown();
     
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,261 @@
+/*
+ * Payload Pool Implementation
+ *
+ * Message bodies live in one preallocated arena per power-of-two size
+ * class. Free slots are kept on a lock-free LIFO list per class (the head
+ * carries an ABA tag), so reserving and releasing a body is one CAS and
+ * never calls malloc/free. Recently released slots are reused first,
+ * which keeps the touched part of each arena small and cache-warm.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "payload.h"
+#include "queue_backend.h"
+#include "config.h"
+
+#define FREE_END UINT32_MAX
+
+static inline uint64_t head_pack(uint32_t tag, uint32_t index) {
+    return ((uint64_t)tag << 32) | index;
+}
+
+/*
+ * Size class index holding bodies of size bytes
+ */
+static int class_of(size_t size) {
+    int cls = 0;
+    size_t slot = PAYLOAD_MIN_SIZE;
+    while (slot < size && cls < PAYLOAD_CLASSES - 1) {
+        slot <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+/*
+ * Map one class arena and chain every slot onto the free list
+ */
+static int class_init(PayloadClass *c, size_t slot_size, uint32_t n_slots, int numa_node) {
+    c->slot_size = slot_size;
+    c->n_slots = n_slots;
+    c->arena = (unsigned char *)queue_storage_alloc(slot_size * n_slots, numa_node,
+                                                    &c->arena_bytes);
+    c->next = (_Atomic uint32_t *)malloc(sizeof(*c->next) * n_slots);
+    c->lengths = (uint32_t *)calloc(n_slots, sizeof(uint32_t));
+    if (c->arena == NULL || c->next == NULL || c->lengths == NULL) {
+        fprintf(stderr, "Error: Failed to allocate %u payload slots of %zu bytes\n",
+                n_slots, slot_size);
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < n_slots; i++) {
+        atomic_init(&c->next[i], i + 1 < n_slots ? i + 1 : FREE_END);
+    }
+    atomic_init(&c->free_head, head_pack(0, 0));
+    atomic_init(&c->in_use, 0);
+    atomic_init(&c->peak_in_use, 0);
+    atomic_init(&c->reserved, 0);
+    atomic_init(&c->exhausted, 0);
+    return 0;
+}
+
+/*
+ * Create a pool for bodies of min_size..max_size bytes
+ * Every class in that range gets slots_per_class slots (fewer for large
+ * classes, so one arena stays within PAYLOAD_CLASS_MAX_BYTES)
+ */
+PayloadPool* payload_pool_init(size_t min_size, size_t max_size, uint32_t slots_per_class,
+                               int numa_node) {
+    if (min_size < 1 || min_size > max_size || max_size > PAYLOAD_MAX_SIZE ||
+        slots_per_class < 1) {
+        fprintf(stderr, "Error: Invalid payload pool (%zu-%zu bytes, %u slots)\n",
+                min_size, max_size, slots_per_class);
+        return NULL;
+    }
+    
+    PayloadPool *pool = (PayloadPool *)aligned_alloc(CACHE_LINE_SIZE, sizeof(PayloadPool));
+    if (pool == NULL) {
+        fprintf(stderr, "Error: Failed to allocate payload pool\n");
+        return NULL;
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->min_size = min_size;
+    pool->max_size = max_size;
+    
+    for (int cls = class_of(min_size); cls <= class_of(max_size); cls++) {
+        size_t slot_size = (size_t)PAYLOAD_MIN_SIZE << cls;
+        uint64_t n_slots = slots_per_class;
+        if (n_slots * slot_size > PAYLOAD_CLASS_MAX_BYTES) {
+            n_slots = PAYLOAD_CLASS_MAX_BYTES / slot_size;
+        }
+        if (n_slots > PAYLOAD_SLOT_MASK) {
+            n_slots = PAYLOAD_SLOT_MASK;
+        }
+        if (class_init(&pool->classes[cls], slot_size, (uint32_t)n_slots, numa_node) != 0) {
+            payload_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    
+    return pool;
+}
+
+/*
+ * Unmap every arena and free the pool
+ */
+void payload_pool_destroy(PayloadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    
+    for (int cls = 0; cls < PAYLOAD_CLASSES; cls++) {
+        PayloadClass *c = &pool->classes[cls];
+        queue_storage_free(c->arena, c->arena_bytes);
+        free((void *)c->next);
+        free(c->lengths);
+    }
+    free(pool);
+}
+
+/*
+ * Reserve a slot for a body of size bytes and return where to write it
+ * *ref receives the slot reference to carry in the QueueItem
+ * Returns NULL if the class is exhausted (the caller retries later)
+ */
+void* payload_reserve(PayloadPool *pool, size_t size, uint32_t *ref) {
+    int cls = class_of(size);
+    PayloadClass *c = &pool->classes[cls];
+    if (c->n_slots == 0 || size > c->slot_size) {
+        return NULL;
+    }
+    
+    uint64_t head = atomic_load_explicit(&c->free_head, memory_order_acquire);
+    for (;;) {
+        uint32_t index = (uint32_t)head;
+        if (index == FREE_END) {
+            atomic_fetch_add_explicit(&c->exhausted, 1, memory_order_relaxed);
+            return NULL;
+        }
+    
+        // A stale next[] read is harmless: the tag makes the CAS fail
+        uint32_t next = atomic_load_explicit(&c->next[index], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&c->free_head, &head,
+                                                  head_pack((uint32_t)(head >> 32) + 1, next),
+                                                  memory_order_acquire, memory_order_acquire)) {
+            *ref = ((uint32_t)cls << PAYLOAD_CLASS_SHIFT) | index;
+            break;
+        }
+    }
+    
+    atomic_fetch_add_explicit(&c->reserved, 1, memory_order_relaxed);
+    long in_use = atomic_fetch_add_explicit(&c->in_use, 1, memory_order_relaxed) + 1;
+    long peak = atomic_load_explicit(&c->peak_in_use, memory_order_relaxed);
+    while (in_use > peak &&
+           !atomic_compare_exchange_weak_explicit(&c->peak_in_use, &peak, in_use,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    
+    return c->arena + (size_t)(*ref & PAYLOAD_SLOT_MASK) * c->slot_size;
+}
+
+/*
+ * Record the body length once it has been written in place
+ * (the queue's enqueue publishes it to the consumer)
+ */
+void payload_commit(PayloadPool *pool, uint32_t ref, size_t length) {
+    PayloadClass *c = &pool->classes[ref >> PAYLOAD_CLASS_SHIFT];
+    c->lengths[ref & PAYLOAD_SLOT_MASK] = (uint32_t)length;
+}
+
+/*
+ * Body of a committed slot; *length receives its size
+ */
+const void* payload_data(const PayloadPool *pool, uint32_t ref, size_t *length) {
+    const PayloadClass *c = &pool->classes[ref >> PAYLOAD_CLASS_SHIFT];
+    uint32_t index = ref & PAYLOAD_SLOT_MASK;
+    
+    if (length != NULL) {
+        *length = c->lengths[index];
+    }
+    return c->arena + (size_t)index * c->slot_size;
+}
+
+/*
+ * Return a slot to its class once the body has been processed
+ */
+void payload_release(PayloadPool *pool, uint32_t ref) {
+    if (ref == PAYLOAD_NONE) {
+        return;
+    }
+    
+    PayloadClass *c = &pool->classes[ref >> PAYLOAD_CLASS_SHIFT];
+    uint32_t index = ref & PAYLOAD_SLOT_MASK;
+    
+    uint64_t head = atomic_load_explicit(&c->free_head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&c->next[index], (uint32_t)head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&c->free_head, &head,
+                                                    head_pack((uint32_t)(head >> 32) + 1, index),
+                                                    memory_order_release, memory_order_relaxed));
+    
+    atomic_fetch_sub_explicit(&c->in_use, 1, memory_order_relaxed);
+}
+
+/*
+ * Usage of size class cls
+ * Returns 0 if the class is in use, -1 otherwise
+ */
+int payload_pool_class_stats(const PayloadPool *pool, int cls, PayloadClassStats *stats) {
+    if (pool == NULL || cls < 0 || cls >= PAYLOAD_CLASSES || pool->classes[cls].n_slots == 0) {
+        return -1;
+    }
+    
+    const PayloadClass *c = &pool->classes[cls];
+    stats->slot_size = c->slot_size;
+    stats->n_slots = c->n_slots;
+    stats->in_use = atomic_load_explicit(&c->in_use, memory_order_relaxed);
+    stats->peak_in_use = atomic_load_explicit(&c->peak_in_use, memory_order_relaxed);
+    stats->reserved = atomic_load_explicit(&c->reserved, memory_order_relaxed);
+    stats->exhausted = atomic_load_explicit(&c->exhausted, memory_order_relaxed);
+    return 0;
+}
+
+/*
+ * Parse a body size range: "<size>" or "<min>-<max>", sizes in bytes with
+ * an optional k suffix (e.g. 64-64k)
+ * Returns 0 on success, -1 on a malformed or out-of-range spec
+ */
+int payload_parse_sizes(const char *spec, size_t *min_size, size_t *max_size) {
+    size_t sizes[2];
+    int n = 0;
+    const char *p = spec;
+    
+    while (n < 2) {
+        char *end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        if (*end == 'k' || *end == 'K') {
+            value *= 1024;
+            end++;
+        }
+        sizes[n++] = value;
+        if (*end == '\0') {
+            break;
+        }
+        if (*end != '-' || n == 2) {
+            return -1;
+        }
+        p = end + 1;
+    }
+    
+    *min_size = sizes[0];
+    *max_size = n == 2 ? sizes[1] : sizes[0];
+    if (*min_size < 1 || *min_size > *max_size || *max_size > PAYLOAD_MAX_SIZE) {
+        return -1;
+    }
+    return 0;
+}
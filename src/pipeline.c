@@ -0,0 +1,433 @@
+/*
+ * Pipeline Implementation
+ *
+ * Consumers hand the items they read to a chain of stages, for example
+ * decode -> process -> ack. Every stage has its own input Queue and its
+ * own worker threads; a worker reads a batch from its stage's queue,
+ * processes it in place and writes the whole batch to the next stage's
+ * queue, so a slow stage fills its input queue and backpressure travels
+ * upstream to the consumers and then the producers.
+ *
+ * Each stage records into its own Analytics: items read (consumed) and
+ * passed on (produced), waits on an empty input queue (consumer blocks)
+ * and on a full next queue (producer blocks), and the time every item
+ * spent in the stage - in its input queue plus the stage's work - as the
+ * stage latency. Items are restamped as they enter a stage, so the stage
+ * latencies add up to the time spent in the pipeline. Together with the
+ * per-worker busy time and input queue depth this shows which stage is
+ * the bottleneck and needs more workers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pipeline.h"
+#include "queue.h"
+#include "shutdown.h"
+#include "analytics.h"
+#include "histogram.h"
+#include "instrument.h"
+#include "timing.h"
+#include "utils.h"
+#include "config.h"
+
+/*
+ * Parse a -X stage list: name:workers[:usec],... where usec is the
+ * built-in work per item in microseconds (fractions allowed, default 0)
+ * Returns the number of stages, -1 on error
+ */
+int pipeline_parse_spec(const char *text, PipelineStageSpec *specs, int max_stages) {
+    char *buffer = strdup(text);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: Failed to allocate pipeline spec\n");
+        return -1;
+    }
+    
+    int n = 0;
+    char *save = NULL;
+    for (char *stage = strtok_r(buffer, ",", &save); stage != NULL;
+         stage = strtok_r(NULL, ",", &save)) {
+        if (n == max_stages) {
+            fprintf(stderr, "Error: a pipeline has at most %d stages\n", max_stages);
+            free(buffer);
+            return -1;
+        }
+    
+        PipelineStageSpec *spec = &specs[n];
+        memset(spec, 0, sizeof(*spec));
+        char *name = stage;
+        char *workers = strchr(name, ':');
+        char *work = workers != NULL ? strchr(workers + 1, ':') : NULL;
+        if (workers != NULL) *workers++ = '\0';
+        if (work != NULL) *work++ = '\0';
+    
+        // Each field must be consumed to its end ("3x" is not 3 workers)
+        char *workers_end = NULL;
+        char *work_end = NULL;
+        long n_workers = workers != NULL ? strtol(workers, &workers_end, 10) : 0;
+        double work_us = work != NULL ? strtod(work, &work_end) : 0;
+        if (*name == '\0' || strlen(name) >= PIPELINE_NAME_LEN ||
+            workers_end == workers || workers_end == NULL || *workers_end != '\0' ||
+            (work != NULL && (work_end == work || *work_end != '\0')) ||
+            n_workers < 1 || n_workers > PIPELINE_MAX_WORKERS || work_us < 0 || work_us > 1e6) {
+            fprintf(stderr, "Error: invalid pipeline stage '%s' (name:workers[:usec], "
+                    "name up to %d characters, 1-%d workers)\n",
+                    name, PIPELINE_NAME_LEN - 1, PIPELINE_MAX_WORKERS);
+            free(buffer);
+            return -1;
+        }
+    
+        strcpy(spec->name, name);
+        spec->workers = (int)n_workers;
+        spec->work_ns = (uint64_t)(work_us * 1000.0 + 0.5);
+        n++;
+    }
+    
+    free(buffer);
+    if (n == 0) {
+        fprintf(stderr, "Error: a pipeline needs at least one stage\n");
+        return -1;
+    }
+    return n;
+}
+
+/*
+ * Create the stages and their queues; the workers start with pipeline_start
+ * Every stage queue is built from opts, except that stages always block
+ * when full (no overflow shedding between stages). The SPSC ring is only
+ * kept for a queue with one writer and one reader, others use the bucket
+ * backend.
+ */
+Pipeline* pipeline_create(const PipelineStageSpec *specs, int n_stages,
+                          const QueueOptions *opts, int n_submitters, int batch_size) {
+    if (n_stages < 1 || n_stages > PIPELINE_MAX_STAGES || opts == NULL) {
+        fprintf(stderr, "Error: Invalid pipeline stage count %d\n", n_stages);
+        return NULL;
+    }
+    
+    Pipeline *p = (Pipeline *)calloc(1, sizeof(Pipeline));
+    if (p == NULL) {
+        fprintf(stderr, "Error: Failed to allocate pipeline\n");
+        return NULL;
+    }
+    p->stages = (PipelineStage *)calloc((size_t)n_stages, sizeof(PipelineStage));
+    if (p->stages == NULL) {
+        fprintf(stderr, "Error: Failed to allocate pipeline stages\n");
+        free(p);
+        return NULL;
+    }
+    p->n_stages = n_stages;
+    atomic_init(&p->in_flight, 0);
+    atomic_init(&p->entered, 0);
+    atomic_init(&p->entry_blocks, 0);
+    atomic_init(&p->entry_wait_ns, 0);
+    
+    for (int i = 0; i < n_stages; i++) {
+        PipelineStage *stage = &p->stages[i];
+        stage->spec = specs[i];
+        stage->index = i;
+        stage->in_flight = &p->in_flight;
+        stage->batch_size = batch_size > 0 ? batch_size : 1;
+    
+        int writers = i == 0 ? n_submitters : specs[i - 1].workers;
+        QueueOptions stage_opts = *opts;
+        stage_opts.overflow = QUEUE_OVERFLOW_BLOCK;
+        if (stage_opts.backend == QUEUE_BACKEND_SPSC && (writers > 1 || specs[i].workers > 1)) {
+            stage_opts.backend = QUEUE_WITH_BUCKET ? QUEUE_BACKEND_BUCKET :
+                                 QUEUE_WITH_LOCKFREE ? QUEUE_BACKEND_LOCKFREE : QUEUE_BACKEND_SCAN;
+        }
+    
+        size_t workers_bytes = sizeof(PipelineWorker) * (size_t)specs[i].workers;
+        stage->queue = queue_init_with(&stage_opts);
+        stage->analytics = analytics_init();
+        stage->threads = (pthread_t *)calloc((size_t)specs[i].workers, sizeof(pthread_t));
+        stage->workers = (PipelineWorker *)aligned_alloc(CACHE_LINE_SIZE, workers_bytes);
+        if (stage->queue == NULL || stage->analytics == NULL ||
+            stage->threads == NULL || stage->workers == NULL) {
+            fprintf(stderr, "Error: Failed to initialize pipeline stage '%s'\n", specs[i].name);
+            pipeline_destroy(p);
+            return NULL;
+        }
+        memset(stage->workers, 0, workers_bytes);
+    }
+    
+    // Each stage writes into the input queue of the one after it
+    for (int i = 0; i + 1 < n_stages; i++) {
+        p->stages[i].next = p->stages[i + 1].queue;
+    }
+    return p;
+}
+
+/*
+ * Worker thread: read a batch from the stage's queue, do the stage's work
+ * and hand the batch on, until the run stops
+ */
+static void* pipeline_worker_thread(void *args) {
+    PipelineWorker *worker = (PipelineWorker *)args;
+    PipelineStage *stage = worker->stage;
+    Analytics *analytics = stage->analytics;
+    int batch_size = stage->batch_size;
+    
+    QueueItem *batch = (QueueItem *)malloc(sizeof(QueueItem) * (size_t)batch_size);
+    if (batch == NULL) {
+        fprintf(stderr, "[%s] Error: Failed to allocate batch buffer\n", stage->spec.name);
+        return NULL;
+    }
+    INSTRUMENT_THREAD_BEGIN(stage->spec.name, worker->id);
+    
+    while (!shutdown_requested()) {
+        QueueWaitInfo wait;
+        int result = queue_dequeue_batch(stage->queue, batch, batch_size, 1, &wait);
+        if (wait.waited) {
+            analytics_record_consumer_block(analytics, wait.wait_ns);
+            analytics_record_wait_phases(analytics, ANALYTICS_ROLE_CONSUMER,
+                                         wait.spins, wait.yields, wait.parks);
+        }
+        if (result <= 0) {
+            break; // Stopped
+        }
+        analytics_record_consume_batch(analytics, result);
+    
+        int depth = queue_get_size_approx(stage->queue);
+        worker->depth_sum += depth;
+        worker->depth_samples++;
+        if (depth > worker->depth_max) {
+            worker->depth_max = depth;
+        }
+    
+        // The stage's work, done in place
+        uint64_t start = timing_now_ns();
+        if (stage->spec.fn != NULL) {
+            stage->spec.fn(batch, result, stage->spec.arg);
+        } else {
+            timing_pause_ns(stage->spec.work_ns * (uint64_t)result, 1);
+        }
+        uint64_t done = timing_now_ns();
+        worker->busy_ns += done - start;
+    
+        // Time in this stage, then restamp as the items enter the next one
+        for (int b = 0; b < result; b++) {
+            uint64_t latency = done > batch[b].timestamp ? done - batch[b].timestamp : 0;
+            analytics_record_consume_priority(analytics, batch[b].priority, latency);
+            batch[b].timestamp = done;
+        }
+    
+        int passed = result;
+        if (stage->next != NULL) {
+            passed = queue_enqueue_batch(stage->next, batch, result, &wait);
+            passed = passed > 0 ? passed : 0; // -1: the next queue was closed, none taken
+            if (wait.waited) {
+                analytics_record_producer_block(analytics, wait.wait_ns);
+                analytics_record_wait_phases(analytics, ANALYTICS_ROLE_PRODUCER,
+                                             wait.spins, wait.yields, wait.parks);
+            }
+        }
+        if (passed > 0) {
+            analytics_record_produce_batch(analytics, passed);
+        }
+        // Items leave the pipeline at the last stage (or are dropped at the stop)
+        if (stage->next == NULL || passed < result) {
+            atomic_fetch_sub_explicit(stage->in_flight, stage->next == NULL ? result : result - passed,
+                                      memory_order_release);
+        }
+        if (passed < result) {
+            break; // Stopped while waiting for space downstream
+        }
+    }
+    
+    INSTRUMENT_THREAD_END();
+    free(batch);
+    return NULL;
+}
+
+/*
+ * Start the worker threads of every stage (last stage first, so every
+ * queue has its readers before anything is written to it)
+ * Returns 0 on success, -1 on error (the workers already running stop
+ * with the run and are joined by pipeline_join)
+ */
+int pipeline_start(Pipeline *p) {
+    for (int i = p->n_stages - 1; i >= 0; i--) {
+        PipelineStage *stage = &p->stages[i];
+        for (int w = 0; w < stage->spec.workers; w++) {
+            PipelineWorker *worker = &stage->workers[w];
+            worker->stage = stage;
+            worker->id = w + 1;
+            if (pthread_create(&stage->threads[w], NULL, pipeline_worker_thread, worker) != 0) {
+                fprintf(stderr, "Error: Failed to create worker %d of pipeline stage '%s'\n",
+                        w + 1, stage->spec.name);
+                return -1;
+            }
+            stage->started++;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Hand n items read by a consumer to the first stage (blocks while its
+ * queue is full); the items are restamped as they enter the stage
+ * Returns the number of items taken (fewer once the run stops)
+ */
+int pipeline_submit(Pipeline *p, QueueItem *items, int n) {
+    uint64_t now = timing_now_ns();
+    for (int b = 0; b < n; b++) {
+        items[b].timestamp = now;
+    }
+    
+    // Counted before they become visible, so the count never drops to zero
+    // while a stage still holds them
+    atomic_fetch_add_explicit(&p->in_flight, n, memory_order_relaxed);
+    QueueWaitInfo wait;
+    int result = queue_enqueue_batch(p->stages[0].queue, items, n, &wait);
+    if (result < n) {
+        atomic_fetch_sub_explicit(&p->in_flight, result > 0 ? n - result : n, memory_order_relaxed);
+    }
+    if (result > 0) {
+        atomic_fetch_add_explicit(&p->entered, result, memory_order_release);
+    }
+    if (wait.waited) {
+        atomic_fetch_add_explicit(&p->entry_blocks, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&p->entry_wait_ns, (long)wait.wait_ns, memory_order_relaxed);
+    }
+    return result;
+}
+
+/*
+ * Non-zero once every submitted item has left the last stage: no stage
+ * queue holds items and no worker is still processing a batch (drain)
+ * A NULL pipeline is idle
+ */
+int pipeline_idle(Pipeline *p) {
+    return p == NULL || atomic_load_explicit(&p->in_flight, memory_order_acquire) == 0;
+}
+
+/*
+ * Number of items that have entered the first stage (a NULL pipeline has
+ * taken none)
+ */
+long pipeline_entered(Pipeline *p) {
+    return p == NULL ? 0 : atomic_load_explicit(&p->entered, memory_order_acquire);
+}
+
+/*
+ * Close every stage queue, so workers and submitters parked on one return
+ * (shutdown)
+ */
+void pipeline_close(Pipeline *p) {
+    if (p == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < p->n_stages; i++) {
+        queue_close(p->stages[i].queue);
+    }
+}
+
+/*
+ * Wait for every worker to stop (after the run's stop flag is set)
+ */
+void pipeline_join(Pipeline *p) {
+    if (p == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < p->n_stages; i++) {
+        PipelineStage *stage = &p->stages[i];
+        for (int w = 0; w < stage->started; w++) {
+            pthread_join(stage->threads[w], NULL);
+        }
+        stage->started = 0;
+    }
+}
+
+/*
+ * Print per-stage throughput, busy time, input queue depth, stage latency
+ * and waits, and name the busiest stage
+ * Busy is the share of the run the stage's workers spent in its work
+ */
+void pipeline_print_summary(Pipeline *p, double runtime) {
+    if (p == NULL || runtime <= 0) {
+        return;
+    }
+    
+    LatencyHistogram *h = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    if (h == NULL) {
+        fprintf(stderr, "Error: Failed to allocate pipeline histogram\n");
+        return;
+    }
+    
+    printf("\n--- Pipeline ---\n");
+    printf("%-16s %7s %10s %10s %6s %13s %9s %9s %9s %9s\n", "Stage", "Workers", "Items",
+           "Items/sec", "Busy", "Depth avg/max", "p50", "p99", "Starved", "Blocked");
+    
+    int busiest = 0;
+    double busiest_busy = -1.0;
+    long in_flight = 0;
+    for (int i = 0; i < p->n_stages; i++) {
+        PipelineStage *stage = &p->stages[i];
+        AnalyticsTotals t;
+        analytics_collect(stage->analytics, &t);
+        analytics_latency_histogram(stage->analytics, ANALYTICS_CLASSES, h);
+    
+        uint64_t busy_ns = 0;
+        long depth_sum = 0;
+        long depth_samples = 0;
+        int depth_max = 0;
+        for (int w = 0; w < stage->spec.workers; w++) {
+            PipelineWorker *worker = &stage->workers[w];
+            busy_ns += worker->busy_ns;
+            depth_sum += worker->depth_sum;
+            depth_samples += worker->depth_samples;
+            if (worker->depth_max > depth_max) {
+                depth_max = worker->depth_max;
+            }
+        }
+        double busy = busy_ns / (runtime * 1e9 * stage->spec.workers);
+        if (busy > busiest_busy) {
+            busiest_busy = busy;
+            busiest = i;
+        }
+        in_flight += queue_get_size_approx(stage->queue);
+    
+        char depth[32], p50[32], p99[32];
+        snprintf(depth, sizeof(depth), "%.1f/%d",
+                 depth_samples > 0 ? (double)depth_sum / depth_samples : 0.0, depth_max);
+        format_duration_ns(histogram_percentile(h, 50.0), p50, sizeof(p50));
+        format_duration_ns(histogram_percentile(h, 99.0), p99, sizeof(p99));
+        printf("%-16s %7d %10ld %10.0f %5.1f%% %13s %9s %9s %9ld %9ld\n", stage->spec.name,
+               stage->spec.workers, t.total_produced, t.total_produced / runtime, 100.0 * busy,
+               depth, p50, p99, t.consumer_blocks, t.producer_blocks);
+    }
+    free(h);
+    
+    char buffer[32];
+    format_duration_ns((uint64_t)atomic_load_explicit(&p->entry_wait_ns, memory_order_relaxed),
+                       buffer, sizeof(buffer));
+    printf("Entry Blocks:             %ld (consumers waited %s for the first stage)\n",
+           atomic_load_explicit(&p->entry_blocks, memory_order_relaxed), buffer);
+    printf("Items In Flight:          %ld (left in stage queues)\n", in_flight);
+    printf("Busiest Stage:            %s (%.1f%% busy per worker)%s\n",
+           p->stages[busiest].spec.name, 100.0 * busiest_busy,
+           busiest_busy >= PIPELINE_BOTTLENECK_BUSY ? " - bottleneck, add workers" : "");
+}
+
+/*
+ * Destroy the stages (workers must have been joined)
+ */
+void pipeline_destroy(Pipeline *p) {
+    if (p == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < p->n_stages; i++) {
+        PipelineStage *stage = &p->stages[i];
+        queue_destroy(stage->queue);
+        analytics_destroy(stage->analytics);
+        free(stage->threads);
+        free(stage->workers);
+    }
+    free(p->stages);
+    free(p);
+}
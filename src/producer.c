@@ -4,17 +4,120 @@
  * Each producer thread generates random integer values with assigned priorities
  * and writes them to the shared queue, implementing the producer role in the
  * producer-consumer pattern discussed in lectures.
+ *
+ * The values follow the priority mix of the workload spec, and with a
+ * scheduled arrival process (-L) the producer writes on that schedule
+ * instead of sleeping a random number of seconds between writes.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <string.h>
+#include <sched.h>
 #include "producer.h"
 #include "queue.h"
 #include "utils.h"
+#include "timing.h"
+#include "logger.h"
+#include "shutdown.h"
+#include "trace.h"
+#include "instrument.h"
+#include "workload.h"
 #include "config.h"
 
+#if QUEUE_ITEM_PAYLOAD
+/*
+ * Body size for the next message: a size class of the pool's range is
+ * picked uniformly, then a size within it, so small and large bodies are
+ * both common (sizes are roughly log-uniform)
+ */
+static size_t payload_pick_size(const PayloadPool *pool, RandomState *rng) {
+    int first = -1;
+    int last = -1;
+    for (int cls = 0; cls < PAYLOAD_CLASSES; cls++) {
+        if (pool->classes[cls].n_slots > 0) {
+            if (first < 0) first = cls;
+            last = cls;
+        }
+    }
+    
+    int cls = random_state_range(rng, first, last);
+    size_t slot = pool->classes[cls].slot_size;
+    size_t lo = cls == 0 ? 1 : slot / 2 + 1;
+    size_t hi = slot;
+    if (lo < pool->min_size) lo = pool->min_size;
+    if (hi > pool->max_size) hi = pool->max_size;
+    return lo + (size_t)random_state_range(rng, 0, (int)(hi - lo));
+}
+
+/*
+ * Reserve a body for item, write it in place and commit it
+ * The body is filled with the low byte of the sequence number so
+ * consumers can check what they read
+ * Returns 0 on success, -1 if the pool has no free slot of that size
+ */
+static int payload_attach(PayloadPool *pool, RandomState *rng, QueueItem *item) {
+    size_t size = payload_pick_size(pool, rng);
+    uint32_t ref;
+    unsigned char *body = (unsigned char *)payload_reserve(pool, size, &ref);
+    if (body == NULL) {
+        return -1;
+    }
+    
+    memset(body, (unsigned char)item->sequence, size);
+    payload_commit(pool, ref, size);
+    item->payload = ref;
+    return 0;
+}
+
+#endif
+
+/*
+ * Wait for a scheduled arrival due at due_ns (timing_now_ns clock): long
+ * gaps sleep on the stop condition, short ones in nanosleep, and the last
+ * spin_ns are busy-waited so the arrival is released on time
+ * Returns non-zero if the run stopped during the wait
+ */
+static int wait_for_arrival(uint64_t due_ns, uint64_t spin_ns) {
+    uint64_t now = timing_now_ns();
+    if (due_ns > now + spin_ns) {
+        uint64_t gap = due_ns - now - spin_ns;
+        if (gap >= WORKLOAD_SLEEP_MIN_NS) {
+            if (shutdown_sleep_ns(gap)) {
+                return 1;
+            }
+        } else {
+            timing_pause_ns(gap, 0);
+        }
+    }
+    
+    while (timing_now_ns() < due_ns) {
+        if (shutdown_requested()) {
+            return 1;
+        }
+        cpu_relax();
+    }
+    return shutdown_requested() || shutdown_draining();
+}
+
+/*
+ * Take the next arrival and every further one already due, up to max
+ * (a producer that fell behind catches up in full batches)
+ * Returns the number of arrivals, their due times in due_ns
+ */
+static int collect_arrivals(WorkloadGen *gen, RandomState *rng, uint64_t *due_ns, int max) {
+    uint64_t now = timing_now_ns();
+    int n = 0;
+    
+    do {
+        due_ns[n++] = workload_gen_due(gen);
+        workload_gen_advance(gen, rng);
+    } while (n < max && workload_gen_due(gen) <= now);
+    return n;
+}
+
 /*
  * Producer thread function
  * Continuously generates random data and writes to queue until timeout
@@ -30,99 +133,191 @@ void* producer_thread(void *args) {
     int producer_id = pargs->id;
     Queue *queue = pargs->queue;
     int max_wait = pargs->max_wait;
-    volatile int *timeout_flag = pargs->timeout_flag;
     Analytics *analytics = pargs->analytics;
     
-    printf("[P%d] Producer thread started\n", producer_id);
+    int batch_size = pargs->batch_size > 0 ? pargs->batch_size : 1;
+    int bench_mode = pargs->bench_mode;
+    const WorkloadSpec *workload = pargs->workload;
+    int scheduled = workload_scheduled(workload);
+    
+    QueueItem *batch = (QueueItem *)malloc(sizeof(QueueItem) * batch_size);
+    int *values = (int *)malloc(sizeof(int) * batch_size);
+    uint64_t *due_ns = (uint64_t *)malloc(sizeof(uint64_t) * batch_size);
+    if (batch == NULL || values == NULL || due_ns == NULL) {
+        fprintf(stderr, "[P%d] Error: Failed to allocate batch buffer\n", producer_id);
+        free(batch);
+        free(values);
+        free(due_ns);
+        return NULL;
+    }
+    
+    INSTRUMENT_THREAD_BEGIN("producer", producer_id);
+    log_producer_start(producer_id);
+    
+    // Trace mode: this thread's own file (no tracing if it cannot be created)
+    TraceWriter *trace = pargs->trace_dir != NULL ?
+                         trace_open(pargs->trace_dir, TRACE_ROLE_PRODUCER, producer_id) : NULL;
     
-    unsigned int local_seed = (unsigned int)(get_timestamp() * 1000) + producer_id;
+    // Thread-local generator: no lock shared with other producers
+    RandomState rng;
+    random_state_seed(&rng, timing_now_ns() ^ ((uint64_t)producer_id << 48));
     int sequence_number = 0;
     
-    // Main producer loop - continues until timeout
-    while (!(*timeout_flag)) {
-        sequence_number++;
-        
-        // Generate random data value
-        int value = random_range(RANDOM_VALUE_MIN, RANDOM_VALUE_MAX);
-        
-        // Assign priority based on value
-        // High values (7-9) get high priority
-        // Medium values (4-6) get normal priority  
-        // Low values (0-3) get low priority
-        int priority;
-        if (value >= 7) {
-            priority = PRIORITY_HIGH;
-        } else if (value >= 4) {
-            priority = PRIORITY_NORMAL;
-        } else {
-            priority = PRIORITY_LOW;
+    // Scheduled workload: this producer's arrival timeline
+    WorkloadGen gen;
+    if (scheduled) {
+        workload_gen_init(&gen, workload, producer_id, &rng, timing_now_ns());
+    }
+    
+    // Main producer loop - continues until timeout (or the drain phase starts)
+    while (!shutdown_requested() && !shutdown_draining()) {
+        // Scheduled workload: a batch is the arrivals due by now
+        int n_due = batch_size;
+        if (scheduled) {
+            if (wait_for_arrival(workload_gen_due(&gen), workload->spin_ns)) {
+                break;
+            }
+            n_due = collect_arrivals(&gen, &rng, due_ns, batch_size);
         }
         
-        // Create queue item
-        QueueItem item;
-        item.value = value;
-        item.priority = priority;
-        item.producer_id = producer_id;
-        item.timestamp = get_timestamp();
-        item.sequence = sequence_number;
+        // Generate the data values for the whole batch at once
+        workload_fill_values(workload, &rng, values, n_due);
         
-        if (DEBUG_MODE) {
-            printf("[P%d] Generated: seq=%d, value=%d, priority=%d\n",
-                   producer_id, sequence_number, value, priority);
+        // Generate one batch of items (payload mode: a shorter batch when
+        // the pool runs out of slots, so the bodies already held move on)
+        int n_items = n_due;
+        for (int b = 0; b < n_due; b++) {
+            sequence_number++;
+            int value = values[b];
+            int priority = workload_priority_of(value);
+            
+            // Create queue item (open loop: stamped with its scheduled
+            // time, so latency includes any delay in producing it)
+            QueueItem *item = &batch[b];
+            item->value = value;
+            item->priority = priority;
+            item->producer_id = producer_id;
+            item->timestamp = scheduled && workload->open_loop ? due_ns[b] : timing_now_ns();
+            item->sequence = sequence_number;
+#if QUEUE_ITEM_PAYLOAD
+            item->payload = PAYLOAD_NONE;
+            if (pargs->payload != NULL && payload_attach(pargs->payload, &rng, item) != 0) {
+                sequence_number--;
+                n_items = b;
+                break;
+            }
+#endif
+            
+            if (DEBUG_MODE) {
+                printf("[P%d] Generated: seq=%d, value=%d, priority=%d\n",
+                       producer_id, sequence_number, value, priority);
+            }
         }
         
         // Check timeout before blocking on queue
-        if (*timeout_flag) {
+        if (shutdown_requested() || shutdown_draining()) {
             break;
         }
         
+        // No payload slot at all: wait for consumers to release some
+        if (n_items == 0) {
+            analytics_record_payload_stall(analytics);
+            sched_yield();
+            continue;
+        }
+        
         // Attempt to write to queue (may block if full)
-        printf("[P%d] WRITE -> seq=%d, value=%d, priority=%d, queue_size=%d\n",
-               producer_id, sequence_number, value, priority, queue_get_size(queue));
+        if (log_enabled(LOG_LEVEL_ITEMS)) {
+            int queue_size = queue_get_size_approx(queue);
+            for (int b = 0; b < n_items; b++) {
+                log_write(producer_id, &batch[b], queue_size);
+            }
+        }
         
-        // Track if we're about to block
-        int was_full = queue_is_full_check(queue);
+        // The queue reports whether it actually blocked on a full queue
+        QueueWaitInfo wait;
+        int result = pargs->shards != NULL ?
+                     sharded_enqueue_batch(pargs->shards, pargs->shard, batch, n_items, &wait) :
+                     queue_enqueue_batch(queue, batch, n_items, &wait);
         
-        int result = queue_enqueue(queue, item);
+        if (wait.waited) {
+            // We were blocked waiting for space
+            analytics_record_producer_block(analytics, wait.wait_ns);
+            analytics_record_wait_phases(analytics, ANALYTICS_ROLE_PRODUCER,
+                                         wait.spins, wait.yields, wait.parks);
+            log_producer_blocked(producer_id);
+            trace_record_wait(trace, TRACE_EVENT_BLOCKED, producer_id, wait.wait_ns,
+                              timing_now_ns());
+        }
         
-        if (result == 0) {
-            // Successfully enqueued
-            analytics_record_produce(analytics);
+        if (result > 0 && scheduled) {
+            // How far behind its schedule each arrival reached the queue
+            uint64_t done = timing_now_ns();
+            uint64_t lag_sum = 0;
+            uint64_t lag_max = 0;
+            int late = 0;
+            for (int b = 0; b < result; b++) {
+                uint64_t lag = done > due_ns[b] ? done - due_ns[b] : 0;
+                lag_sum += lag;
+                lag_max = lag > lag_max ? lag : lag_max;
+                late += lag > WORKLOAD_LATE_NS;
+            }
+            analytics_record_schedule_lag(analytics, result, lag_sum, lag_max, late);
             
-            if (was_full) {
-                // We were blocked waiting for space
-                analytics_record_producer_block(analytics);
-                printf("[P%d] BLOCKED (queue was full, waited for space)\n", producer_id);
+            // Closed loop: the backlog of a blocked producer is not made up
+            if (!workload->open_loop) {
+                workload_gen_rebase(&gen, done);
             }
-        } else {
+        }
+        
+        if (result > 0) {
+            // Successfully enqueued (possibly partially if interrupted by timeout)
+            analytics_record_produce_batch(analytics, result);
+            for (int b = 0; b < result && trace != NULL; b++) {
+                trace_record(trace, TRACE_EVENT_ENQUEUE, &batch[b], batch[b].timestamp);
+            }
+            if (pargs->shards != NULL) {
+                analytics_record_shard_produce(analytics, pargs->shard, result);
+            }
+        } else if (!shutdown_requested()) {
             fprintf(stderr, "[P%d] Error: Failed to enqueue item\n", producer_id);
         }
+#if QUEUE_ITEM_PAYLOAD
+        // Bodies of items the queue did not take (stopped while blocked)
+        for (int b = result > 0 ? result : 0; b < n_items && pargs->payload != NULL; b++) {
+            payload_release(pargs->payload, batch[b].payload);
+        }
+#endif
+        
+        // Scheduled workload: the next loop waits for the next arrival
+        if (scheduled) {
+            continue;
+        }
+        
+        // Bench mode: optional fixed pacing instead of the random sleep
+        if (bench_mode) {
+            timing_pause_ns(pargs->pace_ns, pargs->pace_spin);
+            continue;
+        }
         
         // Wait for random time before next write
-        int wait_time = random_range_seed(1, max_wait, &local_seed);
+        int wait_time = random_state_range(&rng, 1, max_wait);
         
         if (DEBUG_MODE) {
             printf("[P%d] Sleeping for %d second(s)...\n", producer_id, wait_time);
         }
         
-        // Sleep in small increments to check timeout flag
-        for (int i = 0; i < wait_time && !(*timeout_flag); i++) {
-            sleep(1);
-        }
+        // Sleep on the stop condition so shutdown interrupts the wait at once
+        shutdown_sleep_ns((uint64_t)wait_time * 1000000000ULL);
     }
     
-    printf("[P%d] Producer thread terminating (produced %d items)\n", 
-           producer_id, sequence_number);
+    log_producer_stop(producer_id, sequence_number);
+    trace_close(trace);
+    INSTRUMENT_THREAD_END();
     
+    free(batch);
+    free(values);
+    free(due_ns);
     return NULL;
 }
 
-/*
- * Helper function to check if queue is full without blocking
- */
-int queue_is_full_check(Queue *q) {
-    pthread_mutex_lock(&q->mutex);
-    int is_full = queue_is_full(q);
-    pthread_mutex_unlock(&q->mutex);
-    return is_full;
-}
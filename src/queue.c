@@ -9,163 +9,649 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
 #include "queue.h"
+#include "queue_backend.h"
+#include "instrument.h"
 #include "config.h"
-extern volatile int timeout_flag;
+
+// Operations table of a queue - a constant when every backend compiled in
+// shares one table, so the public calls below become direct calls
+#if !QUEUE_WITH_LOCKFREE && !QUEUE_WITH_SPSC
+#define QUEUE_OPS(q) (&queue_ops_mutex)
+#elif !QUEUE_WITH_SCAN && !QUEUE_WITH_BUCKET && !QUEUE_WITH_SPSC
+#define QUEUE_OPS(q) (&queue_ops_lockfree)
+#elif !QUEUE_WITH_SCAN && !QUEUE_WITH_BUCKET && !QUEUE_WITH_LOCKFREE
+#define QUEUE_OPS(q) (&queue_ops_spsc)
+#else
+#define QUEUE_OPS(q) ((q)->ops)
+#endif
 
 /*
- * Initialize a new queue with the specified capacity
+ * Fill in default queue options for the given capacity
+ */
+void queue_options_default(QueueOptions *opts, int capacity) {
+    opts->capacity = capacity;
+    opts->backend = QUEUE_BACKEND_DEFAULT;
+    opts->grow = 0;
+    opts->max_capacity = 0;
+    opts->numa_node = -1;
+    opts->wait_strategy = QUEUE_WAIT_PARK;
+    opts->spin_limit = QUEUE_SPIN_LIMIT_DEFAULT;
+    opts->policy = QUEUE_POLICY_STRICT;
+    opts->aging_ns = QUEUE_AGING_DEFAULT_NS;
+    opts->overflow = QUEUE_OVERFLOW_BLOCK;
+}
+
+/*
+ * Initialize a new queue with the specified capacity and default backend
  * Returns pointer to queue on success, NULL on failure
  */
 Queue* queue_init(int capacity) {
-    if (capacity <= 0 || capacity > 20) {
+    QueueOptions opts;
+    queue_options_default(&opts, capacity);
+    return queue_init_with(&opts);
+}
+
+/*
+ * Allocate queue storage
+ * Large blocks are mmap'ed (hugepages first, then transparent hugepage
+ * advice); small blocks are cache-line aligned heap memory. With libnuma
+ * and node >= 0 the pages are mapped on that node instead, before anything
+ * touches them.
+ * *bytes receives the mapped size needed by queue_storage_free()
+ */
+void* queue_storage_alloc(size_t size, int node, size_t *bytes) {
+    void *ptr = NULL;
+    
+#ifdef HAVE_LIBNUMA
+    if (node >= 0 && numa_available() >= 0) {
+        ptr = numa_alloc_onnode(size, node);
+        if (ptr != NULL) {
+#ifdef MADV_HUGEPAGE
+            if (size >= QUEUE_LARGE_ALLOC_BYTES) {
+                madvise(ptr, size, MADV_HUGEPAGE);
+            }
+#endif
+            // numa_alloc_onnode() maps whole pages, munmap() releases them
+            *bytes = size;
+            return ptr;
+        }
+    }
+#else
+    (void)node;
+#endif
+    
+    if (size >= QUEUE_LARGE_ALLOC_BYTES) {
+        size_t huge = (size + QUEUE_HUGEPAGE_SIZE - 1) & ~((size_t)QUEUE_HUGEPAGE_SIZE - 1);
+        
+#ifdef MAP_HUGETLB
+        ptr = mmap(NULL, huge, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            *bytes = huge;
+            return ptr;
+        }
+#endif
+        ptr = mmap(NULL, huge, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(ptr, huge, MADV_HUGEPAGE);
+#endif
+            *bytes = huge;
+            return ptr;
+        }
+        ptr = NULL;
+    }
+    
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0) {
+        return NULL;
+    }
+    *bytes = 0;
+    return ptr;
+}
+
+/*
+ * Release storage obtained from queue_storage_alloc()
+ */
+void queue_storage_free(void *ptr, size_t bytes) {
+    if (ptr == NULL) {
+        return;
+    }
+    
+    if (bytes > 0) {
+        munmap(ptr, bytes);
+    } else {
+        free(ptr);
+    }
+}
+
+/*
+ * The mutex backend queue keeps BUCKET lists rather than a SCAN ring
+ * A constant when only one of the two is compiled in, so the other's
+ * paths drop out
+ */
+static inline int mutex_is_bucket(const Queue *q) {
+    return QUEUE_WITH_BUCKET && (!QUEUE_WITH_SCAN || q->backend == QUEUE_BACKEND_BUCKET);
+}
+
+/*
+ * MUTEX backends: number of queued items
+ * Only stored with the mutex held; the loads are relaxed so the unlocked
+ * readers (approximate size, spin predicates) do not race the writers
+ */
+static inline int mutex_count(Queue *q) {
+    return atomic_load_explicit(&q->size, memory_order_relaxed);
+}
+
+static inline void mutex_set_count(Queue *q, int size) {
+    atomic_store_explicit(&q->size, size, memory_order_relaxed);
+}
+
+/*
+ * Reset the per-priority lists and chain every slot into the free list
+ * Used by the BUCKET backend only
+ */
+static void bucket_reset(Queue *q) {
+    for (int i = 0; i < q->capacity - 1; i++) {
+        q->next[i] = i + 1;
+    }
+    q->next[q->capacity - 1] = -1;
+    q->free_head = 0;
+    
+    for (int p = 0; p < QUEUE_PRIORITY_LEVELS; p++) {
+        q->level_head[p] = -1;
+        q->level_tail[p] = -1;
+    }
+    q->level_bitmap = 0;
+    q->drr_level = QUEUE_PRIORITY_LEVELS - 1;
+    q->drr_credit = 0;
+}
+
+/*
+ * Select the operations table implementing a backend
+ */
+static const QueueOps* queue_ops_for(QueueBackend backend) {
+    switch (backend) {
+        case QUEUE_BACKEND_SCAN:
+            return QUEUE_WITH_SCAN ? &queue_ops_mutex : NULL;
+        case QUEUE_BACKEND_BUCKET:
+            return QUEUE_WITH_BUCKET ? &queue_ops_mutex : NULL;
+        case QUEUE_BACKEND_LOCKFREE:
+#if QUEUE_WITH_LOCKFREE
+            return &queue_ops_lockfree;
+#else
+            return NULL;
+#endif
+        case QUEUE_BACKEND_SPSC:
+#if QUEUE_WITH_SPSC
+            return &queue_ops_spsc;
+#else
+            return NULL;
+#endif
+    }
+    return NULL;
+}
+
+/*
+ * Initialize a new queue from the given options
+ * Returns pointer to queue on success, NULL on failure
+ */
+Queue* queue_init_with(const QueueOptions *opts) {
+    if (opts == NULL) {
+        fprintf(stderr, "Error: Cannot initialize queue from NULL options\n");
+        return NULL;
+    }
+    
+    int capacity = opts->capacity;
+    if (capacity < MIN_QUEUE_SIZE || capacity > MAX_QUEUE_SIZE) {
         fprintf(stderr, "Error: Invalid queue capacity %d\n", capacity);
         return NULL;
     }
     
-    Queue *q = (Queue *)malloc(sizeof(Queue));
-    if (q == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for queue structure\n");
+    int max_capacity = opts->max_capacity > 0 ? opts->max_capacity : QUEUE_GROW_LIMIT_DEFAULT;
+    if (max_capacity > MAX_QUEUE_SIZE) {
+        max_capacity = MAX_QUEUE_SIZE;
+    }
+    if (max_capacity < capacity) {
+        max_capacity = capacity;
+    }
+    
+    const QueueOps *ops = queue_ops_for(opts->backend);
+    if (ops == NULL) {
+        fprintf(stderr, "Error: Queue backend %s is not available in this build\n",
+                queue_backend_name(opts->backend));
         return NULL;
     }
     
-    q->items = (QueueItem *)malloc(sizeof(QueueItem) * capacity);
-    if (q->items == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for queue items\n");
-        free(q);
+    if (opts->policy != QUEUE_POLICY_STRICT && opts->backend != QUEUE_BACKEND_BUCKET) {
+        fprintf(stderr, "Error: Dequeue policy %s needs the bucket backend\n",
+                queue_policy_name(opts->policy));
+        return NULL;
+    }
+    
+    // FIFO rings can drop the new item; the lock-free ring can also evict
+    // its oldest item, which takes a consumer-side pop the SPSC ring's
+    // producer may not do; neither knows item priorities
+    if ((opts->overflow == QUEUE_OVERFLOW_DROP_LOWEST && ops != &queue_ops_mutex) ||
+        (opts->overflow == QUEUE_OVERFLOW_OVERWRITE_OLDEST && opts->backend == QUEUE_BACKEND_SPSC)) {
+        fprintf(stderr, "Error: Overflow policy %s is not supported by the %s backend\n",
+                queue_overflow_name(opts->overflow), queue_backend_name(opts->backend));
+        return NULL;
+    }
+    
+    if (opts->grow && ops->grow == NULL) {
+        fprintf(stderr, "Error: Queue backend %s does not support grow-on-demand\n",
+                queue_backend_name(opts->backend));
+        return NULL;
+    }
+    
+    // Cache-line aligned so the field groups in Queue land on separate lines
+    Queue *q = NULL;
+    if (posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(Queue)) != 0) {
+        q = NULL;
+    }
+    if (q == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for queue structure\n");
         return NULL;
     }
     
+    q->ops = ops;
+    q->items = NULL;
+    q->items_bytes = 0;
     q->capacity = capacity;
-    q->size = 0;
+    atomic_init(&q->size, 0);
+    atomic_init(&q->live_capacity, capacity);
     q->head = 0;
     q->tail = 0;
+    q->backend = opts->backend;
+    q->grow = opts->grow;
+    q->max_capacity = max_capacity;
+    q->grow_count = 0;
+    q->numa_node = opts->numa_node;
+    q->wait_strategy = opts->wait_strategy;
+    q->spin_limit = opts->spin_limit >= QUEUE_SPIN_MIN ? opts->spin_limit : QUEUE_SPIN_MIN;
+    atomic_init(&q->producer_spin, q->spin_limit / 4 > QUEUE_SPIN_MIN ?
+                                   q->spin_limit / 4 : QUEUE_SPIN_MIN);
+    atomic_init(&q->consumer_spin, atomic_load(&q->producer_spin));
+    q->batch_waiters = 0;
+    q->policy = opts->policy;
+    q->aging_ns = opts->aging_ns > 0 ? opts->aging_ns : QUEUE_AGING_DEFAULT_NS;
+    q->drr_level = QUEUE_PRIORITY_LEVELS - 1;
+    q->drr_credit = 0;
+    q->next = NULL;
+    q->next_bytes = 0;
+    q->cells = NULL;
+    q->cells_bytes = 0;
+    q->spsc = NULL;
+    q->overflow = opts->overflow;
+    atomic_init(&q->closed, 0);
+    atomic_init(&q->shed, 0);
     
     // Initialize mutex
     if (pthread_mutex_init(&q->mutex, NULL) != 0) {
         fprintf(stderr, "Error: Failed to initialize queue mutex\n");
-        free(q->items);
         free(q);
         return NULL;
     }
     
-    // Initialize condition variables
-    if (pthread_cond_init(&q->not_full, NULL) != 0) {
+    // Initialize condition variables (CLOCK_MONOTONIC, for the timed calls)
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    
+    if (pthread_cond_init(&q->not_full, &cond_attr) != 0) {
         fprintf(stderr, "Error: Failed to initialize not_full condition variable\n");
+        pthread_condattr_destroy(&cond_attr);
         pthread_mutex_destroy(&q->mutex);
-        free(q->items);
         free(q);
         return NULL;
     }
     
-    if (pthread_cond_init(&q->not_empty, NULL) != 0) {
+    if (pthread_cond_init(&q->not_empty, &cond_attr) != 0) {
         fprintf(stderr, "Error: Failed to initialize not_empty condition variable\n");
+        pthread_condattr_destroy(&cond_attr);
+        pthread_cond_destroy(&q->not_full);
+        pthread_mutex_destroy(&q->mutex);
+        free(q);
+        return NULL;
+    }
+    pthread_condattr_destroy(&cond_attr);
+    
+    // Allocate backend storage
+    if (QUEUE_OPS(q)->init(q) != 0) {
+        pthread_cond_destroy(&q->not_empty);
         pthread_cond_destroy(&q->not_full);
         pthread_mutex_destroy(&q->mutex);
-        free(q->items);
         free(q);
         return NULL;
     }
     
     if (DEBUG_MODE) {
-        printf("[QUEUE] Initialized queue with capacity %d\n", capacity);
+        printf("[QUEUE] Initialized %s queue with capacity %d\n",
+               queue_backend_name(q->backend), capacity);
     }
     
     return q;
 }
 
+/*
+ * Get the printable name of a backend
+ */
+const char* queue_backend_name(QueueBackend backend) {
+    switch (backend) {
+        case QUEUE_BACKEND_SCAN:     return "scan";
+        case QUEUE_BACKEND_BUCKET:   return "bucket";
+        case QUEUE_BACKEND_LOCKFREE: return "lockfree";
+        case QUEUE_BACKEND_SPSC:     return "spsc";
+    }
+    return "unknown";
+}
+
+/*
+ * Parse a backend name ("scan", "bucket", "lockfree" or "spsc")
+ * Returns 0 on success, -1 if the name is not recognized
+ */
+int queue_backend_from_name(const char *name, QueueBackend *backend) {
+    if (name == NULL || backend == NULL) {
+        return -1;
+    }
+    
+    if (strcmp(name, "scan") == 0) {
+        *backend = QUEUE_BACKEND_SCAN;
+    } else if (strcmp(name, "bucket") == 0) {
+        *backend = QUEUE_BACKEND_BUCKET;
+    } else if (strcmp(name, "lockfree") == 0) {
+        *backend = QUEUE_BACKEND_LOCKFREE;
+    } else if (strcmp(name, "spsc") == 0) {
+        *backend = QUEUE_BACKEND_SPSC;
+    } else {
+        return -1;
+    }
+    
+    return 0;
+}
+
+/*
+ * The backend is compiled into this build (see QUEUE_WITH_* in config.h)
+ */
+int queue_backend_available(QueueBackend backend) {
+    return queue_ops_for(backend) != NULL;
+}
+
+/*
+ * Name of a wait strategy, for reports
+ */
+const char* queue_wait_strategy_name(QueueWaitStrategy strategy) {
+    switch (strategy) {
+        case QUEUE_WAIT_PARK:     return "park";
+        case QUEUE_WAIT_ADAPTIVE: return "adaptive";
+    }
+    return "unknown";
+}
+
+/*
+ * Parse a wait strategy: "park", "adaptive" or "adaptive:<max_spins>"
+ * *spin_limit receives the spin limit (unchanged unless given)
+ * Returns 0 on success, -1 if the name is not recognized
+ */
+int queue_wait_strategy_from_name(const char *name, QueueWaitStrategy *strategy, int *spin_limit) {
+    if (strcmp(name, "park") == 0) {
+        *strategy = QUEUE_WAIT_PARK;
+    } else if (strncmp(name, "adaptive", 8) == 0 && (name[8] == '\0' || name[8] == ':')) {
+        if (name[8] == ':') {
+            char *end;
+            long limit = strtol(name + 9, &end, 10);
+            if (end == name + 9 || *end != '\0' || limit < QUEUE_SPIN_MIN || limit > 1000000) {
+                return -1;
+            }
+            *spin_limit = (int)limit;
+        }
+        *strategy = QUEUE_WAIT_ADAPTIVE;
+    } else {
+        return -1;
+    }
+    
+    return 0;
+}
+
+/*
+ * Name of a dequeue policy, for reports
+ */
+const char* queue_policy_name(QueueDequeuePolicy policy) {
+    switch (policy) {
+        case QUEUE_POLICY_STRICT: return "strict";
+        case QUEUE_POLICY_AGING:  return "aging";
+        case QUEUE_POLICY_DRR:    return "drr";
+    }
+    return "unknown";
+}
+
+/*
+ * Parse a dequeue policy: "strict", "aging", "aging:<msec per level>"
+ * (fractions allowed) or "drr"
+ * *aging_ns receives the aging step (unchanged unless given)
+ * Returns 0 on success, -1 if the name is not recognized
+ */
+int queue_policy_from_name(const char *name, QueueDequeuePolicy *policy, uint64_t *aging_ns) {
+    if (strcmp(name, "strict") == 0) {
+        *policy = QUEUE_POLICY_STRICT;
+    } else if (strcmp(name, "drr") == 0) {
+        *policy = QUEUE_POLICY_DRR;
+    } else if (strncmp(name, "aging", 5) == 0 && (name[5] == '\0' || name[5] == ':')) {
+        if (name[5] == ':') {
+            char *end;
+            double ms = strtod(name + 6, &end);
+            if (end == name + 6 || *end != '\0' || !(ms >= 0.001) || ms > 3600000.0) {
+                return -1;
+            }
+            *aging_ns = (uint64_t)(ms * 1e6);
+        }
+        *policy = QUEUE_POLICY_AGING;
+    } else {
+        return -1;
+    }
+    
+    return 0;
+}
+
+/*
+ * Name of an overflow policy, for reports
+ */
+const char* queue_overflow_name(QueueOverflowPolicy overflow) {
+    switch (overflow) {
+        case QUEUE_OVERFLOW_BLOCK:            return "block";
+        case QUEUE_OVERFLOW_DROP_NEWEST:      return "drop-newest";
+        case QUEUE_OVERFLOW_DROP_LOWEST:      return "drop-lowest";
+        case QUEUE_OVERFLOW_OVERWRITE_OLDEST: return "overwrite-oldest";
+    }
+    return "unknown";
+}
+
+/*
+ * Parse an overflow policy: "block", "drop-newest", "drop-lowest" or
+ * "overwrite-oldest"
+ * Returns 0 on success, -1 if the name is not recognized
+ */
+int queue_overflow_from_name(const char *name, QueueOverflowPolicy *overflow) {
+    static const QueueOverflowPolicy all[] = {
+        QUEUE_OVERFLOW_BLOCK, QUEUE_OVERFLOW_DROP_NEWEST,
+        QUEUE_OVERFLOW_DROP_LOWEST, QUEUE_OVERFLOW_OVERWRITE_OLDEST
+    };
+    
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (strcmp(name, queue_overflow_name(all[i])) == 0) {
+            *overflow = all[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
 /*
  * Check if queue is full (must be called with mutex locked)
  */
 int queue_is_full(Queue *q) {
-    return q->size == q->capacity;
+    return mutex_count(q) == q->capacity;
 }
 
 /*
  * Check if queue is empty (must be called with mutex locked)
  */
 int queue_is_empty(Queue *q) {
-    return q->size == 0;
+    return mutex_count(q) == 0;
 }
 
 /*
  * Get the current size of the queue (thread-safe)
  */
 int queue_get_size(Queue *q) {
-    pthread_mutex_lock(&q->mutex);
-    int size = q->size;
-    pthread_mutex_unlock(&q->mutex);
-    return size;
+    return QUEUE_OPS(q)->size(q);
 }
 
 /*
- * Enqueue an item into the queue
- * Blocks if queue is full (using condition variable)
- * Returns 0 on success, -1 on error
+ * Get the size of the queue without taking the mutex (for log lines)
+ * The value may be stale by the time it is used
  */
-int queue_enqueue(Queue *q, QueueItem item) {
-    if (q == NULL) {
-        fprintf(stderr, "Error: Cannot enqueue to NULL queue\n");
-        return -1;
+int queue_get_size_approx(Queue *q) {
+    if (q->backend == QUEUE_BACKEND_LOCKFREE || q->backend == QUEUE_BACKEND_SPSC) {
+        return QUEUE_OPS(q)->size(q);
     }
-    
-    // Acquire mutex lock - entering critical section
-    pthread_mutex_lock(&q->mutex);
-    
-    // Wait while queue is full (condition variable)
-    // This implements the "Producer must not write to full queue" requirement
-while (queue_is_full(q) && !timeout_flag) {
-    pthread_cond_wait(&q->not_full, &q->mutex);
+    return mutex_count(q);
 }
 
-if (timeout_flag) {
-    pthread_mutex_unlock(&q->mutex);
-    return -1;
+/*
+ * MUTEX backends: number of items, read under the queue mutex
+ */
+static int mutex_size(Queue *q) {
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    int size = mutex_count(q);
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+    return size;
 }
 
+/*
+ * Get the current capacity of the queue (thread-safe, changes when growing)
+ */
+int queue_get_capacity(Queue *q) {
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    int capacity = q->capacity;
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+    return capacity;
+}
+
+/*
+ * MUTEX backends, ADAPTIVE spin: there is room (read without the lock)
+ */
+static int mutex_has_space(Queue *q, void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    return queue_closed(q) || mutex_count(q) <
+                              atomic_load_explicit(&q->live_capacity, memory_order_relaxed);
+}
+
+/*
+ * MUTEX backends, ADAPTIVE spin: at least *(int *)arg items are queued
+ */
+static int mutex_has_items(Queue *q, void *arg) {
+    return queue_closed(q) || mutex_count(q) >= *(const int *)arg;
+}
+
+/*
+ * Double the queue storage (grow-on-demand mode)
+ * Must be called with mutex locked
+ * Returns 0 on success, -1 if the limit is reached or allocation fails
+ */
+static int mutex_grow(Queue *q) {
+    if (q->capacity >= q->max_capacity) {
+        return -1;
+    }
     
-    // Add item to queue (circular buffer)
-    q->items[q->tail] = item;
-    q->tail = (q->tail + 1) % q->capacity;
-    q->size++;
+    int new_capacity = q->capacity > q->max_capacity / 2 ? q->max_capacity : q->capacity * 2;
+    size_t new_items_bytes;
+    QueueItem *new_items = (QueueItem *)queue_storage_alloc(sizeof(QueueItem) * (size_t)new_capacity,
+                                                            q->numa_node, &new_items_bytes);
+    if (new_items == NULL) {
+        return -1;
+    }
     
-    if (DEBUG_MODE) {
-        printf("[QUEUE] Enqueued: value=%d, priority=%d, from P%d | Queue size: %d/%d\n",
-               item.value, item.priority, item.producer_id, q->size, q->capacity);
+    if (mutex_is_bucket(q)) {
+        // Slots keep their index, so the lists stay valid; new slots become free
+        size_t new_next_bytes;
+        int *new_next = (int *)queue_storage_alloc(sizeof(int) * (size_t)new_capacity,
+                                                   q->numa_node, &new_next_bytes);
+        if (new_next == NULL) {
+            queue_storage_free(new_items, new_items_bytes);
+            return -1;
+        }
+        
+        memcpy(new_items, q->items, sizeof(QueueItem) * (size_t)q->capacity);
+        memcpy(new_next, q->next, sizeof(int) * (size_t)q->capacity);
+        for (int i = q->capacity; i < new_capacity - 1; i++) {
+            new_next[i] = i + 1;
+        }
+        new_next[new_capacity - 1] = q->free_head;
+        q->free_head = q->capacity;
+        
+        queue_storage_free(q->next, q->next_bytes);
+        q->next = new_next;
+        q->next_bytes = new_next_bytes;
+    } else {
+        // Unwrap the ring so the oldest item lands at index 0
+        int idx = q->head;
+        int size = mutex_count(q);
+        for (int i = 0; i < size; i++) {
+            new_items[i] = q->items[idx];
+            idx = (idx + 1) % q->capacity;
+        }
+        q->head = 0;
+        q->tail = size;
     }
     
-    // Signal that queue is not empty (wake up waiting consumers)
-    pthread_cond_signal(&q->not_empty);
+    queue_storage_free(q->items, q->items_bytes);
+    q->items = new_items;
+    q->items_bytes = new_items_bytes;
+    q->capacity = new_capacity;
+    atomic_store_explicit(&q->live_capacity, new_capacity, memory_order_relaxed);
+    q->grow_count++;
     
-    // Release mutex lock - leaving critical section
-    pthread_mutex_unlock(&q->mutex);
+    if (DEBUG_MODE) {
+        printf("[QUEUE] Grew queue to capacity %d\n", new_capacity);
+    }
     
     return 0;
 }
 
 /*
- * Find the index of the highest priority item in the queue
+ * Find the index of the highest priority item in the queue (SCAN backend)
  * Must be called with mutex locked
  * Returns index of highest priority item, or -1 if queue is empty
  */
-static int find_highest_priority_index(Queue *q) {
+int find_highest_priority_index(Queue *q) {
     if (queue_is_empty(q)) {
         return -1;
     }
     
+    INSTRUMENT_BEGIN(scan_start);
     int highest_idx = q->head;
     int highest_priority = q->items[q->head].priority;
     
     // Scan through the queue to find highest priority
     int idx = q->head;
-    for (int i = 0; i < q->size; i++) {
+    int size = mutex_count(q);
+    for (int i = 0; i < size; i++) {
         if (q->items[idx].priority > highest_priority) {
             highest_priority = q->items[idx].priority;
             highest_idx = idx;
         }
         idx = (idx + 1) % q->capacity;
     }
+    INSTRUMENT_END(INSTRUMENT_SCAN, scan_start, size);
     
     return highest_idx;
 }
@@ -176,6 +662,7 @@ static int find_highest_priority_index(Queue *q) {
  */
 static void remove_at_index(Queue *q, int remove_idx) {
     // Shift elements to fill the gap (maintain FIFO order for same priority)
+    INSTRUMENT_BEGIN(shift_start);
     int current = remove_idx;
     int shifts = 0;
     
@@ -193,72 +680,703 @@ static void remove_at_index(Queue *q, int remove_idx) {
         q->items[current] = q->items[next];
         current = next;
     }
+    INSTRUMENT_END(INSTRUMENT_SHIFT, shift_start, shifts);
     
     // Update tail and size
     q->tail = (q->tail - 1 + q->capacity) % q->capacity;
-    q->size--;
+    mutex_set_count(q, mutex_count(q) - 1);
 }
 
 /*
- * Dequeue an item from the queue
- * Prioritizes high-priority items over FIFO order
- * Blocks if queue is empty (using condition variable)
- * Returns 0 on success, -1 on error
+ * SCAN backend: append at the tail of the ring
+ * Must be called with mutex locked and the queue not full
  */
-int queue_dequeue(Queue *q, QueueItem *item) {
-    if (q == NULL || item == NULL) {
-        fprintf(stderr, "Error: Cannot dequeue from NULL queue or to NULL item\n");
-        return -1;
+static void scan_push(Queue *q, const QueueItem *item) {
+    q->items[q->tail] = *item;
+    q->tail = (q->tail + 1) % q->capacity;
+    mutex_set_count(q, mutex_count(q) + 1);
+}
+
+/*
+ * SCAN backend: remove the item at remove_idx
+ * Must be called with mutex locked and the queue not empty
+ */
+static void scan_take(Queue *q, int remove_idx, QueueItem *item) {
+    // Copy item out
+    *item = q->items[remove_idx];
+    
+    // If it's the head, simple FIFO removal
+    if (remove_idx == q->head) {
+        q->head = (q->head + 1) % q->capacity;
+        mutex_set_count(q, mutex_count(q) - 1);
+    } else {
+        // Priority override - remove from middle and compact
+        remove_at_index(q, remove_idx);
+    }
+}
+
+/*
+ * SCAN backend: remove the highest priority item (oldest among equals)
+ * Must be called with mutex locked and the queue not empty
+ */
+static void scan_pop(Queue *q, QueueItem *item) {
+    scan_take(q, find_highest_priority_index(q), item);
+}
+
+/*
+ * Map a priority value onto a bucket level
+ */
+static int bucket_level(int priority) {
+    if (priority < 0) {
+        return 0;
+    }
+    if (priority >= QUEUE_PRIORITY_LEVELS) {
+        return QUEUE_PRIORITY_LEVELS - 1;
+    }
+    return priority;
+}
+
+/*
+ * BUCKET backend: take a free slot and link it at the tail of its level
+ * Must be called with mutex locked and the queue not full
+ */
+static void bucket_push(Queue *q, const QueueItem *item) {
+    int slot = q->free_head;
+    q->free_head = q->next[slot];
+    
+    q->items[slot] = *item;
+    q->next[slot] = -1;
+    
+    int level = bucket_level(item->priority);
+    if (q->level_tail[level] == -1) {
+        q->level_head[level] = slot;
+        q->level_bitmap |= 1u << level;
+    } else {
+        q->next[q->level_tail[level]] = slot;
     }
+    q->level_tail[level] = slot;
+    mutex_set_count(q, mutex_count(q) + 1);
+}
+
+/*
+ * BUCKET backend: level the next pop takes under the queue's policy
+ * (leaves the DRR round unchanged, so peeking is free of side effects)
+ * STRICT takes the highest non-empty level. AGING compares the oldest
+ * item of every non-empty level by level * aging_ns + time waited, so an
+ * item waiting more than (level difference) * aging_ns overtakes newer
+ * items of higher levels. DRR keeps serving the current level while it
+ * has credit and items, then moves to the next lower non-empty level,
+ * wrapping around to the highest. All are O(levels), independent of the
+ * number of queued items.
+ * Must be called with mutex locked and the queue not empty
+ */
+static int bucket_next_level(Queue *q, uint64_t now) {
+    // Highest set bit of the bitmap is the highest non-empty level
+    int level = 31 - __builtin_clz(q->level_bitmap);
     
-    // Acquire mutex lock - entering critical section
-    pthread_mutex_lock(&q->mutex);
+    if (q->policy == QUEUE_POLICY_AGING) {
+        uint64_t best = 0;
+        for (unsigned int levels = q->level_bitmap; levels != 0; ) {
+            int l = 31 - __builtin_clz(levels);
+            levels &= ~(1u << l);
+            
+            uint64_t stamp = q->items[q->level_head[l]].timestamp;
+            uint64_t score = (uint64_t)l * q->aging_ns + (now > stamp ? now - stamp : 0);
+            if (score > best) {
+                best = score;
+                level = l;
+            }
+        }
+    } else if (q->policy == QUEUE_POLICY_DRR) {
+        if (q->drr_credit > 0 && (q->level_bitmap & (1u << q->drr_level))) {
+            return q->drr_level;
+        }
+        unsigned int lower = q->level_bitmap & ((1u << q->drr_level) - 1);
+        if (lower != 0) {
+            level = 31 - __builtin_clz(lower);
+        }
+    }
     
-    // Wait while queue is empty (condition variable)
-    // This implements the "Consumer must not read from empty queue" requirement
-while (queue_is_empty(q) && !timeout_flag) {
-    pthread_cond_wait(&q->not_empty, &q->mutex);
+    return level;
 }
 
-if (timeout_flag) {
-    pthread_mutex_unlock(&q->mutex);
-    return -1;
+/*
+ * BUCKET backend: unlink the oldest item of a level
+ * Must be called with mutex locked and the level not empty
+ */
+static void bucket_take(Queue *q, int level, QueueItem *item) {
+    int slot = q->level_head[level];
+    
+    *item = q->items[slot];
+    
+    q->level_head[level] = q->next[slot];
+    if (q->level_head[level] == -1) {
+        q->level_tail[level] = -1;
+        q->level_bitmap &= ~(1u << level);
+    }
+    
+    // Return the slot to the free list
+    q->next[slot] = q->free_head;
+    q->free_head = slot;
+    mutex_set_count(q, mutex_count(q) - 1);
+}
+
+/*
+ * BUCKET backend: unlink the oldest item of the level the policy selects
+ * Must be called with mutex locked and the queue not empty
+ */
+static void bucket_pop(Queue *q, QueueItem *item, uint64_t now) {
+    int level = bucket_next_level(q, now);
+    if (q->policy == QUEUE_POLICY_DRR) {
+        // A new turn: the level gets its quantum of p + 1 items
+        if (level != q->drr_level || q->drr_credit == 0) {
+            q->drr_level = level;
+            q->drr_credit = level + 1;
+        }
+        q->drr_credit--;
+    }
+    bucket_take(q, level, item);
 }
 
+/*
+ * MUTEX backends, full queue under a shedding overflow policy: make room
+ * for incoming by evicting a queued item, or decide to drop incoming.
+ * DROP_LOWEST evicts the oldest item of the lowest queued priority when it
+ * ranks below incoming. OVERWRITE_OLDEST evicts the head of the ring
+ * (SCAN), or the level head with the earliest timestamp (BUCKET, whose
+ * lists are each in arrival order). Either way one item is shed.
+ * Must be called with mutex locked and the queue full
+ * Returns 1 if a queued item was evicted, 0 if incoming is to be dropped
+ */
+static int mutex_evict(Queue *q, const QueueItem *incoming) {
+    atomic_fetch_add_explicit(&q->shed, 1, memory_order_relaxed);
+    if (q->overflow == QUEUE_OVERFLOW_DROP_NEWEST) {
+        return 0;
+    }
     
-    // Find highest priority item
-    int remove_idx = find_highest_priority_index(q);
+    QueueItem evicted;
+    if (mutex_is_bucket(q)) {
+        // Lowest set bit of the bitmap is the lowest non-empty level
+        int level = __builtin_ctz(q->level_bitmap);
+        if (q->overflow == QUEUE_OVERFLOW_DROP_LOWEST) {
+            if (level >= bucket_level(incoming->priority)) {
+                return 0;
+            }
+        } else {
+            for (unsigned int levels = q->level_bitmap; levels != 0; levels &= levels - 1) {
+                int l = __builtin_ctz(levels);
+                if (q->items[q->level_head[l]].timestamp <
+                    q->items[q->level_head[level]].timestamp) {
+                    level = l;
+                }
+            }
+        }
+        bucket_take(q, level, &evicted);
+    } else {
+        int remove_idx = q->head;
+        if (q->overflow == QUEUE_OVERFLOW_DROP_LOWEST) {
+            int idx = q->head;
+            int size = mutex_count(q);
+            for (int i = 0; i < size; i++) {
+                if (q->items[idx].priority < q->items[remove_idx].priority) {
+                    remove_idx = idx;
+                }
+                idx = (idx + 1) % q->capacity;
+            }
+            if (q->items[remove_idx].priority >= incoming->priority) {
+                return 0;
+            }
+        }
+        scan_take(q, remove_idx, &evicted);
+    }
     
-    if (remove_idx == -1) {
-        // Should never happen due to the wait above
-        pthread_mutex_unlock(&q->mutex);
+    return 1;
+}
+
+/*
+ * MUTEX backends: allocate the item array (and slot links for BUCKET)
+ */
+static int mutex_init(Queue *q) {
+    q->items = (QueueItem *)queue_storage_alloc(sizeof(QueueItem) * (size_t)q->capacity,
+                                                q->numa_node, &q->items_bytes);
+    if (q->items == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for queue items\n");
         return -1;
     }
     
-    // Copy item out
-    *item = q->items[remove_idx];
+    if (mutex_is_bucket(q)) {
+        q->next = (int *)queue_storage_alloc(sizeof(int) * (size_t)q->capacity,
+                                             q->numa_node, &q->next_bytes);
+        if (q->next == NULL) {
+            fprintf(stderr, "Error: Failed to allocate memory for queue links\n");
+            queue_storage_free(q->items, q->items_bytes);
+            q->items = NULL;
+            return -1;
+        }
+        bucket_reset(q);
+    }
     
-    // If it's the head, simple FIFO removal
-    if (remove_idx == q->head) {
-        q->head = (q->head + 1) % q->capacity;
-        q->size--;
+    return 0;
+}
+
+/*
+ * MUTEX backends: release the item array and slot links
+ */
+static void mutex_destroy(Queue *q) {
+    queue_storage_free(q->next, q->next_bytes);
+    queue_storage_free(q->items, q->items_bytes);
+    q->next = NULL;
+    q->items = NULL;
+}
+
+/*
+ * MUTEX backends: enqueue up to n items in one critical section
+ * Blocks while queue is full (using condition variable) until deadline_ns;
+ * items that fit are published before waiting so consumers can make room.
+ * A shedding overflow policy never waits: each item that finds the queue
+ * full evicts a queued item or is dropped itself
+ * Returns number of items taken (enqueued or shed), -1 if none could be
+ * (queue closed or deadline passed)
+ */
+static int mutex_enqueue(Queue *q, const QueueItem *items, int n, uint64_t deadline_ns,
+                         QueueWaitInfo *wait) {
+    int done = 0;
+    int shed = 0;
+    
+    // Acquire mutex lock - entering critical section
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    
+    while (done < n) {
+        // In grow-on-demand mode, double until the rest of the batch fits
+        while (q->grow && q->capacity - mutex_count(q) < n - done) {
+            if (mutex_grow(q) != 0) {
+                break;
+            }
+        }
+        
+        if (queue_closed(q)) {
+            break;
+        }
+        
+        // Shedding policies: make room or drop instead of waiting
+        if (queue_is_full(q) && q->overflow != QUEUE_OVERFLOW_BLOCK) {
+            for (; done < n; done++) {
+                if (!queue_is_full(q) || mutex_evict(q, &items[done])) {
+                    if (mutex_is_bucket(q)) {
+                        bucket_push(q, &items[done]);
+                    } else {
+                        scan_push(q, &items[done]);
+                    }
+                } else {
+                    shed++;
+                }
+            }
+            break;
+        }
+        
+        // Adaptive strategy: spin and yield outside the lock before parking
+        if (queue_is_full(q) && q->wait_strategy == QUEUE_WAIT_ADAPTIVE &&
+            !queue_deadline_passed(deadline_ns)) {
+            INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+            queue_spin_wait(q, &q->producer_spin, mutex_has_space, NULL, wait);
+            INSTRUMENT_MUTEX_LOCK(&q->mutex);
+        }
+        
+        // Wait while queue is full (condition variable)
+        // This implements the "Producer must not write to full queue" requirement
+        if (queue_is_full(q) && !queue_closed(q) && !queue_deadline_passed(deadline_ns)) {
+            uint64_t wait_start = timing_now_ns();
+            while (queue_is_full(q) && !queue_closed(q) && !queue_deadline_passed(deadline_ns)) {
+                queue_park(q, &q->not_full, deadline_ns);
+            }
+            queue_park_end(q, &q->producer_spin, wait, wait_start);
+        }
+        
+        // Closed, or the deadline passed while still full
+        if (queue_closed(q) || queue_is_full(q)) {
+            break;
+        }
+        
+        // Add as many items as fit to the backend storage
+        int count = q->capacity - mutex_count(q);
+        if (count > n - done) {
+            count = n - done;
+        }
+        
+        if (mutex_is_bucket(q)) {
+            for (int i = 0; i < count; i++) {
+                bucket_push(q, &items[done + i]);
+            }
+        } else {
+            for (int i = 0; i < count; i++) {
+                scan_push(q, &items[done + i]);
+            }
+        }
+        done += count;
+        
+        // Still more to write: let consumers drain what we have so far
+        if (done < n) {
+            INSTRUMENT_COND_BROADCAST(&q->not_empty);
+        }
+    }
+    
+    if (done > shed) {
+        if (DEBUG_MODE) {
+            printf("[QUEUE] Enqueued %d item(s): first value=%d, priority=%d, from P%d | Queue size: %d/%d\n",
+                   done - shed, items[0].value, items[0].priority, items[0].producer_id,
+                   mutex_count(q), q->capacity);
+        }
+        
+        // Signal that queue is not empty (wake up waiting consumers)
+        // A batch, or a consumer waiting for more than one item, needs everyone woken
+        if (done - shed > 1 || q->batch_waiters > 0) {
+            INSTRUMENT_COND_BROADCAST(&q->not_empty);
+        } else {
+            INSTRUMENT_COND_SIGNAL(&q->not_empty);
+        }
+    }
+    
+    // Release mutex lock - leaving critical section
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+    
+    return done > 0 ? done : -1;
+}
+
+/*
+ * MUTEX backends: remove up to max items in priority order
+ * Must be called with mutex locked
+ * Returns number of items removed
+ */
+static int mutex_pop(Queue *q, QueueItem *items, int max) {
+    int size = mutex_count(q);
+    int count = size < max ? size : max;
+    
+    if (mutex_is_bucket(q)) {
+        // AGING: one clock read serves the whole batch
+        uint64_t now = q->policy == QUEUE_POLICY_AGING ? timing_now_ns() : 0;
+        for (int i = 0; i < count; i++) {
+            bucket_pop(q, &items[i], now);
+        }
     } else {
-        // Priority override - remove from middle and compact
-        remove_at_index(q, remove_idx);
+        for (int i = 0; i < count; i++) {
+            scan_pop(q, &items[i]);
+        }
+    }
+    
+    return count;
+}
+
+/*
+ * MUTEX backends: dequeue between min and max items in priority order
+ * Prioritizes high-priority items over FIFO order
+ * Blocks until at least min items are queued (using condition variable);
+ * if deadline_ns passes first, returns whatever is queued by then
+ * Returns number of items dequeued, -1 if none (queue closed or deadline passed)
+ */
+static int mutex_dequeue(Queue *q, QueueItem *items, int max, int min, uint64_t deadline_ns,
+                         QueueWaitInfo *wait) {
+    // Acquire mutex lock - entering critical section
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    
+    // Adaptive strategy: spin and yield outside the lock before parking
+    if (mutex_count(q) < (min < q->capacity ? min : q->capacity) && !queue_closed(q) &&
+        q->wait_strategy == QUEUE_WAIT_ADAPTIVE && !queue_deadline_passed(deadline_ns)) {
+        int needed = min < q->capacity ? min : q->capacity;
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+        queue_spin_wait(q, &q->consumer_spin, mutex_has_items, &needed, wait);
+        INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    }
+    
+    // Wait while queue holds fewer than min items (condition variable)
+    // This implements the "Consumer must not read from empty queue" requirement
+    if (mutex_count(q) < (min < q->capacity ? min : q->capacity) && !queue_closed(q) &&
+        !queue_deadline_passed(deadline_ns)) {
+        uint64_t wait_start = timing_now_ns();
+        while (mutex_count(q) < (min < q->capacity ? min : q->capacity) && !queue_closed(q) &&
+               !queue_deadline_passed(deadline_ns)) {
+            if (min > 1) {
+                q->batch_waiters++;
+            }
+            queue_park(q, &q->not_empty, deadline_ns);
+            if (min > 1) {
+                q->batch_waiters--;
+            }
+        }
+        queue_park_end(q, &q->consumer_spin, wait, wait_start);
     }
     
+    // A closed queue still hands out what it holds; only empty fails
+    if (mutex_count(q) == 0) {
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+        return -1;
+    }
+    
+    // Remove highest priority items from the backend storage
+    int count = mutex_pop(q, items, max);
+    
     if (DEBUG_MODE) {
-        printf("[QUEUE] Dequeued: value=%d, priority=%d, from P%d | Queue size: %d/%d\n",
-               item->value, item->priority, item->producer_id, q->size, q->capacity);
+        printf("[QUEUE] Dequeued %d item(s): first value=%d, priority=%d, from P%d | Queue size: %d/%d\n",
+               count, items[0].value, items[0].priority, items[0].producer_id,
+               mutex_count(q), q->capacity);
     }
     
     // Signal that queue is not full (wake up waiting producers)
-    pthread_cond_signal(&q->not_full);
+    if (count > 1) {
+        INSTRUMENT_COND_BROADCAST(&q->not_full);
+    } else {
+        INSTRUMENT_COND_SIGNAL(&q->not_full);
+    }
     
     // Release mutex lock - leaving critical section
-    pthread_mutex_unlock(&q->mutex);
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
     
-    return 0;
+    return count;
+}
+
+/*
+ * MUTEX backends: dequeue up to max items without waiting
+ * Returns number of items dequeued (0 if the queue is empty)
+ */
+static int mutex_try_dequeue(Queue *q, QueueItem *items, int max) {
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    
+    int count = mutex_pop(q, items, max);
+    if (count > 1) {
+        INSTRUMENT_COND_BROADCAST(&q->not_full);
+    } else if (count == 1) {
+        INSTRUMENT_COND_SIGNAL(&q->not_full);
+    }
+    
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+    return count;
+}
+
+/*
+ * MUTEX backends: priority of the item the next dequeue would return
+ * Returns -1 if the queue is empty
+ */
+static int mutex_peek_priority(Queue *q) {
+    int priority = -1;
+    
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    if (mutex_count(q) > 0) {
+        if (mutex_is_bucket(q)) {
+            uint64_t now = q->policy == QUEUE_POLICY_AGING ? timing_now_ns() : 0;
+            priority = q->items[q->level_head[bucket_next_level(q, now)]].priority;
+        } else {
+            priority = q->items[find_highest_priority_index(q)].priority;
+        }
+    }
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+    
+    return priority;
+}
+
+// Operations table shared by the SCAN and BUCKET backends
+const QueueOps queue_ops_mutex = {
+    .init          = mutex_init,
+    .destroy       = mutex_destroy,
+    .enqueue       = mutex_enqueue,
+    .dequeue       = mutex_dequeue,
+    .try_dequeue   = mutex_try_dequeue,
+    .peek_priority = mutex_peek_priority,
+    .size          = mutex_size,
+    .grow          = mutex_grow,
+};
+
+/*
+ * Enqueue an item into the queue
+ * Blocks if queue is full, until deadline_ns (timing_now_ns clock)
+ * Returns 0 on success (the item may have been shed by the overflow
+ * policy), -1 on error, timeout or a closed queue
+ */
+int queue_enqueue_timed(Queue *q, QueueItem item, uint64_t deadline_ns) {
+    if (q == NULL) {
+        fprintf(stderr, "Error: Cannot enqueue to NULL queue\n");
+        return -1;
+    }
+    
+    QueueWaitInfo wait = { 0 };
+    return QUEUE_OPS(q)->enqueue(q, &item, 1, deadline_ns, &wait) == 1 ? 0 : -1;
+}
+
+/*
+ * Dequeue an item from the queue
+ * Priority backends return the highest priority item, FIFO among equals
+ * Blocks if queue is empty, until deadline_ns (timing_now_ns clock)
+ * Returns 0 on success, -1 on error, timeout or a closed and empty queue
+ */
+int queue_dequeue_timed(Queue *q, QueueItem *item, uint64_t deadline_ns) {
+    if (q == NULL || item == NULL) {
+        fprintf(stderr, "Error: Cannot dequeue from NULL queue or to NULL item\n");
+        return -1;
+    }
+    
+    QueueWaitInfo wait = { 0 };
+    return QUEUE_OPS(q)->dequeue(q, item, 1, 1, deadline_ns, &wait) == 1 ? 0 : -1;
+}
+
+/*
+ * Enqueue an item, blocking while the queue is full until it is closed
+ * Returns 0 on success, -1 on error or a closed queue
+ */
+int queue_enqueue(Queue *q, QueueItem item) {
+    return queue_enqueue_timed(q, item, QUEUE_NO_DEADLINE);
+}
+
+/*
+ * Dequeue an item, blocking while the queue is empty until it is closed
+ * Returns 0 on success, -1 on error or a closed and empty queue
+ */
+int queue_dequeue(Queue *q, QueueItem *item) {
+    return queue_dequeue_timed(q, item, QUEUE_NO_DEADLINE);
+}
+
+/*
+ * Enqueue an item only if there is room (or the overflow policy makes it)
+ * Returns 0 on success, -1 if the queue is full, closed, or on error
+ */
+int queue_try_enqueue(Queue *q, QueueItem item) {
+    return queue_enqueue_timed(q, item, 0);
+}
+
+/*
+ * Dequeue an item only if one is queued
+ * Returns 0 on success, -1 if the queue is empty, closed, or on error
+ */
+int queue_try_dequeue(Queue *q, QueueItem *item) {
+    return queue_dequeue_timed(q, item, 0);
+}
+
+/*
+ * Enqueue n items with a single lock acquisition and wakeup per pass
+ * Blocks while queue is full, until deadline_ns (timing_now_ns clock); if
+ * wait is not NULL it receives whether the call blocked and for how long
+ * Returns number of items taken - enqueued or shed by the overflow policy
+ * (less than n only if the queue was closed or the deadline passed), or
+ * -1 if none were, or on error
+ */
+int queue_enqueue_batch_timed(Queue *q, const QueueItem *items, int n, uint64_t deadline_ns,
+                              QueueWaitInfo *wait) {
+    QueueWaitInfo local_wait;
+    if (wait == NULL) {
+        wait = &local_wait;
+    }
+    memset(wait, 0, sizeof(*wait));
+    
+    if (q == NULL || items == NULL || n <= 0) {
+        fprintf(stderr, "Error: Invalid batch enqueue arguments\n");
+        return -1;
+    }
+    
+    return QUEUE_OPS(q)->enqueue(q, items, n, deadline_ns, wait);
+}
+
+/*
+ * Dequeue up to max items, waiting until at least min are available or
+ * deadline_ns (timing_now_ns clock) passes
+ * Items come out in the same priority-first order as queue_dequeue
+ * If wait is not NULL it receives whether the call blocked and for how long
+ * Returns number of items dequeued (fewer than min only at the deadline or
+ * once the queue is closed), or -1 if none were (closed and empty queue,
+ * deadline) or on error
+ */
+int queue_dequeue_batch_timed(Queue *q, QueueItem *items, int max, int min,
+                              uint64_t deadline_ns, QueueWaitInfo *wait) {
+    QueueWaitInfo local_wait;
+    if (wait == NULL) {
+        wait = &local_wait;
+    }
+    memset(wait, 0, sizeof(*wait));
+    
+    if (q == NULL || items == NULL || max <= 0) {
+        fprintf(stderr, "Error: Invalid batch dequeue arguments\n");
+        return -1;
+    }
+    
+    if (min < 1) {
+        min = 1;
+    }
+    if (min > max) {
+        min = max;
+    }
+    
+    return QUEUE_OPS(q)->dequeue(q, items, max, min, deadline_ns, wait);
+}
+
+/*
+ * Enqueue n items, blocking while the queue is full until it is closed
+ * See queue_enqueue_batch_timed()
+ */
+int queue_enqueue_batch(Queue *q, const QueueItem *items, int n, QueueWaitInfo *wait) {
+    return queue_enqueue_batch_timed(q, items, n, QUEUE_NO_DEADLINE, wait);
+}
+
+/*
+ * Dequeue up to max items, blocking until min are queued or the queue is
+ * closed; see queue_dequeue_batch_timed()
+ */
+int queue_dequeue_batch(Queue *q, QueueItem *items, int max, int min, QueueWaitInfo *wait) {
+    return queue_dequeue_batch_timed(q, items, max, min, QUEUE_NO_DEADLINE, wait);
+}
+
+/*
+ * Dequeue up to max items without blocking, in queue_dequeue order
+ * Returns number of items dequeued (0 if the queue is empty), or -1 on error
+ */
+int queue_try_dequeue_batch(Queue *q, QueueItem *items, int max) {
+    if (q == NULL || items == NULL || max <= 0) {
+        fprintf(stderr, "Error: Invalid batch dequeue arguments\n");
+        return -1;
+    }
+    
+    return QUEUE_OPS(q)->try_dequeue(q, items, max);
+}
+
+/*
+ * Priority of the item the next dequeue would return (FIFO backends
+ * report PRIORITY_LOW for any item), or -1 if the queue is empty
+ * The answer may be stale as soon as it is returned
+ */
+int queue_peek_priority(Queue *q) {
+    if (q == NULL) {
+        return -1;
+    }
+    
+    return QUEUE_OPS(q)->peek_priority(q);
+}
+
+/*
+ * Number of items the overflow policy has discarded or evicted so far
+ */
+long queue_get_shed(Queue *q) {
+    return atomic_load_explicit(&q->shed, memory_order_relaxed);
+}
+
+/*
+ * Close the queue: enqueues in progress and later ones return -1 at once;
+ * dequeues stop waiting, hand out the items still queued and return -1
+ * once the queue is empty
+ */
+void queue_close(Queue *q) {
+    if (q == NULL) {
+        return;
+    }
+    
+    atomic_store_explicit(&q->closed, 1, memory_order_release);
+    
+    // Waiters check the flag under the mutex, so none can miss the wakeup
+    INSTRUMENT_MUTEX_LOCK(&q->mutex);
+    INSTRUMENT_COND_BROADCAST(&q->not_full);
+    INSTRUMENT_COND_BROADCAST(&q->not_empty);
+    INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+}
+
+/*
+ * The queue has been closed
+ */
+int queue_is_closed(Queue *q) {
+    return queue_closed(q);
 }
 
 /*
@@ -274,13 +1392,14 @@ void queue_destroy(Queue *q) {
         printf("[QUEUE] Destroying queue and releasing resources...\n");
     }
     
+    // Release backend storage
+    QUEUE_OPS(q)->destroy(q);
+    
     // Destroy synchronization primitives
     pthread_cond_destroy(&q->not_empty);
     pthread_cond_destroy(&q->not_full);
     pthread_mutex_destroy(&q->mutex);
     
-    // Free memory
-    free(q->items);
     free(q);
     
     if (DEBUG_MODE) {
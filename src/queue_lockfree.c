@@ -0,0 +1,372 @@
+/*
+ * Lock-Free Queue Backend
+ *
+ * Bounded multi-producer/multi-consumer ring after Dmitry Vyukov's design:
+ * every cell carries a sequence number telling producers and consumers
+ * whether the cell is free for the position they claimed. Producers and
+ * consumers only contend on a CAS of their own position counter.
+ *
+ * The backend is FIFO only (item priority is ignored). Threads park on the
+ * queue mutex and condition variables only when the ring is really full or
+ * empty, so queue_close() and the deadlines work as for the other backends.
+ * Under the overwrite-oldest overflow policy a producer that finds the ring
+ * full pops the oldest item itself, which any thread may do on this ring.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "queue_backend.h"
+#include "config.h"
+
+#if QUEUE_WITH_LOCKFREE
+
+// One ring cell: the sequence number publishes the state of the item
+// Sequences are kept doubled (2*pos free, 2*pos + 1 full) so the states of
+// consecutive laps never collide, even for a capacity of 1
+struct LockFreeCell {
+    atomic_size_t sequence;     // == 2*pos: free for enqueue, == 2*pos + 1: holds item
+    QueueItem item;
+};
+
+/*
+ * Map a ring position onto a cell index
+ */
+static inline struct LockFreeCell* lf_cell(Queue *q, size_t pos) {
+    return &q->cells[pos % (size_t)q->capacity];
+}
+
+/*
+ * Allocate the ring and give each cell its starting sequence number
+ */
+static int lf_init(Queue *q) {
+    q->cells = (struct LockFreeCell *)queue_storage_alloc(
+        sizeof(struct LockFreeCell) * (size_t)q->capacity, q->numa_node, &q->cells_bytes);
+    if (q->cells == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for lock-free ring\n");
+        return -1;
+    }
+    
+    for (int i = 0; i < q->capacity; i++) {
+        atomic_init(&q->cells[i].sequence, (size_t)i * 2);
+    }
+    
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    atomic_init(&q->waiting_producers, 0);
+    atomic_init(&q->waiting_consumers, 0);
+    
+    return 0;
+}
+
+/*
+ * Release the ring
+ */
+static void lf_destroy(Queue *q) {
+    queue_storage_free(q->cells, q->cells_bytes);
+    q->cells = NULL;
+}
+
+/*
+ * Try to append an item without blocking
+ * Returns 0 on success, -1 if the ring is full
+ */
+static int lf_try_push(Queue *q, const QueueItem *item) {
+    struct LockFreeCell *cell;
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    
+    for (;;) {
+        cell = lf_cell(q, pos);
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos * 2);
+    
+        if (diff == 0) {
+            // Cell is free for this position - try to claim it
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Cell still holds the item from one lap ago - ring is full
+            return -1;
+        } else {
+            // Another producer claimed this position first
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    
+    cell->item = *item;
+    atomic_store_explicit(&cell->sequence, pos * 2 + 1, memory_order_release);
+    
+    return 0;
+}
+
+/*
+ * Try to remove the oldest item without blocking
+ * Returns 0 on success, -1 if the ring is empty
+ */
+static int lf_try_pop(Queue *q, QueueItem *item) {
+    struct LockFreeCell *cell;
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    
+    for (;;) {
+        cell = lf_cell(q, pos);
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos * 2 + 1);
+    
+        if (diff == 0) {
+            // Cell holds the item for this position - try to claim it
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Producer has not published this position yet - ring is empty
+            return -1;
+        } else {
+            // Another consumer claimed this position first
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    
+    *item = cell->item;
+    // Hand the cell to the producer one lap ahead
+    atomic_store_explicit(&cell->sequence, (pos + (size_t)q->capacity) * 2,
+                          memory_order_release);
+    
+    return 0;
+}
+
+/*
+ * ADAPTIVE spin: the ring has a free cell (or shutdown started)
+ */
+static int lf_has_space(Queue *q, void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    size_t tail = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    return queue_closed(q) || tail - head < (size_t)q->capacity;
+}
+
+/*
+ * ADAPTIVE spin: the ring holds an item (or shutdown started)
+ */
+static int lf_has_items(Queue *q, void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    size_t tail = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    return queue_closed(q) || tail > head;
+}
+
+/*
+ * Enqueue n items, parking on not_full only while the ring is full (until
+ * deadline_ns; shedding overflow policies never park)
+ * Consumers are woken once for the whole batch
+ * Returns number of items taken (enqueued or shed), -1 if none could be
+ * (queue closed or deadline passed)
+ */
+static int lf_enqueue(Queue *q, const QueueItem *items, int n, uint64_t deadline_ns,
+                      QueueWaitInfo *wait) {
+    int done = 0;
+    int shed = 0;
+    
+    while (done < n) {
+        if (queue_closed(q)) {
+            break;
+        }
+        
+        if (lf_try_push(q, &items[done]) == 0) {
+            done++;
+            continue;
+        }
+        
+        // Ring is full under a shedding policy: drop the new item, or take
+        // the oldest one out and retry
+        if (q->overflow == QUEUE_OVERFLOW_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&q->shed, 1, memory_order_relaxed);
+            shed++;
+            done++;
+            continue;
+        }
+        if (q->overflow == QUEUE_OVERFLOW_OVERWRITE_OLDEST) {
+            QueueItem evicted;
+            if (lf_try_pop(q, &evicted) == 0) {
+                atomic_fetch_add_explicit(&q->shed, 1, memory_order_relaxed);
+            }
+            continue;
+        }
+        
+        // Ring is full: let consumers see what we pushed so far
+        if (done > 0) {
+            queue_wake_parked(q, &q->waiting_consumers, &q->not_empty, 1);
+        }
+        
+        if (queue_deadline_passed(deadline_ns)) {
+            break;
+        }
+        
+        // Adaptive strategy: spin and yield before paying for a park
+        if (queue_spin_wait(q, &q->producer_spin, lf_has_space, NULL, wait)) {
+            continue;
+        }
+        
+        // Register as a waiter, retry once, then park
+        INSTRUMENT_MUTEX_LOCK(&q->mutex);
+        atomic_fetch_add(&q->waiting_producers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        
+        int pushed = lf_try_push(q, &items[done]) == 0;
+        if (!pushed && !queue_closed(q)) {
+            uint64_t wait_start = timing_now_ns();
+            queue_park(q, &q->not_full, deadline_ns);
+            queue_park_end(q, &q->producer_spin, wait, wait_start);
+        }
+        
+        atomic_fetch_sub(&q->waiting_producers, 1);
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+        
+        if (pushed) {
+            done++;
+        }
+    }
+    
+    if (done == 0) {
+        return -1;
+    }
+    
+    if (DEBUG_MODE) {
+        printf("[QUEUE] Enqueued %d item(s): first value=%d, priority=%d, from P%d (lock-free)\n",
+               done - shed, items[0].value, items[0].priority, items[0].producer_id);
+    }
+    
+    if (done > shed) {
+        queue_wake_parked(q, &q->waiting_consumers, &q->not_empty, done - shed > 1);
+    }
+    return done;
+}
+
+/*
+ * Dequeue up to max of the oldest items, parking on not_empty only while
+ * the ring is empty and fewer than min items have been taken (until
+ * deadline_ns)
+ * Returns number of items dequeued, -1 if none could be (queue closed and
+ * empty, or deadline passed)
+ */
+static int lf_dequeue(Queue *q, QueueItem *items, int max, int min, uint64_t deadline_ns,
+                      QueueWaitInfo *wait) {
+    int done = 0;
+    
+    for (;;) {
+        // Take whatever is available, up to max (a closed ring is still drained)
+        while (done < max && lf_try_pop(q, &items[done]) == 0) {
+            done++;
+        }
+        
+        if (done >= min || queue_closed(q)) {
+            break;
+        }
+        
+        // Ring is empty: let producers refill the cells we freed so far
+        if (done > 0) {
+            queue_wake_parked(q, &q->waiting_producers, &q->not_full, 1);
+        }
+        
+        if (queue_deadline_passed(deadline_ns)) {
+            break;
+        }
+        
+        // Adaptive strategy: spin and yield before paying for a park
+        if (queue_spin_wait(q, &q->consumer_spin, lf_has_items, NULL, wait)) {
+            continue;
+        }
+        
+        // Register as a waiter, retry once, then park
+        INSTRUMENT_MUTEX_LOCK(&q->mutex);
+        atomic_fetch_add(&q->waiting_consumers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        
+        int popped = lf_try_pop(q, &items[done]) == 0;
+        if (!popped && !queue_closed(q)) {
+            uint64_t wait_start = timing_now_ns();
+            queue_park(q, &q->not_empty, deadline_ns);
+            queue_park_end(q, &q->consumer_spin, wait, wait_start);
+        }
+        
+        atomic_fetch_sub(&q->waiting_consumers, 1);
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+        
+        if (popped) {
+            done++;
+        }
+    }
+    
+    // Items already taken are returned even when a close or deadline interrupts
+    if (done == 0) {
+        return -1;
+    }
+    
+    if (DEBUG_MODE) {
+        printf("[QUEUE] Dequeued %d item(s): first value=%d, priority=%d, from P%d (lock-free)\n",
+               done, items[0].value, items[0].priority, items[0].producer_id);
+    }
+    
+    queue_wake_parked(q, &q->waiting_producers, &q->not_full, done > 1);
+    return done;
+}
+
+/*
+ * Approximate number of items (exact when no operation is in progress)
+ */
+static int lf_size(Queue *q) {
+    size_t tail = atomic_load_explicit(&q->enqueue_pos, memory_order_acquire);
+    size_t head = atomic_load_explicit(&q->dequeue_pos, memory_order_acquire);
+    
+    if (tail <= head) {
+        return 0;
+    }
+    
+    size_t size = tail - head;
+    return size > (size_t)q->capacity ? q->capacity : (int)size;
+}
+
+/*
+ * Dequeue up to max of the oldest items without parking
+ * Returns number of items dequeued (0 if the ring is empty)
+ */
+static int lf_try_dequeue(Queue *q, QueueItem *items, int max) {
+    int done = 0;
+    
+    while (done < max && lf_try_pop(q, &items[done]) == 0) {
+        done++;
+    }
+    
+    if (done > 0) {
+        queue_wake_parked(q, &q->waiting_producers, &q->not_full, done > 1);
+    }
+    return done;
+}
+
+/*
+ * Priority of the next item: the ring is FIFO, so any item reports
+ * PRIORITY_LOW; -1 if the ring is empty
+ */
+static int lf_peek_priority(Queue *q) {
+    return lf_size(q) > 0 ? PRIORITY_LOW : -1;
+}
+
+// Operations table for the LOCKFREE backend (fixed capacity, no growth)
+const QueueOps queue_ops_lockfree = {
+    .init          = lf_init,
+    .destroy       = lf_destroy,
+    .enqueue       = lf_enqueue,
+    .dequeue       = lf_dequeue,
+    .try_dequeue   = lf_try_dequeue,
+    .peek_priority = lf_peek_priority,
+    .size          = lf_size,
+    .grow          = NULL,
+};
+
+#endif
@@ -0,0 +1,334 @@
+/*
+ * SPSC Queue Backend
+ *
+ * Ring for exactly one producer thread and one consumer thread. The
+ * producer owns the tail index and the consumer owns the head index; each
+ * side publishes its index with a release store and reads the other one
+ * with an acquire load. Each side also keeps a private copy of the other
+ * side's index and only re-reads the shared one when the copy says the
+ * ring is full (or empty), so in steady state the two threads do not
+ * touch each other's cache lines. Both operations are wait-free; threads
+ * park on the queue mutex and condition variables only when the ring is
+ * really full or empty. Of the shedding overflow policies only
+ * drop-newest is supported: evicting would make the producer pop.
+ *
+ * The backend is FIFO only (item priority is ignored). Using it with more
+ * than one producer or consumer is undefined.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "queue_backend.h"
+#include "config.h"
+
+#if QUEUE_WITH_SPSC
+
+// Ring indices: producer side and consumer side on separate cache lines
+// Indices run freely; the slot is index % capacity
+struct SpscIndices {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;   // Next slot to write (producer)
+    size_t cached_head;                             // Producer's copy of head
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;   // Next slot to read (consumer)
+    size_t cached_tail;                             // Consumer's copy of tail
+};
+
+/*
+ * Allocate the ring and its indices
+ */
+static int spsc_init(Queue *q) {
+    q->items = (QueueItem *)queue_storage_alloc(sizeof(QueueItem) * (size_t)q->capacity,
+                                                q->numa_node, &q->items_bytes);
+    if (q->items == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for SPSC ring\n");
+        return -1;
+    }
+    
+    q->spsc = (struct SpscIndices *)aligned_alloc(CACHE_LINE_SIZE, sizeof(struct SpscIndices));
+    if (q->spsc == NULL) {
+        fprintf(stderr, "Error: Failed to allocate SPSC ring indices\n");
+        queue_storage_free(q->items, q->items_bytes);
+        q->items = NULL;
+        return -1;
+    }
+    
+    atomic_init(&q->spsc->tail, 0);
+    atomic_init(&q->spsc->head, 0);
+    q->spsc->cached_head = 0;
+    q->spsc->cached_tail = 0;
+    atomic_init(&q->waiting_producers, 0);
+    atomic_init(&q->waiting_consumers, 0);
+    
+    return 0;
+}
+
+/*
+ * Release the ring
+ */
+static void spsc_destroy(Queue *q) {
+    queue_storage_free(q->items, q->items_bytes);
+    q->items = NULL;
+    free(q->spsc);
+    q->spsc = NULL;
+}
+
+/*
+ * Producer: append up to n items without blocking, one tail publish
+ * Returns number of items appended (0 if the ring is full)
+ */
+static int spsc_push(Queue *q, const QueueItem *items, int n) {
+    struct SpscIndices *ix = q->spsc;
+    size_t capacity = (size_t)q->capacity;
+    size_t tail = atomic_load_explicit(&ix->tail, memory_order_relaxed);
+    
+    // Refresh the consumer's index only when the cached copy looks full
+    if (tail - ix->cached_head >= capacity) {
+        ix->cached_head = atomic_load_explicit(&ix->head, memory_order_acquire);
+    }
+    
+    size_t space = capacity - (tail - ix->cached_head);
+    size_t count = (size_t)n < space ? (size_t)n : space;
+    
+    // Copy in at most two contiguous runs (the ring may wrap)
+    size_t slot = tail % capacity;
+    size_t first = capacity - slot < count ? capacity - slot : count;
+    memcpy(&q->items[slot], items, first * sizeof(QueueItem));
+    memcpy(&q->items[0], items + first, (count - first) * sizeof(QueueItem));
+    
+    if (count > 0) {
+        atomic_store_explicit(&ix->tail, tail + count, memory_order_release);
+    }
+    return (int)count;
+}
+
+/*
+ * Consumer: remove up to max of the oldest items without blocking
+ * Returns number of items removed (0 if the ring is empty)
+ */
+static int spsc_pop(Queue *q, QueueItem *items, int max) {
+    struct SpscIndices *ix = q->spsc;
+    size_t capacity = (size_t)q->capacity;
+    size_t head = atomic_load_explicit(&ix->head, memory_order_relaxed);
+    
+    // Refresh the producer's index only when the cached copy looks empty
+    if (ix->cached_tail == head) {
+        ix->cached_tail = atomic_load_explicit(&ix->tail, memory_order_acquire);
+    }
+    
+    size_t avail = ix->cached_tail - head;
+    size_t count = (size_t)max < avail ? (size_t)max : avail;
+    
+    size_t slot = head % capacity;
+    size_t first = capacity - slot < count ? capacity - slot : count;
+    memcpy(items, &q->items[slot], first * sizeof(QueueItem));
+    memcpy(items + first, &q->items[0], (count - first) * sizeof(QueueItem));
+    
+    if (count > 0) {
+        atomic_store_explicit(&ix->head, head + count, memory_order_release);
+    }
+    return (int)count;
+}
+
+/*
+ * ADAPTIVE spin: the ring has a free slot (or shutdown started)
+ */
+static int spsc_has_space(Queue *q, void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    size_t head = atomic_load_explicit(&q->spsc->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->spsc->tail, memory_order_relaxed);
+    return queue_closed(q) || tail - head < (size_t)q->capacity;
+}
+
+/*
+ * ADAPTIVE spin: the ring holds an item (or shutdown started)
+ */
+static int spsc_has_items(Queue *q, void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    size_t head = atomic_load_explicit(&q->spsc->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->spsc->tail, memory_order_relaxed);
+    return queue_closed(q) || tail > head;
+}
+
+/*
+ * Enqueue n items, parking on not_full only while the ring is full (until
+ * deadline_ns; drop-newest drops the item instead)
+ * Returns number of items taken (enqueued or shed), -1 if none could be
+ * (queue closed or deadline passed)
+ */
+static int spsc_enqueue(Queue *q, const QueueItem *items, int n, uint64_t deadline_ns,
+                        QueueWaitInfo *wait) {
+    int done = 0;
+    int shed = 0;
+    
+    while (done < n && !queue_closed(q)) {
+        int pushed = spsc_push(q, items + done, n - done);
+        if (pushed > 0) {
+            done += pushed;
+            continue;
+        }
+    
+        // Full under drop-newest: shed this item and retry with the next
+        if (q->overflow == QUEUE_OVERFLOW_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&q->shed, 1, memory_order_relaxed);
+            shed++;
+            done++;
+            continue;
+        }
+    
+        // Ring is full: let the consumer see what we pushed so far
+        if (done > 0) {
+            queue_wake_parked(q, &q->waiting_consumers, &q->not_empty, 0);
+        }
+    
+        if (queue_deadline_passed(deadline_ns)) {
+            break;
+        }
+    
+        // Adaptive strategy: spin and yield before paying for a park
+        if (queue_spin_wait(q, &q->producer_spin, spsc_has_space, NULL, wait)) {
+            continue;
+        }
+    
+        // Register as a waiter, retry once, then park
+        INSTRUMENT_MUTEX_LOCK(&q->mutex);
+        atomic_fetch_add(&q->waiting_producers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+    
+        pushed = spsc_push(q, items + done, n - done);
+        if (pushed == 0 && !queue_closed(q)) {
+            uint64_t wait_start = timing_now_ns();
+            queue_park(q, &q->not_full, deadline_ns);
+            queue_park_end(q, &q->producer_spin, wait, wait_start);
+        }
+    
+        atomic_fetch_sub(&q->waiting_producers, 1);
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+        done += pushed;
+    }
+    
+    if (done == 0) {
+        return -1;
+    }
+    
+    if (DEBUG_MODE) {
+        printf("[QUEUE] Enqueued %d item(s): first value=%d, priority=%d, from P%d (spsc)\n",
+               done - shed, items[0].value, items[0].priority, items[0].producer_id);
+    }
+    
+    if (done > shed) {
+        queue_wake_parked(q, &q->waiting_consumers, &q->not_empty, 0);
+    }
+    return done;
+}
+
+/*
+ * Dequeue up to max of the oldest items, parking on not_empty only while
+ * the ring is empty and fewer than min items have been taken (until
+ * deadline_ns)
+ * Returns number of items dequeued, -1 if none could be (queue closed and
+ * empty, or deadline passed)
+ */
+static int spsc_dequeue(Queue *q, QueueItem *items, int max, int min, uint64_t deadline_ns,
+                        QueueWaitInfo *wait) {
+    int done = 0;
+    
+    for (;;) {
+        // Take whatever is available, up to max (a closed ring is still drained)
+        done += spsc_pop(q, items + done, max - done);
+        if (done >= min || queue_closed(q)) {
+            break;
+        }
+    
+        // Ring is empty: let the producer refill the slots we freed so far
+        if (done > 0) {
+            queue_wake_parked(q, &q->waiting_producers, &q->not_full, 0);
+        }
+    
+        if (queue_deadline_passed(deadline_ns)) {
+            break;
+        }
+    
+        // Adaptive strategy: spin and yield before paying for a park
+        if (queue_spin_wait(q, &q->consumer_spin, spsc_has_items, NULL, wait)) {
+            continue;
+        }
+    
+        // Register as a waiter, retry once, then park
+        INSTRUMENT_MUTEX_LOCK(&q->mutex);
+        atomic_fetch_add(&q->waiting_consumers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+    
+        int popped = spsc_pop(q, items + done, max - done);
+        if (popped == 0 && !queue_closed(q)) {
+            uint64_t wait_start = timing_now_ns();
+            queue_park(q, &q->not_empty, deadline_ns);
+            queue_park_end(q, &q->consumer_spin, wait, wait_start);
+        }
+    
+        atomic_fetch_sub(&q->waiting_consumers, 1);
+        INSTRUMENT_MUTEX_UNLOCK(&q->mutex);
+        done += popped;
+    }
+    
+    // Items already taken are returned even when a close or deadline interrupts
+    if (done == 0) {
+        return -1;
+    }
+    
+    if (DEBUG_MODE) {
+        printf("[QUEUE] Dequeued %d item(s): first value=%d, priority=%d, from P%d (spsc)\n",
+               done, items[0].value, items[0].priority, items[0].producer_id);
+    }
+    
+    queue_wake_parked(q, &q->waiting_producers, &q->not_full, 0);
+    return done;
+}
+
+/*
+ * Dequeue up to max of the oldest items without parking
+ * Returns number of items dequeued (0 if the ring is empty)
+ */
+static int spsc_try_dequeue(Queue *q, QueueItem *items, int max) {
+    int done = spsc_pop(q, items, max);
+    
+    if (done > 0) {
+        queue_wake_parked(q, &q->waiting_producers, &q->not_full, 0);
+    }
+    return done;
+}
+
+/*
+ * Number of items (exact when no operation is in progress)
+ */
+static int spsc_size(Queue *q) {
+    size_t head = atomic_load_explicit(&q->spsc->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&q->spsc->tail, memory_order_acquire);
+    
+    return tail > head ? (int)(tail - head) : 0;
+}
+
+/*
+ * Priority of the next item: the ring is FIFO, so any item reports
+ * PRIORITY_LOW; -1 if the ring is empty
+ */
+static int spsc_peek_priority(Queue *q) {
+    return spsc_size(q) > 0 ? PRIORITY_LOW : -1;
+}
+
+// Operations table for the SPSC backend (fixed capacity, no growth)
+const QueueOps queue_ops_spsc = {
+    .init          = spsc_init,
+    .destroy       = spsc_destroy,
+    .enqueue       = spsc_enqueue,
+    .dequeue       = spsc_dequeue,
+    .try_dequeue   = spsc_try_dequeue,
+    .peek_priority = spsc_peek_priority,
+    .size          = spsc_size,
+    .grow          = NULL,
+};
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * Reporter Implementation
+ *
+ * An optional thread that samples the analytics counters, the latency
+ * histograms and the queue depth once per interval and exports the
+ * interval rates. Everything it reads is lock-free on the hot path:
+ * analytics_get_snapshot() merges the per-thread counter slots with relaxed
+ * loads, histograms are plain atomic buckets and the queue depth comes from
+ * queue_get_size_approx(), so sampling never takes a queue or analytics lock.
+ *
+ * Samples go to a CSV file, or as one StatsD or Prometheus-text datagram
+ * per interval to a UDP endpoint (best effort, send errors are ignored).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "reporter.h"
+#include "histogram.h"
+#include "config.h"
+
+// Metric names are prefixed with this (StatsD: "prefix.", Prometheus: "prefix_")
+#define REPORTER_PREFIX "producer_consumer"
+
+// UDP payload limit, below a typical Ethernet MTU
+#define REPORTER_DATAGRAM_SIZE 1400
+
+// Exported metrics, in CSV column order
+typedef enum {
+    METRIC_ELAPSED = 0,
+    METRIC_QUEUE_DEPTH,
+    METRIC_PRODUCED_RATE,
+    METRIC_CONSUMED_RATE,
+    METRIC_PRODUCER_BLOCK_RATE,
+    METRIC_CONSUMER_BLOCK_RATE,
+    METRIC_LATENCY_SAMPLES,
+    METRIC_LATENCY_P50,
+    METRIC_LATENCY_P90,
+    METRIC_LATENCY_P99,
+    METRIC_LATENCY_P999,
+    METRIC_LATENCY_MAX,
+    METRIC_PRODUCED_TOTAL,
+    METRIC_CONSUMED_TOTAL,
+    METRIC_COUNT
+} ReporterMetric;
+
+static const char *metric_names[METRIC_COUNT] = {
+    "elapsed_seconds", "queue_depth",
+    "produced_per_second", "consumed_per_second",
+    "producer_blocks_per_second", "consumer_blocks_per_second",
+    "latency_samples", "latency_p50_ns", "latency_p90_ns", "latency_p99_ns",
+    "latency_p999_ns", "latency_max_ns",
+    "items_produced_total", "items_consumed_total"
+};
+
+static ReporterOptions options;
+static Analytics *analytics = NULL;
+static Queue **queues = NULL;
+static int queue_count = 0;
+
+static FILE *out_file = NULL;
+static int out_socket = -1;
+static struct sockaddr_storage out_addr;
+static socklen_t out_addr_len = 0;
+
+static pthread_t reporter_tid;
+static int reporter_running = 0;
+static int reporter_stopping = 0;           // Guarded by reporter_mutex
+static pthread_mutex_t reporter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reporter_cond;
+
+// State of the previous sample (interval deltas)
+static LatencyHistogram *hist_prev = NULL;
+static LatencyHistogram *hist_cur = NULL;
+static LatencyHistogram *hist_interval = NULL;
+static long prev_produced, prev_consumed, prev_producer_blocks, prev_consumer_blocks;
+static uint64_t start_ns, prev_ns;
+
+/*
+ * Current CLOCK_MONOTONIC time in ns (the clock reporter_cond waits on)
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Parse a -o target: "statsd:host:port", "prom:host:port", or a file path
+ * (optionally written "file:path")
+ * Returns 0 on success, -1 on a malformed target
+ */
+int reporter_parse_target(const char *spec, ReporterOptions *opts) {
+    const char *rest = spec;
+    
+    if (strncmp(spec, "statsd:", 7) == 0) {
+        opts->sink = REPORTER_SINK_STATSD;
+        rest = spec + 7;
+    } else if (strncmp(spec, "prom:", 5) == 0) {
+        opts->sink = REPORTER_SINK_PROMETHEUS;
+        rest = spec + 5;
+    } else {
+        opts->sink = REPORTER_SINK_FILE;
+        if (strncmp(spec, "file:", 5) == 0) {
+            rest = spec + 5;
+        }
+        if (*rest == '\0' || strlen(rest) >= sizeof(opts->target)) {
+            return -1;
+        }
+        strcpy(opts->target, rest);
+        opts->port[0] = '\0';
+        return 0;
+    }
+    
+    // host:port, split at the last colon
+    const char *colon = strrchr(rest, ':');
+    if (colon == NULL || colon == rest || colon[1] == '\0' ||
+        (size_t)(colon - rest) >= sizeof(opts->target) || strlen(colon + 1) >= sizeof(opts->port)) {
+        return -1;
+    }
+    memcpy(opts->target, rest, (size_t)(colon - rest));
+    opts->target[colon - rest] = '\0';
+    strcpy(opts->port, colon + 1);
+    
+    return 0;
+}
+
+/*
+ * Open the output file or resolve the UDP endpoint
+ * Returns 0 on success, -1 on error
+ */
+static int open_sink(void) {
+    if (options.sink == REPORTER_SINK_FILE) {
+        out_file = fopen(options.target, "w");
+        if (out_file == NULL) {
+            fprintf(stderr, "Error: Cannot open metrics file '%s': %s\n",
+                    options.target, strerror(errno));
+            return -1;
+        }
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            fprintf(out_file, "%s%s", m > 0 ? "," : "", metric_names[m]);
+        }
+        fprintf(out_file, "\n");
+        fflush(out_file);
+        return 0;
+    }
+    
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    
+    int rc = getaddrinfo(options.target, options.port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Cannot resolve metrics endpoint %s:%s: %s\n",
+                options.target, options.port, gai_strerror(rc));
+        return -1;
+    }
+    
+    out_socket = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (out_socket < 0) {
+        fprintf(stderr, "Error: Cannot create metrics socket: %s\n", strerror(errno));
+        freeaddrinfo(res);
+        return -1;
+    }
+    memcpy(&out_addr, res->ai_addr, res->ai_addrlen);
+    out_addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    
+    return 0;
+}
+
+/*
+ * Close the output file or socket
+ */
+static void close_sink(void) {
+    if (out_file != NULL) {
+        fclose(out_file);
+        out_file = NULL;
+    }
+    if (out_socket >= 0) {
+        close(out_socket);
+        out_socket = -1;
+    }
+}
+
+/*
+ * Write one sample to the sink
+ */
+static void emit_sample(const double *values) {
+    char buf[REPORTER_DATAGRAM_SIZE];
+    int len = 0;
+    
+    if (options.sink == REPORTER_SINK_FILE) {
+        // Elapsed time is the first column, everything else is integral
+        fprintf(out_file, "%.3f", values[METRIC_ELAPSED]);
+        for (int m = METRIC_ELAPSED + 1; m < METRIC_COUNT; m++) {
+            fprintf(out_file, ",%.0f", values[m]);
+        }
+        fprintf(out_file, "\n");
+        fflush(out_file);
+        return;
+    }
+    
+    // One line per metric; a full datagram is sent and a new one started
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        char line[256];
+        int n;
+    
+        if (options.sink == REPORTER_SINK_STATSD) {
+            n = snprintf(line, sizeof(line), "%s.%s:%.*f|g\n", REPORTER_PREFIX,
+                         metric_names[m], m == METRIC_ELAPSED ? 3 : 0, values[m]);
+        } else {
+            int counter = m == METRIC_PRODUCED_TOTAL || m == METRIC_CONSUMED_TOTAL;
+            n = snprintf(line, sizeof(line), "# TYPE %s_%s %s\n%s_%s %.3f\n",
+                         REPORTER_PREFIX, metric_names[m], counter ? "counter" : "gauge",
+                         REPORTER_PREFIX, metric_names[m], values[m]);
+        }
+    
+        if (len + n > (int)sizeof(buf)) {
+            sendto(out_socket, buf, (size_t)len, 0, (struct sockaddr *)&out_addr, out_addr_len);
+            len = 0;
+        }
+        memcpy(buf + len, line, (size_t)n);
+        len += n;
+    }
+    
+    if (len > 0) {
+        sendto(out_socket, buf, (size_t)len, 0, (struct sockaddr *)&out_addr, out_addr_len);
+    }
+}
+
+/*
+ * Take one sample: interval rates since the previous one, the current
+ * queue depth and the latency percentiles of the items consumed meanwhile
+ */
+static void take_sample(void) {
+    uint64_t now = monotonic_ns();
+    double interval_s = now > prev_ns ? (now - prev_ns) / 1e9 : 0.0;
+    long produced = 0, consumed = 0, producer_blocks = 0, consumer_blocks = 0;
+    double values[METRIC_COUNT];
+    
+    analytics_get_snapshot(analytics, &produced, &consumed, &producer_blocks, &consumer_blocks);
+    analytics_latency_histogram(analytics, ANALYTICS_CLASSES, hist_cur);
+    
+    histogram_reset(hist_interval);
+    histogram_merge(hist_interval, hist_cur);
+    histogram_subtract(hist_interval, hist_prev);
+    
+    // Depth without the queue mutexes: every backend keeps its size in
+    // atomics, so sampling never races or stalls the workers
+    long depth = 0;
+    for (int i = 0; i < queue_count; i++) {
+        depth += queue_get_size_approx(queues[i]);
+    }
+    
+    values[METRIC_ELAPSED] = (now - start_ns) / 1e9;
+    values[METRIC_QUEUE_DEPTH] = (double)depth;
+    values[METRIC_PRODUCED_RATE] = interval_s > 0 ? (produced - prev_produced) / interval_s : 0.0;
+    values[METRIC_CONSUMED_RATE] = interval_s > 0 ? (consumed - prev_consumed) / interval_s : 0.0;
+    values[METRIC_PRODUCER_BLOCK_RATE] = interval_s > 0 ?
+                                         (producer_blocks - prev_producer_blocks) / interval_s : 0.0;
+    values[METRIC_CONSUMER_BLOCK_RATE] = interval_s > 0 ?
+                                         (consumer_blocks - prev_consumer_blocks) / interval_s : 0.0;
+    values[METRIC_LATENCY_SAMPLES] = (double)histogram_count(hist_interval);
+    values[METRIC_LATENCY_P50] = (double)histogram_percentile(hist_interval, 50.0);
+    values[METRIC_LATENCY_P90] = (double)histogram_percentile(hist_interval, 90.0);
+    values[METRIC_LATENCY_P99] = (double)histogram_percentile(hist_interval, 99.0);
+    values[METRIC_LATENCY_P999] = (double)histogram_percentile(hist_interval, 99.9);
+    values[METRIC_LATENCY_MAX] = (double)histogram_max(hist_interval);
+    values[METRIC_PRODUCED_TOTAL] = (double)produced;
+    values[METRIC_CONSUMED_TOTAL] = (double)consumed;
+    
+    emit_sample(values);
+    
+    // The current totals become the baseline of the next interval
+    LatencyHistogram *swap = hist_prev;
+    hist_prev = hist_cur;
+    hist_cur = swap;
+    prev_produced = produced;
+    prev_consumed = consumed;
+    prev_producer_blocks = producer_blocks;
+    prev_consumer_blocks = consumer_blocks;
+    prev_ns = now;
+}
+
+/*
+ * Reporter thread: sample on a fixed schedule until reporter_stop()
+ */
+static void* reporter_thread(void *arg) {
+    (void)arg;
+    uint64_t next = start_ns + options.interval_ns;
+    
+    pthread_mutex_lock(&reporter_mutex);
+    while (!reporter_stopping) {
+        struct timespec deadline;
+        deadline.tv_sec = (time_t)(next / 1000000000ULL);
+        deadline.tv_nsec = (long)(next % 1000000000ULL);
+        pthread_cond_timedwait(&reporter_cond, &reporter_mutex, &deadline);
+    
+        uint64_t now = monotonic_ns();
+        if (reporter_stopping || now < next) {
+            continue;
+        }
+    
+        pthread_mutex_unlock(&reporter_mutex);
+        take_sample();
+        pthread_mutex_lock(&reporter_mutex);
+    
+        // Skip the ticks missed by a slow sink instead of bursting
+        next += options.interval_ns;
+        if (next <= now) {
+            next = now + options.interval_ns;
+        }
+    }
+    pthread_mutex_unlock(&reporter_mutex);
+    
+    return NULL;
+}
+
+/*
+ * Start sampling a and the given queues every opts->interval_ns
+ * Returns 0 on success, -1 on error
+ */
+int reporter_start(const ReporterOptions *opts, Analytics *a, Queue *const *qs, int n_queues) {
+    if (opts == NULL || a == NULL || opts->interval_ns == 0 || n_queues < 1) {
+        fprintf(stderr, "Error: Invalid reporter configuration\n");
+        return -1;
+    }
+    
+    options = *opts;
+    analytics = a;
+    
+    queues = (Queue **)malloc(sizeof(Queue *) * (size_t)n_queues);
+    hist_prev = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    hist_cur = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    hist_interval = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    if (queues == NULL || hist_prev == NULL || hist_cur == NULL || hist_interval == NULL) {
+        fprintf(stderr, "Error: Failed to allocate reporter state\n");
+        reporter_stop();
+        return -1;
+    }
+    memcpy(queues, qs, sizeof(Queue *) * (size_t)n_queues);
+    queue_count = n_queues;
+    
+    if (open_sink() != 0) {
+        reporter_stop();
+        return -1;
+    }
+    
+    // Baseline: the first interval starts now
+    analytics_get_snapshot(analytics, &prev_produced, &prev_consumed,
+                           &prev_producer_blocks, &prev_consumer_blocks);
+    analytics_latency_histogram(analytics, ANALYTICS_CLASSES, hist_prev);
+    start_ns = monotonic_ns();
+    prev_ns = start_ns;
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&reporter_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    reporter_stopping = 0;
+    
+    if (pthread_create(&reporter_tid, NULL, reporter_thread, NULL) != 0) {
+        fprintf(stderr, "Error: Failed to create reporter thread\n");
+        pthread_cond_destroy(&reporter_cond);
+        reporter_stop();
+        return -1;
+    }
+    reporter_running = 1;
+    
+    if (DEBUG_MODE) {
+        printf("[REPORTER] Sampling every %llu ns\n", (unsigned long long)options.interval_ns);
+    }
+    
+    return 0;
+}
+
+/*
+ * Stop the reporter thread, emit one last (partial interval) sample and
+ * release everything (safe to call when the reporter never started)
+ */
+void reporter_stop(void) {
+    if (reporter_running) {
+        pthread_mutex_lock(&reporter_mutex);
+        reporter_stopping = 1;
+        pthread_cond_signal(&reporter_cond);
+        pthread_mutex_unlock(&reporter_mutex);
+    
+        pthread_join(reporter_tid, NULL);
+        pthread_cond_destroy(&reporter_cond);
+        reporter_running = 0;
+    
+        take_sample();
+    }
+    
+    close_sink();
+    free(queues);
+    free(hist_prev);
+    free(hist_cur);
+    free(hist_interval);
+    queues = NULL;
+    hist_prev = NULL;
+    hist_cur = NULL;
+    hist_interval = NULL;
+    queue_count = 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * Sharded Queue Implementation
+ *
+ * Spreads producers over several independent Queues so they stop
+ * contending on one mutex. Each consumer has a home shard it drains
+ * first; a different shard is used when it is holding a strictly higher
+ * priority item, or when the home shard is empty (work stealing), so
+ * priority still wins across shards. Consumers with nothing to take in
+ * any shard park on one shared condition variable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "shard.h"
+#include "queue.h"
+#include "queue_backend.h"
+#include "timing.h"
+#include "config.h"
+
+/*
+ * Create n_shards queues, each built from opts
+ * nodes (optional) gives the NUMA node for each shard's storage
+ */
+ShardedQueue* sharded_queue_init(int n_shards, const QueueOptions *opts, const int *nodes) {
+    if (n_shards < 1 || opts == NULL) {
+        fprintf(stderr, "Error: Invalid shard count %d\n", n_shards);
+        return NULL;
+    }
+    
+    ShardedQueue *sq = (ShardedQueue *)malloc(sizeof(ShardedQueue));
+    if (sq == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sharded queue\n");
+        return NULL;
+    }
+    
+    sq->shards = (Queue **)calloc((size_t)n_shards, sizeof(Queue *));
+    if (sq->shards == NULL) {
+        fprintf(stderr, "Error: Failed to allocate shard table\n");
+        free(sq);
+        return NULL;
+    }
+    sq->n_shards = n_shards;
+    
+    QueueOptions shard_opts = *opts;
+    for (int i = 0; i < n_shards; i++) {
+        if (nodes != NULL) {
+            shard_opts.numa_node = nodes[i];
+        }
+        sq->shards[i] = queue_init_with(&shard_opts);
+        if (sq->shards[i] == NULL) {
+            fprintf(stderr, "Error: Failed to initialize shard %d\n", i);
+            sharded_queue_destroy(sq);
+            return NULL;
+        }
+    }
+    
+    atomic_init(&sq->pending, 0);
+    atomic_init(&sq->sleepers, 0);
+    atomic_init(&sq->closed, 0);
+    pthread_mutex_init(&sq->mutex, NULL);
+    pthread_cond_init(&sq->not_empty, NULL);
+    
+    if (DEBUG_MODE) {
+        printf("[SHARD] Sharded queue initialized: %d shard(s)\n", n_shards);
+    }
+    
+    return sq;
+}
+
+/*
+ * Destroy every shard and the sharded queue itself
+ */
+void sharded_queue_destroy(ShardedQueue *sq) {
+    if (sq == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < sq->n_shards; i++) {
+        queue_destroy(sq->shards[i]);
+    }
+    
+    // Only a fully initialized queue has its synchronization set up
+    if (sq->n_shards > 0 && sq->shards[sq->n_shards - 1] != NULL) {
+        pthread_cond_destroy(&sq->not_empty);
+        pthread_mutex_destroy(&sq->mutex);
+    }
+    
+    free(sq->shards);
+    free(sq);
+}
+
+/*
+ * Get the queue backing one shard
+ */
+Queue* sharded_queue_shard(ShardedQueue *sq, int shard) {
+    return sq->shards[shard % sq->n_shards];
+}
+
+/*
+ * Home shard of the producer or consumer with the given 0-based index
+ */
+int sharded_queue_home(ShardedQueue *sq, int thread_index) {
+    return thread_index % sq->n_shards;
+}
+
+/*
+ * Wake parked consumers if there are any
+ * The fence pairs with the one in the parking path (see sharded_dequeue_batch)
+ */
+static void sharded_wake(ShardedQueue *sq, int all) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&sq->sleepers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&sq->mutex);
+        if (all) {
+            pthread_cond_broadcast(&sq->not_empty);
+        } else {
+            pthread_cond_signal(&sq->not_empty);
+        }
+        pthread_mutex_unlock(&sq->mutex);
+    }
+}
+
+/*
+ * Enqueue n items into one shard (blocks while that shard is full)
+ * Returns number of items enqueued, or -1 on error/timeout
+ */
+int sharded_enqueue_batch(ShardedQueue *sq, int shard, const QueueItem *items, int n,
+                          QueueWaitInfo *wait) {
+    int done = queue_enqueue_batch(sharded_queue_shard(sq, shard), items, n, wait);
+    
+    if (done > 0) {
+        atomic_fetch_add_explicit(&sq->pending, done, memory_order_relaxed);
+        sharded_wake(sq, done > 1);
+    }
+    
+    return done;
+}
+
+/*
+ * Pick the shard to dequeue from: the one whose next item has the highest
+ * priority, the home shard winning ties
+ * Returns -1 if every shard looks empty
+ */
+static int pick_shard(ShardedQueue *sq, int home) {
+    int best = -1;
+    int best_priority = -1;
+    
+    for (int k = 0; k < sq->n_shards; k++) {
+        int shard = (home + k) % sq->n_shards;
+        int priority = queue_peek_priority(sq->shards[shard]);
+        if (priority > best_priority) {
+            best = shard;
+            best_priority = priority;
+        }
+    }
+    
+    return best;
+}
+
+/*
+ * ADAPTIVE spin: some shard holds an item (or shutdown started)
+ */
+static int shards_have_items(Queue *q, void *arg) {
+    (void)q; // Suppress unused parameter warning
+    ShardedQueue *sq = (ShardedQueue *)arg;
+    return atomic_load_explicit(&sq->closed, memory_order_acquire) ||
+           atomic_load_explicit(&sq->pending, memory_order_relaxed) > 0;
+}
+
+/*
+ * Dequeue up to max items, preferring the home shard and stealing from the
+ * others when they hold higher priority work or home is empty
+ * Blocks while every shard is empty; *from_shard receives the shard used
+ * Returns number of items dequeued, or -1 once the set is closed and empty
+ */
+int sharded_dequeue_batch(ShardedQueue *sq, int home, QueueItem *items, int max,
+                          QueueWaitInfo *wait, int *from_shard) {
+    QueueWaitInfo local_wait;
+    if (wait == NULL) {
+        wait = &local_wait;
+    }
+    memset(wait, 0, sizeof(*wait));
+    
+    home %= sq->n_shards;
+    Queue *home_queue = sq->shards[home];
+    
+    for (;;) {
+        int shard = pick_shard(sq, home);
+    
+        if (shard >= 0) {
+            int done = queue_try_dequeue_batch(sq->shards[shard], items, max);
+            if (done > 0) {
+                atomic_fetch_sub_explicit(&sq->pending, done, memory_order_relaxed);
+                if (from_shard != NULL) {
+                    *from_shard = shard;
+                }
+                return done;
+            }
+            // Another consumer emptied the shard first - look again
+            continue;
+        }
+    
+        // Closed and every shard empty
+        if (atomic_load_explicit(&sq->closed, memory_order_acquire)) {
+            break;
+        }
+    
+        // Nothing anywhere: spin and yield first under the adaptive strategy
+        // (with the home shard's budget)
+        if (queue_spin_wait(home_queue, &home_queue->consumer_spin, shards_have_items, sq, wait)) {
+            continue;
+        }
+    
+        // Register as a sleeper, re-check, then park
+        pthread_mutex_lock(&sq->mutex);
+        atomic_fetch_add(&sq->sleepers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+    
+        if (atomic_load_explicit(&sq->pending, memory_order_relaxed) <= 0 &&
+            !atomic_load_explicit(&sq->closed, memory_order_acquire)) {
+            uint64_t wait_start = timing_now_ns();
+            pthread_cond_wait(&sq->not_empty, &sq->mutex);
+            queue_park_end(home_queue, &home_queue->consumer_spin, wait, wait_start);
+        }
+    
+        atomic_fetch_sub(&sq->sleepers, 1);
+        pthread_mutex_unlock(&sq->mutex);
+    }
+    
+    return -1;
+}
+
+/*
+ * Close every shard and the set: threads blocked in any shard, or parked
+ * waiting for work in all of them, return
+ */
+void sharded_queue_close(ShardedQueue *sq) {
+    if (sq == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < sq->n_shards; i++) {
+        queue_close(sq->shards[i]);
+    }
+    atomic_store_explicit(&sq->closed, 1, memory_order_release);
+    
+    pthread_mutex_lock(&sq->mutex);
+    pthread_cond_broadcast(&sq->not_empty);
+    pthread_mutex_unlock(&sq->mutex);
+}
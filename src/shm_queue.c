@@ -0,0 +1,473 @@
+/*
+ * Shared-Memory Queue Implementation
+ *
+ * The queue lives in a POSIX shared-memory segment (shm_open + mmap) so
+ * separate producer and consumer processes can attach to it by name. The
+ * layout is the BUCKET backend's: a slot pool linked into one FIFO per
+ * priority level by index, with a bitmap of non-empty levels, guarded by a
+ * process-shared robust mutex. Blocked callers sleep on futex wait words
+ * in the segment rather than on condition variables, so a peer killed in
+ * the middle of a wait leaves nothing behind.
+ *
+ * If a process dies holding the lock, the next locker gets EOWNERDEAD and
+ * rebuilds the lists from what is reachable before marking the mutex
+ * consistent; an item that was half linked is lost, nothing else is.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shm_queue.h"
+#include "queue_backend.h"
+#include "timing.h"
+#include "config.h"
+
+// Blocked calls recheck for dead peers and shutdown this often
+#define SHM_WAIT_SLICE_NS 100000000ULL
+
+// How long an attacher waits for the creator to finish initializing
+#define SHM_ATTACH_TIMEOUT_NS 2000000000ULL
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+static int shm_level(int priority) {
+    if (priority < 0) {
+        return 0;
+    }
+    if (priority >= QUEUE_PRIORITY_LEVELS) {
+        return QUEUE_PRIORITY_LEVELS - 1;
+    }
+    return priority;
+}
+
+/*
+ * Chain every slot into the free list and empty the priority lists
+ */
+static void shm_reset(ShmQueue *q) {
+    ShmQueueHeader *h = q->hdr;
+    for (int i = 0; i < h->capacity - 1; i++) {
+        q->next[i] = i + 1;
+    }
+    q->next[h->capacity - 1] = -1;
+    h->free_head = 0;
+    
+    for (int p = 0; p < QUEUE_PRIORITY_LEVELS; p++) {
+        h->level_head[p] = -1;
+        h->level_tail[p] = -1;
+    }
+    h->level_bitmap = 0;
+    h->size = 0;
+}
+
+/*
+ * Rebuild the lists after a lock owner died mid-operation
+ * Keeps every item reachable from a level head, returns the rest to the
+ * free list
+ */
+static void shm_repair(ShmQueue *q) {
+    ShmQueueHeader *h = q->hdr;
+    unsigned char *used = (unsigned char *)calloc((size_t)h->capacity, 1);
+    if (used == NULL) {
+        // Cannot tell what is linked: start over empty
+        shm_reset(q);
+        return;
+    }
+    
+    h->size = 0;
+    h->level_bitmap = 0;
+    for (int p = 0; p < QUEUE_PRIORITY_LEVELS; p++) {
+        int slot = h->level_head[p];
+        int last = -1;
+        while (slot >= 0 && slot < h->capacity && !used[slot]) {
+            used[slot] = 1;
+            last = slot;
+            slot = q->next[slot];
+            h->size++;
+        }
+        if (last < 0) {
+            h->level_head[p] = -1;
+            h->level_tail[p] = -1;
+        } else {
+            q->next[last] = -1;
+            h->level_tail[p] = last;
+            h->level_bitmap |= 1u << p;
+        }
+    }
+    
+    h->free_head = -1;
+    for (int i = h->capacity - 1; i >= 0; i--) {
+        if (!used[i]) {
+            q->next[i] = h->free_head;
+            h->free_head = i;
+        }
+    }
+    free(used);
+}
+
+/*
+ * Take over the state of a lock whose owner died (rc from a lock or wait)
+ */
+static void shm_recover(ShmQueue *q, int rc) {
+    if (rc != EOWNERDEAD) {
+        return;
+    }
+    
+    shm_repair(q);
+    q->hdr->recoveries++;
+    pthread_mutex_consistent(&q->hdr->mutex);
+    fprintf(stderr, "Warning: Queue '%s' recovered from a process that died holding its lock"
+            " (%d item(s) kept)\n", q->name, q->hdr->size);
+}
+
+static void shm_lock(ShmQueue *q) {
+    shm_recover(q, pthread_mutex_lock(&q->hdr->mutex));
+}
+
+/*
+ * Sleep until seq moves on, for at most one slice (so a dead peer cannot
+ * strand us)
+ * Must be called with mutex locked; returns with it locked again. Reading
+ * seq before unlocking means a bump made after our check wakes us.
+ */
+static void shm_wait(ShmQueue *q, atomic_uint *seq, atomic_int *waiters) {
+    unsigned int seen = atomic_load_explicit(seq, memory_order_relaxed);
+    struct timespec slice = { 0, (long)SHM_WAIT_SLICE_NS };
+    
+    atomic_fetch_add(waiters, 1);
+    pthread_mutex_unlock(&q->hdr->mutex);
+    syscall(SYS_futex, (unsigned int *)seq, FUTEX_WAIT, seen, &slice, NULL, 0);
+    shm_lock(q);
+    atomic_fetch_sub(waiters, 1);
+}
+
+/*
+ * Bump seq and wake one or all sleepers on it (any process)
+ */
+static void shm_wake(atomic_uint *seq, atomic_int *waiters, int all) {
+    atomic_fetch_add(seq, 1);
+    if (atomic_load(waiters) > 0) {
+        syscall(SYS_futex, (unsigned int *)seq, FUTEX_WAKE, all ? INT32_MAX : 1, NULL, NULL, 0);
+    }
+}
+
+/*
+ * Initialize a new segment's header, lists and synchronization objects
+ */
+static int shm_init_header(ShmQueue *q, int capacity, size_t items_offset, size_t next_offset,
+                           size_t bytes) {
+    ShmQueueHeader *h = q->hdr;
+    h->version = SHM_QUEUE_VERSION;
+    h->item_size = (uint32_t)sizeof(QueueItem);
+    h->capacity = capacity;
+    h->items_offset = items_offset;
+    h->next_offset = next_offset;
+    h->segment_bytes = bytes;
+    atomic_init(&h->attached, 0);
+    atomic_init(&h->producers, 0);
+    atomic_init(&h->producers_seen, 0);
+    atomic_init(&h->not_full_seq, 0);
+    atomic_init(&h->not_empty_seq, 0);
+    atomic_init(&h->full_waiters, 0);
+    atomic_init(&h->empty_waiters, 0);
+    h->recoveries = 0;
+    q->items = (QueueItem *)((char *)h + items_offset);
+    q->next = (int *)((char *)h + next_offset);
+    shm_reset(q);
+    
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(&h->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Failed to initialize process-shared queue lock\n");
+        return -1;
+    }
+    
+    h->magic = SHM_QUEUE_MAGIC;
+    atomic_store_explicit(&h->ready, 1, memory_order_release);
+    return 0;
+}
+
+/*
+ * Map an existing segment once its creator has sized and initialized it
+ */
+static ShmQueueHeader* shm_attach_existing(int fd, const char *name, size_t *bytes) {
+    uint64_t give_up = timing_now_ns() + SHM_ATTACH_TIMEOUT_NS;
+    struct stat st;
+    
+    // The creator may not have sized the segment yet
+    while (fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(ShmQueueHeader)) {
+        if (timing_now_ns() > give_up) {
+            fprintf(stderr, "Error: Queue '%s' was never initialized\n", name);
+            return NULL;
+        }
+        timing_pause_ns(1000000, 0);
+    }
+    
+    ShmQueueHeader *h = (ShmQueueHeader *)mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED, fd, 0);
+    if (h == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map queue '%s': %s\n", name, strerror(errno));
+        return NULL;
+    }
+    *bytes = (size_t)st.st_size;
+    
+    while (!atomic_load_explicit(&h->ready, memory_order_acquire)) {
+        if (timing_now_ns() > give_up) {
+            fprintf(stderr, "Error: Queue '%s' was never initialized\n", name);
+            munmap(h, *bytes);
+            return NULL;
+        }
+        timing_pause_ns(1000000, 0);
+    }
+    
+    if (h->magic != SHM_QUEUE_MAGIC || h->version != SHM_QUEUE_VERSION ||
+        h->item_size != sizeof(QueueItem) || h->segment_bytes != *bytes) {
+        fprintf(stderr, "Error: '%s' is not a compatible queue (item size %u, this build %zu)\n",
+                name, h->item_size, sizeof(QueueItem));
+        munmap(h, *bytes);
+        return NULL;
+    }
+    return h;
+}
+
+/*
+ * Attach to the queue called name, creating it with capacity slots if it
+ * does not exist yet (capacity is ignored when attaching)
+ * name follows shm_open() rules, e.g. "/pcq"
+ */
+ShmQueue* shm_queue_open(const char *name, int capacity, ShmQueueRole role) {
+    if (name == NULL || strlen(name) >= sizeof(((ShmQueue *)0)->name)) {
+        fprintf(stderr, "Error: Invalid shared queue name\n");
+        return NULL;
+    }
+    
+    ShmQueue *q = (ShmQueue *)calloc(1, sizeof(ShmQueue));
+    if (q == NULL) {
+        fprintf(stderr, "Error: Failed to allocate shared queue handle\n");
+        return NULL;
+    }
+    strcpy(q->name, name);
+    q->role = role;
+    
+    int created = 1;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = 0;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open shared queue '%s': %s\n", name, strerror(errno));
+        free(q);
+        return NULL;
+    }
+    
+    size_t bytes = 0;
+    if (created) {
+        if (capacity < MIN_QUEUE_SIZE || capacity > MAX_QUEUE_SIZE) {
+            fprintf(stderr, "Error: queue_size must be between %d and %d\n",
+                    MIN_QUEUE_SIZE, MAX_QUEUE_SIZE);
+            close(fd);
+            shm_unlink(name);
+            free(q);
+            return NULL;
+        }
+        size_t items_offset = round_up(sizeof(ShmQueueHeader), CACHE_LINE_SIZE);
+        size_t next_offset = round_up(items_offset + sizeof(QueueItem) * (size_t)capacity,
+                                      CACHE_LINE_SIZE);
+        bytes = round_up(next_offset + sizeof(int) * (size_t)capacity, CACHE_LINE_SIZE);
+    
+        if (ftruncate(fd, (off_t)bytes) != 0 ||
+            (q->hdr = (ShmQueueHeader *)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                             fd, 0)) == MAP_FAILED) {
+            fprintf(stderr, "Error: Cannot size shared queue '%s': %s\n", name, strerror(errno));
+            close(fd);
+            shm_unlink(name);
+            free(q);
+            return NULL;
+        }
+        if (shm_init_header(q, capacity, items_offset, next_offset, bytes) != 0) {
+            munmap(q->hdr, bytes);
+            close(fd);
+            shm_unlink(name);
+            free(q);
+            return NULL;
+        }
+    } else {
+        q->hdr = shm_attach_existing(fd, name, &bytes);
+        if (q->hdr == NULL) {
+            close(fd);
+            free(q);
+            return NULL;
+        }
+        q->items = (QueueItem *)((char *)q->hdr + q->hdr->items_offset);
+        q->next = (int *)((char *)q->hdr + q->hdr->next_offset);
+    }
+    close(fd); // The mapping keeps the segment
+    
+    atomic_fetch_add(&q->hdr->attached, 1);
+    if (role == SHM_ROLE_PRODUCER) {
+        atomic_fetch_add(&q->hdr->producers, 1);
+        atomic_store(&q->hdr->producers_seen, 1);
+    }
+    
+    if (DEBUG_MODE) {
+        printf("[SHM] %s queue '%s' (%d slots, %zu bytes)\n", created ? "Created" : "Attached to",
+               name, q->hdr->capacity, bytes);
+    }
+    return q;
+}
+
+/*
+ * Detach from the queue; the last process out removes the segment
+ * A departing producer wakes consumers so they can notice the queue has
+ * no producers left
+ */
+void shm_queue_detach(ShmQueue *q) {
+    if (q == NULL) {
+        return;
+    }
+    
+    ShmQueueHeader *h = q->hdr;
+    if (q->role == SHM_ROLE_PRODUCER) {
+        shm_lock(q);
+        atomic_fetch_sub(&h->producers, 1);
+        shm_wake(&h->not_empty_seq, &h->empty_waiters, 1);
+        pthread_mutex_unlock(&h->mutex);
+    }
+    
+    int last = atomic_fetch_sub(&h->attached, 1) == 1;
+    munmap(h, h->segment_bytes);
+    if (last) {
+        shm_unlink(q->name);
+    }
+    free(q);
+}
+
+/*
+ * Make this process' blocked calls return (both directions)
+ */
+void shm_queue_wake(ShmQueue *q) {
+    if (q == NULL) {
+        return;
+    }
+    
+    shm_lock(q);
+    q->stopping = 1;
+    shm_wake(&q->hdr->not_full_seq, &q->hdr->full_waiters, 1);
+    shm_wake(&q->hdr->not_empty_seq, &q->hdr->empty_waiters, 1);
+    pthread_mutex_unlock(&q->hdr->mutex);
+}
+
+/*
+ * Add up to n items, blocking while the queue is full
+ * Returns the number added (fewer only if woken by shm_queue_wake)
+ */
+int shm_queue_enqueue_batch(ShmQueue *q, const QueueItem *items, int n, QueueWaitInfo *wait) {
+    ShmQueueHeader *h = q->hdr;
+    int done = 0;
+    
+    memset(wait, 0, sizeof(*wait));
+    
+    shm_lock(q);
+    while (done < n) {
+        if (h->size == h->capacity) {
+            uint64_t start = timing_now_ns();
+            while (h->size == h->capacity && !q->stopping) {
+                shm_wait(q, &h->not_full_seq, &h->full_waiters);
+            }
+            queue_wait_end(wait, start);
+            if (q->stopping) {
+                break;
+            }
+        }
+    
+        int pushed = 0;
+        while (done < n && h->size < h->capacity) {
+            const QueueItem *item = &items[done++];
+            int slot = h->free_head;
+            h->free_head = q->next[slot];
+            q->items[slot] = *item;
+            q->next[slot] = -1;
+    
+            int level = shm_level(item->priority);
+            if (h->level_tail[level] == -1) {
+                h->level_head[level] = slot;
+                h->level_bitmap |= 1u << level;
+            } else {
+                q->next[h->level_tail[level]] = slot;
+            }
+            h->level_tail[level] = slot;
+            h->size++;
+            pushed++;
+        }
+        shm_wake(&h->not_empty_seq, &h->empty_waiters, pushed > 1);
+    }
+    pthread_mutex_unlock(&h->mutex);
+    
+    return done;
+}
+
+/*
+ * Remove up to max items, highest priority first (FIFO within a level),
+ * blocking while the queue is empty
+ * Returns the number removed; 0 once woken by shm_queue_wake, or when the
+ * queue is empty and every producer that attached has left
+ */
+int shm_queue_dequeue_batch(ShmQueue *q, QueueItem *items, int max, QueueWaitInfo *wait) {
+    ShmQueueHeader *h = q->hdr;
+    int done = 0;
+    
+    memset(wait, 0, sizeof(*wait));
+    
+    shm_lock(q);
+    if (h->size == 0) {
+        uint64_t start = timing_now_ns();
+        while (h->size == 0 && !q->stopping &&
+               !(atomic_load(&h->producers_seen) && atomic_load(&h->producers) == 0)) {
+            shm_wait(q, &h->not_empty_seq, &h->empty_waiters);
+        }
+        queue_wait_end(wait, start);
+    }
+    
+    while (done < max && h->size > 0) {
+        // Highest set bit of the bitmap is the highest non-empty level
+        int level = 31 - __builtin_clz(h->level_bitmap);
+        int slot = h->level_head[level];
+    
+        items[done++] = q->items[slot];
+        h->level_head[level] = q->next[slot];
+        if (h->level_head[level] == -1) {
+            h->level_tail[level] = -1;
+            h->level_bitmap &= ~(1u << level);
+        }
+        q->next[slot] = h->free_head;
+        h->free_head = slot;
+        h->size--;
+    }
+    if (done > 0) {
+        shm_wake(&h->not_full_seq, &h->full_waiters, done > 1);
+    }
+    pthread_mutex_unlock(&h->mutex);
+    
+    return done;
+}
+
+/*
+ * Current number of items (unlocked read, for reports)
+ */
+int shm_queue_size(ShmQueue *q) {
+    return __atomic_load_n(&q->hdr->size, __ATOMIC_RELAXED);
+}
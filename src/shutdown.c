@@ -0,0 +1,307 @@
+/*
+ * Shutdown Implementation
+ *
+ * Replaces the alarm()/SIGALRM handler. SIGINT and SIGTERM are blocked in
+ * every thread (the mask set by shutdown_init is inherited by the threads
+ * created after it) and collected by one shutdown thread with
+ * sigtimedwait(), which also enforces the run timeout. The stop is thus
+ * requested from a normal thread, where printing and locking the queues
+ * to wake their waiters is safe.
+ *
+ * Workers sleep with shutdown_sleep_ns(), a CLOCK_MONOTONIC timed wait on
+ * the stop condition variable, so they leave their sleep as soon as the
+ * stop is requested instead of polling the flag once per second.
+ *
+ * With a drain limit the timeout (or first interrupt) only starts a drain
+ * phase: producers stop, consumers keep reading without sleeping, and the
+ * stop flag is set once main sees the queues empty or the drain deadline
+ * passes, so items still queued at the timeout are not lost.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "shutdown.h"
+#include "instrument.h"
+#include "config.h"
+
+// Sent by shutdown_finish() to end the shutdown thread
+#define SHUTDOWN_EXIT_SIGNAL SIGUSR1
+
+static pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond;            // Broadcast when the stop is requested
+static pthread_t shutdown_tid;
+static int shutdown_running = 0;            // Shutdown thread started
+static sigset_t shutdown_signals;           // Signals collected by the thread
+static uint64_t deadline_ns;                // CLOCK_MONOTONIC time of the timeout
+static uint64_t drain_limit = 0;            // Drain phase length (0 = no drain phase)
+static atomic_int stop_flag = 0;            // Stop requested (read by every worker)
+static atomic_int draining = 0;             // Drain phase started
+static uint64_t drain_start_ns;
+static uint64_t drain_end_ns;
+static int drain_deadline_hit = 0;
+static ShutdownWakeFn wake_fn = NULL;
+static void *wake_fn_arg = NULL;
+
+/*
+ * Current CLOCK_MONOTONIC time in ns (the clock stop_cond waits on)
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Convert ns to a timespec
+ */
+static struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    return ts;
+}
+
+/*
+ * End the run: stop at once, or start the drain phase when one is set up
+ */
+static void shutdown_begin(const char *reason) {
+    if (drain_limit == 0) {
+        shutdown_request(reason);
+        return;
+    }
+    
+    // Announce first, the drain may be over before this thread runs again
+    printf("\n%s, stopping producers and draining the queue...\n", reason);
+    fflush(stdout);
+    
+    pthread_mutex_lock(&stop_mutex);
+    drain_start_ns = monotonic_ns();
+    atomic_store_explicit(&draining, 1, memory_order_release);
+    pthread_cond_broadcast(&stop_cond);
+    pthread_mutex_unlock(&stop_mutex);
+}
+
+/*
+ * Shutdown thread: wait for a signal or the deadline, whichever is first
+ * (the run timeout, then the drain deadline while draining)
+ * An interrupt during the drain stops at once; after the stop only a
+ * further interrupt (exit at once) or SHUTDOWN_EXIT_SIGNAL (thread done)
+ * is expected
+ */
+static void* shutdown_thread(void *arg) {
+    (void)arg;
+    
+    for (;;) {
+        int sig;
+    
+        if (!shutdown_requested()) {
+            uint64_t deadline = shutdown_draining() ? drain_start_ns + drain_limit : deadline_ns;
+            uint64_t now = monotonic_ns();
+            if (now >= deadline) {
+                if (shutdown_draining()) {
+                    drain_deadline_hit = 1;
+                    shutdown_request("[DRAIN] Drain deadline reached");
+                } else {
+                    shutdown_begin("[TIMEOUT] Timeout reached");
+                }
+                continue;
+            }
+            struct timespec remaining = ns_to_timespec(deadline - now);
+            sig = sigtimedwait(&shutdown_signals, NULL, &remaining);
+        } else {
+            sig = sigwaitinfo(&shutdown_signals, NULL);
+        }
+    
+        // EAGAIN: deadline reached (handled on the next pass), EINTR: retry
+        if (sig < 0) {
+            continue;
+        }
+    
+        if (sig == SHUTDOWN_EXIT_SIGNAL) {
+            break;
+        }
+    
+        const char *name = sig == SIGINT ? "SIGINT" : "SIGTERM";
+        if (shutdown_requested()) {
+            // Interrupted again while stopping: give up on the clean shutdown
+            fprintf(stderr, "\n[SIGNAL] %s received again, exiting immediately\n", name);
+            _exit(EXIT_FAILURE);
+        }
+    
+        char reason[64];
+        snprintf(reason, sizeof(reason), "[SIGNAL] %s received", name);
+        if (shutdown_draining()) {
+            shutdown_request(reason);
+        } else {
+            shutdown_begin(reason);
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+ * Block the shutdown signals and start the shutdown thread
+ * Must run before any other thread is created so they inherit the mask;
+ * drain_limit_ns > 0 enables the drain phase (bounded by that time) and
+ * wake is called once when the stop is requested
+ * Returns 0 on success, -1 on error
+ */
+int shutdown_init(int timeout_seconds, uint64_t drain_limit_ns,
+                  ShutdownWakeFn wake, void *wake_arg) {
+    wake_fn = wake;
+    wake_fn_arg = wake_arg;
+    drain_limit = drain_limit_ns;
+    deadline_ns = monotonic_ns() + (uint64_t)timeout_seconds * 1000000000ULL;
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int rc = pthread_cond_init(&stop_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Failed to initialize stop condition variable\n");
+        return -1;
+    }
+    
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    sigaddset(&shutdown_signals, SHUTDOWN_EXIT_SIGNAL);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL);
+    
+    if (pthread_create(&shutdown_tid, NULL, shutdown_thread, NULL) != 0) {
+        fprintf(stderr, "Error: Failed to create shutdown thread\n");
+        pthread_sigmask(SIG_UNBLOCK, &shutdown_signals, NULL);
+        pthread_cond_destroy(&stop_cond);
+        return -1;
+    }
+    shutdown_running = 1;
+    
+    if (DEBUG_MODE) {
+        printf("[SHUTDOWN] Shutdown thread started, timeout in %d second(s)\n", timeout_seconds);
+    }
+    
+    return 0;
+}
+
+/*
+ * Set the stop flag, wake sleeping workers and threads blocked in queues
+ * Only the first request prints reason (if not NULL) and wakes the queues
+ * Not async-signal-safe: call from a thread, never from a signal handler
+ */
+void shutdown_request(const char *reason) {
+    pthread_mutex_lock(&stop_mutex);
+    int first = !shutdown_requested();
+    if (first && shutdown_draining()) {
+        drain_end_ns = monotonic_ns();
+    }
+    atomic_store_explicit(&stop_flag, 1, memory_order_release);
+    pthread_cond_broadcast(&stop_cond);
+    pthread_mutex_unlock(&stop_mutex);
+    
+    if (!first) {
+        return;
+    }
+    
+    if (reason != NULL) {
+        printf("\n%s, signaling all threads to terminate...\n", reason);
+        fflush(stdout);
+    }
+    
+    if (wake_fn != NULL) {
+        wake_fn(wake_fn_arg);
+    }
+}
+
+/*
+ * Non-zero once the stop has been requested
+ */
+int shutdown_requested(void) {
+    return atomic_load_explicit(&stop_flag, memory_order_acquire);
+}
+
+/*
+ * Non-zero once the drain phase has started (producers must stop and
+ * consumers read without sleeping); stays set after the final stop
+ */
+int shutdown_draining(void) {
+    return atomic_load_explicit(&draining, memory_order_acquire);
+}
+
+/*
+ * Sleep for ns, returning early when the stop or the drain is requested
+ * Returns non-zero if either has been requested
+ */
+int shutdown_sleep_ns(uint64_t ns) {
+    INSTRUMENT_BEGIN(sleep_start);
+    struct timespec deadline = ns_to_timespec(monotonic_ns() + ns);
+    
+    pthread_mutex_lock(&stop_mutex);
+    while (!shutdown_requested() && !shutdown_draining()) {
+        if (pthread_cond_timedwait(&stop_cond, &stop_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int stopped = shutdown_requested() || shutdown_draining();
+    pthread_mutex_unlock(&stop_mutex);
+    INSTRUMENT_END(INSTRUMENT_SLEEP, sleep_start, 0);
+    
+    return stopped;
+}
+
+/*
+ * Drain phase, called once every producer has exited: wait until
+ * is_empty() reports the queues empty, then request the stop
+ * Returns at once unless a drain is in progress; the drain deadline or an
+ * interrupt also end the wait (the shutdown thread sets the stop)
+ */
+void shutdown_drain_wait(ShutdownEmptyFn is_empty, void *arg) {
+    // Queue emptiness has no wake-up of its own, so check it every 100 us
+    const uint64_t poll_ns = 100000;
+    
+    pthread_mutex_lock(&stop_mutex);
+    while (shutdown_draining() && !shutdown_requested() && !is_empty(arg)) {
+        struct timespec next = ns_to_timespec(monotonic_ns() + poll_ns);
+        pthread_cond_timedwait(&stop_cond, &stop_mutex, &next);
+    }
+    int drained = shutdown_draining() && !shutdown_requested();
+    pthread_mutex_unlock(&stop_mutex);
+    
+    if (drained) {
+        shutdown_request("[DRAIN] Queue drained");
+    }
+}
+
+/*
+ * Report how the drain phase went (valid after the stop)
+ */
+void shutdown_drain_stats(ShutdownDrainStats *stats) {
+    pthread_mutex_lock(&stop_mutex);
+    stats->drained = shutdown_draining();
+    stats->deadline_hit = drain_deadline_hit;
+    stats->drain_ns = stats->drained && drain_end_ns > drain_start_ns ? drain_end_ns - drain_start_ns : 0;
+    pthread_mutex_unlock(&stop_mutex);
+}
+
+/*
+ * Request the stop if nobody has yet, then end and join the shutdown thread
+ */
+void shutdown_finish(void) {
+    if (!shutdown_running) {
+        return;
+    }
+    
+    shutdown_request(NULL);
+    pthread_kill(shutdown_tid, SHUTDOWN_EXIT_SIGNAL);
+    pthread_join(shutdown_tid, NULL);
+    shutdown_running = 0;
+    
+    pthread_cond_destroy(&stop_cond);
+}
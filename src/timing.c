@@ -0,0 +1,207 @@
+/*
+ * Timing Implementation
+ * 
+ * All item timestamps and latencies are integer nanoseconds from a clock
+ * that never jumps. The default source is CLOCK_MONOTONIC. When requested
+ * and the hardware counter is usable (invariant TSC on x86-64, the generic
+ * timer on AArch64), timing_now_ns() instead scales the raw counter by a
+ * multiplier calibrated once against CLOCK_MONOTONIC at startup.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "timing.h"
+#include "instrument.h"
+#include "config.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+// Calibration window used to measure the counter frequency
+#define TIMING_CALIBRATION_NS 20000000ULL
+
+// Selected clock; only written by timing_init before threads start
+static TimingSource active_source = TIMING_SOURCE_MONOTONIC;
+
+// Counter to nanosecond conversion: ns = base_ns + ((ticks - base_ticks) * mult) >> 32
+static uint64_t base_ticks = 0;
+static uint64_t base_ns = 0;
+static uint64_t ticks_mult = 0;
+
+/*
+ * Read CLOCK_MONOTONIC in nanoseconds
+ */
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Read the raw hardware counter (0 if there is none)
+ */
+static inline uint64_t read_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(ticks) : : "memory");
+    return ticks;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Check that the hardware counter ticks at a constant rate on all cores
+ */
+static int ticks_usable(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    // CPUID 0x80000007 EDX bit 8: invariant TSC
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Measure the counter against CLOCK_MONOTONIC and derive the multiplier
+ * Returns 0 on success, -1 if the counter cannot be calibrated
+ */
+static int calibrate_ticks(void) {
+    uint64_t ns_start = monotonic_ns();
+    uint64_t ticks_start = read_ticks();
+    
+    struct timespec pause = { 0, (long)TIMING_CALIBRATION_NS };
+    nanosleep(&pause, NULL);
+    
+    uint64_t ns_end = monotonic_ns();
+    uint64_t ticks_end = read_ticks();
+    
+    if (ticks_end <= ticks_start || ns_end <= ns_start) {
+        return -1;
+    }
+    
+    // Nanoseconds per tick in 32.32 fixed point
+    ticks_mult = (uint64_t)(((unsigned __int128)(ns_end - ns_start) << 32) / (ticks_end - ticks_start));
+    base_ticks = ticks_end;
+    base_ns = ns_end;
+    
+    if (DEBUG_MODE) {
+        printf("[TIMING] Counter calibrated: %.3f MHz\n",
+               (double)(ticks_end - ticks_start) * 1e3 / (double)(ns_end - ns_start));
+    }
+    
+    return ticks_mult > 0 ? 0 : -1;
+}
+
+/*
+ * Select the clock source; call once at startup before threads start
+ * Falls back to CLOCK_MONOTONIC when the counter is unusable
+ * Returns 0 if the requested source is active, -1 after a fallback
+ */
+int timing_init(TimingSource source) {
+    active_source = TIMING_SOURCE_MONOTONIC;
+    
+    if (source == TIMING_SOURCE_TSC) {
+        if (!ticks_usable() || calibrate_ticks() != 0) {
+            fprintf(stderr, "Warning: Cycle counter unusable, using CLOCK_MONOTONIC\n");
+            return -1;
+        }
+        active_source = TIMING_SOURCE_TSC;
+    }
+    
+    return 0;
+}
+
+/*
+ * Current time in nanoseconds on a monotonic timeline
+ */
+uint64_t timing_now_ns(void) {
+    if (active_source == TIMING_SOURCE_TSC) {
+        uint64_t delta = read_ticks() - base_ticks;
+        return base_ns + (uint64_t)(((unsigned __int128)delta * ticks_mult) >> 32);
+    }
+    
+    return monotonic_ns();
+}
+
+/*
+ * Pause the calling thread for ns nanoseconds
+ * spin != 0 busy-waits on timing_now_ns() (sub-microsecond accuracy, burns
+ * the core); otherwise the thread sleeps in clock_nanosleep.
+ */
+void timing_pause_ns(uint64_t ns, int spin) {
+    if (ns == 0) {
+        return;
+    }
+    
+    if (spin) {
+        uint64_t deadline = timing_now_ns() + ns;
+        while (timing_now_ns() < deadline) {
+            cpu_relax();
+        }
+        return;
+    }
+    
+    INSTRUMENT_BEGIN(sleep_start);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t deadline = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec + ns;
+    ts.tv_sec = (time_t)(deadline / 1000000000ULL);
+    ts.tv_nsec = (long)(deadline % 1000000000ULL);
+    
+    // Absolute deadline, so an interrupted sleep resumes without drifting
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+    INSTRUMENT_END(INSTRUMENT_SLEEP, sleep_start, 0);
+}
+
+/*
+ * Clock source in use
+ */
+TimingSource timing_source(void) {
+    return active_source;
+}
+
+/*
+ * Get the printable name of a clock source
+ */
+const char* timing_source_name(TimingSource source) {
+    switch (source) {
+        case TIMING_SOURCE_MONOTONIC: return "monotonic";
+        case TIMING_SOURCE_TSC:       return "tsc";
+    }
+    return "unknown";
+}
+
+/*
+ * Parse a clock source name ("monotonic" or "tsc")
+ * Returns 0 on success, -1 if the name is not recognized
+ */
+int timing_source_from_name(const char *name, TimingSource *source) {
+    if (name == NULL || source == NULL) {
+        return -1;
+    }
+    
+    if (strcmp(name, "monotonic") == 0) {
+        *source = TIMING_SOURCE_MONOTONIC;
+    } else if (strcmp(name, "tsc") == 0) {
+        *source = TIMING_SOURCE_TSC;
+    } else {
+        return -1;
+    }
+    
+    return 0;
+}
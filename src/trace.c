@@ -0,0 +1,217 @@
+/*
+ * Trace Implementation
+ *
+ * Each traced thread owns one file, mapped in full and extended by
+ * TRACE_CHUNK_BYTES (ftruncate + mremap) when it fills up, so recording an
+ * event is a 24-byte store into the page cache: no lock, no system call
+ * and no formatting on the hot path. The record count in the header is
+ * brought up to date at every growth and on close, so the file of a
+ * process that died keeps everything up to its last full chunk.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "timing.h"
+#include "config.h"
+
+// Files and records of every writer closed so far (for the run summary)
+static atomic_ulong closed_files;
+static atomic_ulong closed_records;
+
+static void header_sync(TraceWriter *w) {
+    ((TraceFileHeader *)w->map)->records = w->count;
+}
+
+/*
+ * Create the trace directory unless it already exists
+ * Returns 0 on success, -1 on error
+ */
+int trace_prepare_dir(const char *dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create trace directory '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Create <dir>/producer-<id>.trace or <dir>/consumer-<id>.trace and map
+ * its first chunk
+ * Returns NULL on error (the thread then runs untraced)
+ */
+TraceWriter* trace_open(const char *dir, TraceRole role, int thread_id) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s-%d.trace", dir,
+             role == TRACE_ROLE_PRODUCER ? "producer" : "consumer", thread_id);
+    
+    TraceWriter *w = (TraceWriter *)calloc(1, sizeof(TraceWriter));
+    if (w == NULL) {
+        fprintf(stderr, "Error: Failed to allocate trace writer\n");
+        return NULL;
+    }
+    
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        fprintf(stderr, "Error: Cannot create trace file '%s': %s\n", path, strerror(errno));
+        free(w);
+        return NULL;
+    }
+    
+    w->map_bytes = TRACE_CHUNK_BYTES;
+    if (ftruncate(w->fd, (off_t)w->map_bytes) != 0 ||
+        (w->map = (unsigned char *)mmap(NULL, w->map_bytes, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED, w->fd, 0)) == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map trace file '%s': %s\n", path, strerror(errno));
+        close(w->fd);
+        unlink(path);
+        free(w);
+        return NULL;
+    }
+    
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    
+    TraceFileHeader *hdr = (TraceFileHeader *)w->map;
+    memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+    hdr->version = TRACE_VERSION;
+    hdr->record_size = sizeof(TraceRecord);
+    hdr->role = role;
+    hdr->thread_id = thread_id;
+    hdr->start_ns = timing_now_ns();
+    hdr->start_unix_ns = (int64_t)wall.tv_sec * 1000000000LL + wall.tv_nsec;
+    hdr->records = 0;
+    hdr->clock_source = timing_source();
+    
+    w->records = (TraceRecord *)(w->map + sizeof(TraceFileHeader));
+    w->capacity = (w->map_bytes - sizeof(TraceFileHeader)) / sizeof(TraceRecord);
+    return w;
+}
+
+/*
+ * Extend a full file by one chunk and remap it (the mapping may move)
+ * Returns 0 on success, -1 on error (further events are dropped)
+ */
+int trace_grow(TraceWriter *w) {
+    size_t new_bytes = w->map_bytes + TRACE_CHUNK_BYTES;
+    
+    header_sync(w);
+    if (ftruncate(w->fd, (off_t)new_bytes) != 0) {
+        return -1;
+    }
+    void *map = mremap(w->map, w->map_bytes, new_bytes, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    
+    w->map = (unsigned char *)map;
+    w->map_bytes = new_bytes;
+    w->records = (TraceRecord *)(w->map + sizeof(TraceFileHeader));
+    w->capacity = (w->map_bytes - sizeof(TraceFileHeader)) / sizeof(TraceRecord);
+    return 0;
+}
+
+/*
+ * Record the final count, trim the unused tail of the last chunk and
+ * close the file
+ */
+void trace_close(TraceWriter *w) {
+    if (w == NULL) {
+        return;
+    }
+    
+    header_sync(w);
+    munmap(w->map, w->map_bytes);
+    if (ftruncate(w->fd, (off_t)(sizeof(TraceFileHeader) + w->count * sizeof(TraceRecord))) != 0) {
+        fprintf(stderr, "Error: Cannot trim trace file: %s\n", strerror(errno));
+    }
+    close(w->fd);
+    
+    atomic_fetch_add_explicit(&closed_files, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&closed_records, w->count, memory_order_relaxed);
+    free(w);
+}
+
+/*
+ * Files and records written by every writer closed so far
+ */
+void trace_totals(uint64_t *files, uint64_t *records) {
+    *files = atomic_load_explicit(&closed_files, memory_order_relaxed);
+    *records = atomic_load_explicit(&closed_records, memory_order_relaxed);
+}
+
+/*
+ * Map a trace file read-only and validate its header
+ * Returns 0 on success, -1 on error
+ */
+int trace_file_open(const char *path, TraceFile *file) {
+    memset(file, 0, sizeof(*file));
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open trace file '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceFileHeader)) {
+        fprintf(stderr, "Error: '%s' is not a trace file\n", path);
+        close(fd);
+        return -1;
+    }
+    
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map trace file '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    
+    const TraceFileHeader *hdr = (const TraceFileHeader *)map;
+    if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != TRACE_VERSION || hdr->record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "Error: '%s' is not a version %d trace file\n", path, TRACE_VERSION);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    
+    // Never trust the count beyond what the file actually holds
+    uint64_t fits = ((size_t)st.st_size - sizeof(TraceFileHeader)) / sizeof(TraceRecord);
+    file->hdr = hdr;
+    file->records = (const TraceRecord *)((const unsigned char *)map + sizeof(TraceFileHeader));
+    file->count = hdr->records < fits ? hdr->records : fits;
+    file->map_bytes = (size_t)st.st_size;
+    return 0;
+}
+
+/*
+ * Unmap a trace file opened with trace_file_open
+ */
+void trace_file_close(TraceFile *file) {
+    if (file->hdr != NULL) {
+        munmap((void *)file->hdr, file->map_bytes);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+/*
+ * Event name for reports
+ */
+const char* trace_event_name(int event) {
+    switch (event) {
+        case TRACE_EVENT_ENQUEUE: return "enqueue";
+        case TRACE_EVENT_DEQUEUE: return "dequeue";
+        case TRACE_EVENT_BLOCKED: return "blocked";
+        case TRACE_EVENT_STARVED: return "starved";
+        default:                  return "unknown";
+    }
+}
@@ -13,38 +13,51 @@
 #include <pwd.h>
 #include <limits.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "utils.h"
 #include "config.h"
 
-// Static flag to ensure random seed is initialized only once
-static int random_initialized = 0;
+// Generator behind random_range(): one per thread, seeded on first use
+static __thread RandomState thread_rng;
+static __thread int thread_rng_seeded = 0;
+
+// Distinguishes threads that seed within the same microsecond
+static atomic_uint seed_counter = 0;
 
 /*
- * Initialize random number generator with current time
+ * Seed this thread's generator from the clock, the PID and a counter
  * Called automatically by random_range if not already initialized
  */
 static void init_random(void) {
-    if (!random_initialized) {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        srand((unsigned int)(tv.tv_sec * 1000000 + tv.tv_usec + getpid()));
-        random_initialized = 1;
-        
-        if (DEBUG_MODE) {
-            printf("[UTILS] Random number generator initialized\n");
-        }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint64_t seed = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+    seed ^= (uint64_t)getpid() << 32;
+    seed += (uint64_t)atomic_fetch_add(&seed_counter, 1) * 0x9E3779B97F4A7C15ULL;
+    random_state_seed(&thread_rng, seed);
+    thread_rng_seeded = 1;
+    
+    if (DEBUG_MODE) {
+        printf("[UTILS] Random number generator initialized\n");
     }
 }
 
 /*
  * Generate a random integer in range [min, max] inclusive
- * Uses global random seed
+ * Uses the calling thread's generator (seeded on first use)
  */
 int random_range(int min, int max) {
-    if (!random_initialized) {
+    if (!thread_rng_seeded) {
         init_random();
     }
-    
+    return random_state_range(&thread_rng, min, max);
+}
+
+/*
+ * Generate a random integer using a provided seed (thread-safe)
+ * Useful for per-thread random generation without interference
+ */
+int random_range_seed(int min, int max, unsigned int *seed) {
     if (min > max) {
         int temp = min;
         min = max;
@@ -55,18 +68,75 @@ int random_range(int min, int max) {
         return min;
     }
     
-    // Generate random number in range
-    int range = max - min + 1;
-    int random_val = (rand() % range) + min;
+    // Reject the top partial block of rand_r() outputs so every value in
+    // the range is equally likely (plain % favours the low values)
+    unsigned int range = (unsigned int)(max - min) + 1;
+    unsigned int limit = ((unsigned int)RAND_MAX + 1u) / range * range;
+    unsigned int r;
+    do {
+        r = (unsigned int)rand_r(seed);
+    } while (r >= limit);
     
-    return random_val;
+    return min + (int)(r % range);
 }
 
 /*
- * Generate a random integer using a provided seed (thread-safe)
- * Useful for per-thread random generation without interference
+ * Seed a generator: splitmix64 expands the seed into the four state words
+ * (never all zero)
  */
-int random_range_seed(int min, int max, unsigned int *seed) {
+void random_state_seed(RandomState *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/*
+ * Next 64 random bits (xoshiro256**)
+ */
+uint64_t random_next(RandomState *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    
+    return result;
+}
+
+/*
+ * Unbiased value below range (Lemire's multiply-shift with rejection:
+ * one multiply per value, a division only in the rare rejection case)
+ */
+static inline uint32_t bounded_next(RandomState *rng, uint32_t range) {
+    uint64_t m = (random_next(rng) >> 32) * (uint64_t)range;
+    uint32_t low = (uint32_t)m;
+    
+    if (low < range) {
+        uint32_t threshold = (uint32_t)(-range) % range;
+        while (low < threshold) {
+            m = (random_next(rng) >> 32) * (uint64_t)range;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+/*
+ * Generate a random integer in range [min, max] inclusive from rng
+ */
+int random_state_range(RandomState *rng, int min, int max) {
     if (min > max) {
         int temp = min;
         min = max;
@@ -77,11 +147,36 @@ int random_range_seed(int min, int max, unsigned int *seed) {
         return min;
     }
     
-    // Generate random number in range using thread-local seed
-    int range = max - min + 1;
-    int random_val = (rand_r(seed) % range) + min;
+    uint32_t range = (uint32_t)((int64_t)max - min) + 1;
+    if (range == 0) {
+        // Full 32-bit span
+        return (int)(uint32_t)(random_next(rng) >> 32);
+    }
+    return (int)((int64_t)min + bounded_next(rng, range));
+}
+
+/*
+ * Fill values[0..n) with random integers in [min, max] inclusive
+ * The bound is computed once for the whole batch
+ */
+void random_fill_range(RandomState *rng, int *values, int n, int min, int max) {
+    if (min > max) {
+        int temp = min;
+        min = max;
+        max = temp;
+    }
     
-    return random_val;
+    uint32_t range = (uint32_t)((int64_t)max - min) + 1;
+    if (min == max || range == 0) {
+        for (int i = 0; i < n; i++) {
+            values[i] = min == max ? min : (int)(uint32_t)(random_next(rng) >> 32);
+        }
+        return;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        values[i] = (int)((int64_t)min + bounded_next(rng, range));
+    }
 }
 
 /*
@@ -196,4 +291,19 @@ void format_time_hms(double seconds, char *buffer, size_t buffer_size) {
     } else {
         snprintf(buffer, buffer_size, "%d.%03d sec", secs, millis);
     }
-}
\ No newline at end of file
+}
+
+/*
+ * Format a nanosecond duration with a readable unit (ns, us, ms or s)
+ */
+void format_duration_ns(uint64_t ns, char *buffer, size_t buffer_size) {
+    if (ns < 1000ULL) {
+        snprintf(buffer, buffer_size, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000ULL) {
+        snprintf(buffer, buffer_size, "%.2fus", ns / 1e3);
+    } else if (ns < 1000000000ULL) {
+        snprintf(buffer, buffer_size, "%.2fms", ns / 1e6);
+    } else {
+        snprintf(buffer, buffer_size, "%.3fs", ns / 1e9);
+    }
+}
@@ -0,0 +1,509 @@
+/*
+ * Workload Implementation
+ *
+ * A workload spec says what producers generate and when: the priority mix
+ * of the values, the arrival process and the rate of every producer. It is
+ * given with -L as comma-separated key=value settings, or as @file with one
+ * setting per line (# starts a comment):
+ *
+ *   arrival=poisson,rate=20k,priority=1:2:7,mode=open
+ *
+ * Scheduled arrivals (constant, poisson, bursty) are computed on an
+ * absolute timeline in nanoseconds, so rounding errors of single gaps do
+ * not add up and rates well above 1000 items/s per producer are exact.
+ * In open-loop mode the schedule is kept whatever the queue does: a
+ * producer that was blocked catches up at once, and every item carries
+ * its scheduled time, so latency includes the time the item spent waiting
+ * to be produced (no coordinated omission). In closed-loop mode the rate
+ * is only a limit: a producer that falls behind restarts its schedule
+ * from now.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include "workload.h"
+#include "config.h"
+
+// First value of each priority band of the default mapping
+#define BAND_HIGH_MIN 7
+#define BAND_NORMAL_MIN 4
+
+/*
+ * Reset spec to the built-in workload: uniform values 0-9 and random
+ * sleeps between writes
+ */
+void workload_spec_default(WorkloadSpec *spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->arrival = WORKLOAD_ARRIVAL_SLEEP;
+    spec->burst = WORKLOAD_DEFAULT_BURST;
+    spec->spin_ns = WORKLOAD_SPIN_NS;
+    spec->weights[0] = RANDOM_VALUE_MAX - BAND_HIGH_MIN + 1;
+    spec->weights[1] = BAND_HIGH_MIN - BAND_NORMAL_MIN;
+    spec->weights[2] = BAND_NORMAL_MIN - RANDOM_VALUE_MIN;
+}
+
+/*
+ * Strip leading and trailing white space in place
+ */
+static char* trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+/*
+ * Parse a rate in items per second: a decimal number with an optional
+ * k (thousand) or M (million) suffix
+ * Returns 0 on success, -1 on error
+ */
+static int parse_rate(const char *text, double *rate) {
+    char *end;
+    errno = 0;
+    double r = strtod(text, &end);
+    if (end == text || errno != 0) {
+        return -1;
+    }
+    if (*end == 'k' || *end == 'K') {
+        r *= 1e3;
+        end++;
+    } else if (*end == 'M') {
+        r *= 1e6;
+        end++;
+    }
+    if (*end != '\0' || !(r > 0) || r > 1e9) {
+        return -1;
+    }
+    
+    *rate = r;
+    return 0;
+}
+
+/*
+ * Parse a non-negative integer
+ * Returns 0 on success, -1 on error
+ */
+static int parse_count(const char *text, long max, long *value) {
+    char *end;
+    errno = 0;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || v < 0 || v > max) {
+        return -1;
+    }
+    
+    *value = v;
+    return 0;
+}
+
+/*
+ * Apply one key=value setting
+ * Returns 0 on success, -1 on error
+ */
+static int apply_setting(WorkloadSpec *spec, char *setting) {
+    char *eq = strchr(setting, '=');
+    if (eq == NULL) {
+        fprintf(stderr, "Error: workload setting '%s' is not key=value\n", setting);
+        return -1;
+    }
+    *eq = '\0';
+    char *key = trim(setting);
+    char *value = trim(eq + 1);
+    long n;
+    
+    if (strcmp(key, "arrival") == 0) {
+        if (strcmp(value, "sleep") == 0) {
+            spec->arrival = WORKLOAD_ARRIVAL_SLEEP;
+        } else if (strcmp(value, "constant") == 0) {
+            spec->arrival = WORKLOAD_ARRIVAL_CONSTANT;
+        } else if (strcmp(value, "poisson") == 0) {
+            spec->arrival = WORKLOAD_ARRIVAL_POISSON;
+        } else if (strcmp(value, "bursty") == 0) {
+            spec->arrival = WORKLOAD_ARRIVAL_BURSTY;
+        } else {
+            fprintf(stderr, "Error: unknown arrival '%s' (sleep, constant, poisson or bursty)\n",
+                    value);
+            return -1;
+        }
+    } else if (strcmp(key, "rate") == 0) {
+        if (parse_rate(value, &spec->rate) != 0) {
+            fprintf(stderr, "Error: invalid rate '%s' (items/s per producer, e.g. 500, 2.5k, 1M)\n",
+                    value);
+            return -1;
+        }
+    } else if (strncmp(key, "rate.", 5) == 0) {
+        WorkloadRate override;
+        if (parse_count(key + 5, MAX_PRODUCERS, &n) != 0 || n < 1 ||
+            parse_rate(value, &override.rate) != 0) {
+            fprintf(stderr, "Error: invalid producer rate '%s=%s' (rate.<id>=<items/s>)\n",
+                    key, value);
+            return -1;
+        }
+        override.producer_id = (int)n;
+    
+        // A later setting for the same producer replaces the earlier one
+        int i = 0;
+        while (i < spec->n_overrides && spec->overrides[i].producer_id != override.producer_id) {
+            i++;
+        }
+        if (i == WORKLOAD_MAX_OVERRIDES) {
+            fprintf(stderr, "Error: at most %d producer rates can be given\n",
+                    WORKLOAD_MAX_OVERRIDES);
+            return -1;
+        }
+        spec->overrides[i] = override;
+        if (i == spec->n_overrides) {
+            spec->n_overrides++;
+        }
+    } else if (strcmp(key, "burst") == 0) {
+        if (parse_count(value, 1000000, &n) != 0 || n < 1) {
+            fprintf(stderr, "Error: burst must be between 1 and 1000000 items\n");
+            return -1;
+        }
+        spec->burst = (int)n;
+    } else if (strcmp(key, "priority") == 0) {
+        int weights[3];
+        char tail;
+        if (sscanf(value, "%d:%d:%d%c", &weights[0], &weights[1], &weights[2], &tail) != 3 ||
+            weights[0] < 0 || weights[1] < 0 || weights[2] < 0 ||
+            weights[0] + weights[1] + weights[2] <= 0 ||
+            weights[0] > 1000000 || weights[1] > 1000000 || weights[2] > 1000000) {
+            fprintf(stderr, "Error: priority mix must be <high>:<normal>:<low> weights, "
+                    "e.g. 1:2:7\n");
+            return -1;
+        }
+        memcpy(spec->weights, weights, sizeof(weights));
+        spec->custom_mix = 1;
+    } else if (strcmp(key, "mode") == 0) {
+        if (strcmp(value, "open") == 0) {
+            spec->open_loop = 1;
+        } else if (strcmp(value, "closed") == 0) {
+            spec->open_loop = 0;
+        } else {
+            fprintf(stderr, "Error: mode must be open or closed\n");
+            return -1;
+        }
+    } else if (strcmp(key, "spin") == 0) {
+        if (parse_count(value, 1000000, &n) != 0) {
+            fprintf(stderr, "Error: spin must be between 0 and 1000000 us\n");
+            return -1;
+        }
+        spec->spin_ns = (uint64_t)n * 1000;
+    } else {
+        fprintf(stderr, "Error: unknown workload setting '%s' "
+                "(arrival, rate, rate.<id>, burst, priority, mode, spin)\n", key);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Fill the value table: each band gets its share of the entries by
+ * weight (largest remainder, so the shares add up to the table size) and
+ * spreads it evenly over its values
+ */
+static void build_value_table(WorkloadSpec *spec) {
+    static const int band_min[3] = { BAND_HIGH_MIN, BAND_NORMAL_MIN, RANDOM_VALUE_MIN };
+    static const int band_max[3] = { RANDOM_VALUE_MAX, BAND_HIGH_MIN - 1, BAND_NORMAL_MIN - 1 };
+    long total = (long)spec->weights[0] + spec->weights[1] + spec->weights[2];
+    int share[3];
+    long remainder[3];
+    int assigned = 0;
+    
+    for (int b = 0; b < 3; b++) {
+        long scaled = (long)WORKLOAD_VALUE_TABLE_SIZE * spec->weights[b];
+        share[b] = (int)(scaled / total);
+        remainder[b] = scaled % total;
+        assigned += share[b];
+    }
+    while (assigned < WORKLOAD_VALUE_TABLE_SIZE) {
+        int best = 0;
+        for (int b = 1; b < 3; b++) {
+            if (remainder[b] > remainder[best]) {
+                best = b;
+            }
+        }
+        share[best]++;
+        remainder[best] = -1;
+        assigned++;
+    }
+    
+    int next = 0;
+    for (int b = 0; b < 3; b++) {
+        int n_values = band_max[b] - band_min[b] + 1;
+        for (int i = 0; i < share[b]; i++) {
+            spec->value_table[next++] = (uint8_t)(band_min[b] + i % n_values);
+        }
+    }
+}
+
+/*
+ * Check a parsed spec and prepare its value table
+ * Returns 0 on success, -1 on error
+ */
+static int finish_spec(WorkloadSpec *spec) {
+    if (!workload_scheduled(spec) && (spec->rate > 0 || spec->n_overrides > 0 || spec->open_loop)) {
+        fprintf(stderr, "Error: rates and open-loop mode need arrival=constant, poisson or bursty\n");
+        return -1;
+    }
+    if (workload_scheduled(spec) && spec->rate <= 0) {
+        fprintf(stderr, "Error: arrival=%s needs a rate (items/s per producer)\n",
+                workload_arrival_name(spec->arrival));
+        return -1;
+    }
+    if (spec->custom_mix) {
+        build_value_table(spec);
+    }
+    return 0;
+}
+
+/*
+ * Apply every setting of buffer (settings separated by commas or new
+ * lines; # comments out the rest of a line), modifying buffer
+ * Returns 0 on success, -1 on error
+ */
+static int apply_settings(WorkloadSpec *spec, char *buffer) {
+    // Cut the comments first, they may contain commas
+    for (char *p = buffer; (p = strchr(p, '#')) != NULL; ) {
+        char *eol = strchr(p, '\n');
+        if (eol == NULL) {
+            *p = '\0';
+            break;
+        }
+        memset(p, ' ', (size_t)(eol - p));
+        p = eol;
+    }
+    
+    char *save = NULL;
+    for (char *token = strtok_r(buffer, ",\n", &save); token != NULL;
+         token = strtok_r(NULL, ",\n", &save)) {
+        char *setting = trim(token);
+        if (*setting != '\0' && apply_setting(spec, setting) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Parse a -L argument into spec (which holds the defaults or earlier
+ * settings): key=value,... or @file
+ * Returns 0 on success, -1 on error
+ */
+int workload_spec_parse(WorkloadSpec *spec, const char *text) {
+    if (text[0] == '@') {
+        return workload_spec_load(spec, text + 1);
+    }
+    
+    char *buffer = strdup(text);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: Failed to allocate workload spec\n");
+        return -1;
+    }
+    int rc = apply_settings(spec, buffer);
+    free(buffer);
+    
+    return rc == 0 ? finish_spec(spec) : -1;
+}
+
+/*
+ * Read a workload file (one setting per line) into spec
+ * Returns 0 on success, -1 on error
+ */
+int workload_spec_load(WorkloadSpec *spec, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Error: Cannot open workload file '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    
+    char *buffer = (char *)malloc(WORKLOAD_MAX_FILE_BYTES + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: Failed to allocate workload spec\n");
+        fclose(f);
+        return -1;
+    }
+    size_t len = fread(buffer, 1, WORKLOAD_MAX_FILE_BYTES + 1, f);
+    int failed = ferror(f);
+    fclose(f);
+    if (failed || len > WORKLOAD_MAX_FILE_BYTES) {
+        fprintf(stderr, "Error: Cannot read workload file '%s'%s\n", path,
+                failed ? "" : " (too large)");
+        free(buffer);
+        return -1;
+    }
+    buffer[len] = '\0';
+    
+    int rc = apply_settings(spec, buffer);
+    free(buffer);
+    
+    return rc == 0 ? finish_spec(spec) : -1;
+}
+
+/*
+ * Non-zero if producers follow an arrival schedule instead of sleeping
+ */
+int workload_scheduled(const WorkloadSpec *spec) {
+    return spec != NULL && spec->arrival != WORKLOAD_ARRIVAL_SLEEP;
+}
+
+/*
+ * Arrival rate of one producer (items per second)
+ */
+double workload_rate_for(const WorkloadSpec *spec, int producer_id) {
+    for (int i = 0; i < spec->n_overrides; i++) {
+        if (spec->overrides[i].producer_id == producer_id) {
+            return spec->overrides[i].rate;
+        }
+    }
+    return spec->rate;
+}
+
+/*
+ * Fill values[0..n) with the data values of the next n items
+ */
+void workload_fill_values(const WorkloadSpec *spec, RandomState *rng, int *values, int n) {
+    if (spec == NULL || !spec->custom_mix) {
+        random_fill_range(rng, values, n, RANDOM_VALUE_MIN, RANDOM_VALUE_MAX);
+        return;
+    }
+    
+    // Top bits of each draw index the table (its size is a power of two)
+    int shift = 64 - __builtin_ctz(WORKLOAD_VALUE_TABLE_SIZE);
+    for (int i = 0; i < n; i++) {
+        values[i] = spec->value_table[random_next(rng) >> shift];
+    }
+}
+
+/*
+ * Priority of an item with the given value
+ * High values (7-9) get high priority, medium values (4-6) normal
+ * priority and low values (0-3) low priority
+ */
+int workload_priority_of(int value) {
+    if (value >= BAND_HIGH_MIN) {
+        return PRIORITY_HIGH;
+    } else if (value >= BAND_NORMAL_MIN) {
+        return PRIORITY_NORMAL;
+    }
+    return PRIORITY_LOW;
+}
+
+/*
+ * One-line description of spec for the run configuration
+ */
+void workload_describe(const WorkloadSpec *spec, char *buffer, size_t size) {
+    int len;
+    if (workload_scheduled(spec)) {
+        len = snprintf(buffer, size, "%s, %.0f items/s per producer",
+                       workload_arrival_name(spec->arrival), spec->rate);
+        if (spec->arrival == WORKLOAD_ARRIVAL_BURSTY && len >= 0 && (size_t)len < size) {
+            len += snprintf(buffer + len, size - (size_t)len, " in bursts of %d", spec->burst);
+        }
+        if (spec->n_overrides > 0 && len >= 0 && (size_t)len < size) {
+            len += snprintf(buffer + len, size - (size_t)len, " (%d override(s))",
+                            spec->n_overrides);
+        }
+        if (len >= 0 && (size_t)len < size) {
+            len += snprintf(buffer + len, size - (size_t)len, ", %s loop",
+                            spec->open_loop ? "open" : "closed");
+        }
+    } else {
+        len = snprintf(buffer, size, "sleep (random 1-%d s between writes)",
+                       DEFAULT_MAX_PRODUCER_WAIT);
+    }
+    if (spec->custom_mix && len >= 0 && (size_t)len < size) {
+        snprintf(buffer + len, size - (size_t)len, ", priority mix %d:%d:%d",
+                 spec->weights[0], spec->weights[1], spec->weights[2]);
+    }
+}
+
+/*
+ * Arrival process name
+ */
+const char* workload_arrival_name(WorkloadArrival arrival) {
+    switch (arrival) {
+        case WORKLOAD_ARRIVAL_SLEEP:    return "sleep";
+        case WORKLOAD_ARRIVAL_CONSTANT: return "constant";
+        case WORKLOAD_ARRIVAL_POISSON:  return "poisson";
+        case WORKLOAD_ARRIVAL_BURSTY:   return "bursty";
+        default:                        return "unknown";
+    }
+}
+
+/*
+ * Exponentially distributed gap with the given mean (ns)
+ * U is drawn from (0, 1] with 53 random bits, so log(U) is finite
+ */
+static double exponential_ns(RandomState *rng, double mean_ns) {
+    double u = (double)((random_next(rng) >> 11) + 1) * 0x1.0p-53;
+    return -log(u) * mean_ns;
+}
+
+/*
+ * Start the schedule of one producer at start_ns
+ * Constant arrivals get a random phase so producers do not write in step
+ */
+void workload_gen_init(WorkloadGen *gen, const WorkloadSpec *spec, int producer_id,
+                       RandomState *rng, uint64_t start_ns) {
+    gen->spec = spec;
+    gen->rate = workload_rate_for(spec, producer_id);
+    gen->next_ns = (double)start_ns;
+    gen->burst_left = 0;
+    
+    if (spec->arrival == WORKLOAD_ARRIVAL_CONSTANT) {
+        gen->next_ns += (double)(random_next(rng) >> 11) * 0x1.0p-53 * (1e9 / gen->rate);
+    } else {
+        workload_gen_advance(gen, rng);
+    }
+}
+
+/*
+ * Due time of the next arrival (timing_now_ns clock)
+ */
+uint64_t workload_gen_due(const WorkloadGen *gen) {
+    return (uint64_t)gen->next_ns;
+}
+
+/*
+ * Move to the arrival after the current one
+ * A burst is burst_left items due at the same time; bursts arrive as a
+ * Poisson process at rate / burst so the mean rate stays rate
+ */
+void workload_gen_advance(WorkloadGen *gen, RandomState *rng) {
+    switch (gen->spec->arrival) {
+        case WORKLOAD_ARRIVAL_CONSTANT:
+            gen->next_ns += 1e9 / gen->rate;
+            break;
+        case WORKLOAD_ARRIVAL_POISSON:
+            gen->next_ns += exponential_ns(rng, 1e9 / gen->rate);
+            break;
+        case WORKLOAD_ARRIVAL_BURSTY:
+            if (gen->burst_left > 1) {
+                gen->burst_left--;
+            } else {
+                gen->next_ns += exponential_ns(rng, 1e9 * gen->spec->burst / gen->rate);
+                gen->burst_left = gen->spec->burst;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Closed loop: a producer that is behind its schedule drops the backlog
+ * and continues from now_ns, so the rate only limits it
+ */
+void workload_gen_rebase(WorkloadGen *gen, uint64_t now_ns) {
+    if (gen->next_ns < (double)now_ns) {
+        gen->next_ns = (double)now_ns;
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * Shared-Memory Queue Consumer
+ *
+ * Stand-alone consumer process: attaches to (or creates) a named
+ * shared-memory queue and reads items highest priority first until the
+ * timeout, Ctrl+C, or until every producer that attached has left and the
+ * queue is empty. Prints throughput and end-to-end latency (the
+ * timestamps come from CLOCK_MONOTONIC, which all processes share).
+ *
+ * Usage: shm_consumer [options] <name> <timeout_seconds>
+ *
+ * The last process to detach removes the segment; one left behind by
+ * killed processes is removed with rm /dev/shm/<name>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "shm_queue.h"
+#include "shutdown.h"
+#include "histogram.h"
+#include "timing.h"
+#include "utils.h"
+#include "config.h"
+
+static ShmQueue *shm_queue = NULL;
+
+static void wake_queue(void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    shm_queue_wake(shm_queue);
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <name> <timeout_seconds>\n", program_name);
+    fprintf(stderr, "  name: shared queue name, e.g. /pcq\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -n <size>     Queue capacity if this process creates it (default %d)\n",
+            DEFAULT_SHM_QUEUE_SIZE);
+    fprintf(stderr, "  -b <n>        Items per batch read (1-%d, default %d)\n",
+            MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE);
+}
+
+int main(int argc, char *argv[]) {
+    int capacity = DEFAULT_SHM_QUEUE_SIZE;
+    int batch_size = DEFAULT_BATCH_SIZE;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "n:b:")) != -1) {
+        switch (opt) {
+            case 'n':
+                capacity = atoi(optarg);
+                break;
+            case 'b':
+                batch_size = atoi(optarg);
+                if (batch_size < 1 || batch_size > MAX_BATCH_SIZE) {
+                    fprintf(stderr, "Error: batch size must be between 1 and %d\n", MAX_BATCH_SIZE);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 2 || atoi(argv[optind + 1]) <= 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *name = argv[optind];
+    int timeout = atoi(argv[optind + 1]);
+    
+    QueueItem *batch = (QueueItem *)malloc(sizeof(QueueItem) * (size_t)batch_size);
+    LatencyHistogram *latency = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+    shm_queue = shm_queue_open(name, capacity, SHM_ROLE_CONSUMER);
+    if (batch == NULL || latency == NULL || shm_queue == NULL) {
+        free(batch);
+        free(latency);
+        shm_queue_detach(shm_queue);
+        return EXIT_FAILURE;
+    }
+    if (shutdown_init(timeout, 0, wake_queue, NULL) != 0) {
+        shm_queue_detach(shm_queue);
+        return EXIT_FAILURE;
+    }
+    histogram_reset(latency);
+    
+    printf("[SHM] Consumer %d reading from '%s' (%d slots) for %d s\n",
+           (int)getpid(), name, shm_queue->hdr->capacity, timeout);
+    
+    long consumed = 0;
+    long by_priority[3] = { 0, 0, 0 };
+    long blocks = 0;
+    uint64_t start = timing_now_ns();
+    
+    for (;;) {
+        QueueWaitInfo wait;
+        int result = shm_queue_dequeue_batch(shm_queue, batch, batch_size, &wait);
+        if (wait.waited) {
+            blocks++;
+        }
+        if (result == 0) {
+            break; // Stopped, or every producer has left and the queue is empty
+        }
+    
+        uint64_t now = timing_now_ns();
+        for (int b = 0; b < result; b++) {
+            histogram_record(latency, now > batch[b].timestamp ? now - batch[b].timestamp : 0);
+            by_priority[batch[b].priority == PRIORITY_HIGH ? 0 :
+                        batch[b].priority == PRIORITY_NORMAL ? 1 : 2]++;
+        }
+        consumed += result;
+    }
+    
+    double runtime = (timing_now_ns() - start) / 1e9;
+    int producers_left = !shutdown_requested();
+    shutdown_finish();
+    
+    printf("[SHM] Consumer %d: %ld items in %.2f s (%.0f items/sec), %ld block(s)%s\n",
+           (int)getpid(), consumed, runtime, runtime > 0 ? consumed / runtime : 0.0, blocks,
+           producers_left ? ", producers finished" : "");
+    if (consumed > 0) {
+        char p50[32], p99[32], max[32];
+        format_duration_ns(histogram_percentile(latency, 50.0), p50, sizeof(p50));
+        format_duration_ns(histogram_percentile(latency, 99.0), p99, sizeof(p99));
+        format_duration_ns(histogram_max(latency), max, sizeof(max));
+        printf("[SHM] Latency p50 %s, p99 %s, max %s\n", p50, p99, max);
+        printf("[SHM] Priorities: high %ld, normal %ld, low %ld\n",
+               by_priority[0], by_priority[1], by_priority[2]);
+    }
+    if (shm_queue->hdr->recoveries > 0) {
+        printf("[SHM] Lock recoveries after a dead peer: %ld\n", shm_queue->hdr->recoveries);
+    }
+    
+    shm_queue_detach(shm_queue);
+    free(batch);
+    free(latency);
+    return EXIT_SUCCESS;
+}
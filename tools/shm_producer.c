@@ -0,0 +1,146 @@
+/*
+ * Shared-Memory Queue Producer
+ *
+ * Stand-alone producer process: attaches to (or creates) a named
+ * shared-memory queue and writes items with the same value -> priority
+ * mapping as the in-process producers until the timeout or Ctrl+C.
+ *
+ * Usage: shm_producer [options] <name> <timeout_seconds>
+ *   e.g. shm_consumer -n 1024 /pcq 10 & shm_producer -b 32 /pcq 10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "shm_queue.h"
+#include "payload.h"
+#include "shutdown.h"
+#include "timing.h"
+#include "utils.h"
+#include "config.h"
+
+static ShmQueue *shm_queue = NULL;
+
+static void wake_queue(void *arg) {
+    (void)arg; // Suppress unused parameter warning
+    shm_queue_wake(shm_queue);
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <name> <timeout_seconds>\n", program_name);
+    fprintf(stderr, "  name: shared queue name, e.g. /pcq\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -n <size>     Queue capacity if this process creates it (default %d)\n",
+            DEFAULT_SHM_QUEUE_SIZE);
+    fprintf(stderr, "  -b <n>        Items per batch write (1-%d, default %d)\n",
+            MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  -i <id>       Producer id stamped on the items (default: PID)\n");
+    fprintf(stderr, "  -p <usec>     Pause between writes (default 0 = tight loop)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int capacity = DEFAULT_SHM_QUEUE_SIZE;
+    int batch_size = DEFAULT_BATCH_SIZE;
+    int producer_id = (int)getpid();
+    long pace_us = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "n:b:i:p:")) != -1) {
+        switch (opt) {
+            case 'n':
+                capacity = atoi(optarg);
+                break;
+            case 'b':
+                batch_size = atoi(optarg);
+                if (batch_size < 1 || batch_size > MAX_BATCH_SIZE) {
+                    fprintf(stderr, "Error: batch size must be between 1 and %d\n", MAX_BATCH_SIZE);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'i':
+                producer_id = atoi(optarg);
+                break;
+            case 'p':
+                pace_us = atol(optarg);
+                if (pace_us < 0) {
+                    fprintf(stderr, "Error: pacing must not be negative\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 2 || atoi(argv[optind + 1]) <= 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *name = argv[optind];
+    int timeout = atoi(argv[optind + 1]);
+    
+    QueueItem *batch = (QueueItem *)malloc(sizeof(QueueItem) * (size_t)batch_size);
+    int *values = (int *)malloc(sizeof(int) * (size_t)batch_size);
+    shm_queue = shm_queue_open(name, capacity, SHM_ROLE_PRODUCER);
+    if (batch == NULL || values == NULL || shm_queue == NULL) {
+        free(batch);
+        free(values);
+        shm_queue_detach(shm_queue);
+        return EXIT_FAILURE;
+    }
+    if (shutdown_init(timeout, 0, wake_queue, NULL) != 0) {
+        shm_queue_detach(shm_queue);
+        return EXIT_FAILURE;
+    }
+    
+    printf("[SHM] Producer %d writing to '%s' (%d slots) for %d s\n",
+           producer_id, name, shm_queue->hdr->capacity, timeout);
+    
+    RandomState rng;
+    random_state_seed(&rng, timing_now_ns() ^ ((uint64_t)producer_id << 32));
+    long produced = 0;
+    long blocks = 0;
+    uint64_t wait_ns = 0;
+    int sequence_number = 0;
+    uint64_t start = timing_now_ns();
+    
+    while (!shutdown_requested()) {
+        random_fill_range(&rng, values, batch_size, RANDOM_VALUE_MIN, RANDOM_VALUE_MAX);
+        for (int b = 0; b < batch_size; b++) {
+            QueueItem *item = &batch[b];
+            item->value = values[b];
+            item->priority = values[b] >= 7 ? PRIORITY_HIGH :
+                             values[b] >= 4 ? PRIORITY_NORMAL : PRIORITY_LOW;
+            item->producer_id = producer_id;
+            item->sequence = ++sequence_number;
+#if QUEUE_ITEM_PAYLOAD
+            item->payload = PAYLOAD_NONE; // Bodies do not cross processes
+#endif
+            item->timestamp = timing_now_ns();
+        }
+    
+        QueueWaitInfo wait;
+        int result = shm_queue_enqueue_batch(shm_queue, batch, batch_size, &wait);
+        produced += result;
+        if (wait.waited) {
+            blocks++;
+            wait_ns += wait.wait_ns;
+        }
+        timing_pause_ns((uint64_t)pace_us * 1000, 0);
+    }
+    
+    double runtime = (timing_now_ns() - start) / 1e9;
+    shutdown_finish();
+    
+    char buffer[32];
+    format_duration_ns(wait_ns, buffer, sizeof(buffer));
+    printf("[SHM] Producer %d: %ld items in %.2f s (%.0f items/sec), "
+           "%ld block(s), %s blocked\n",
+           producer_id, produced, runtime, runtime > 0 ? produced / runtime : 0.0,
+           blocks, buffer);
+    
+    shm_queue_detach(shm_queue);
+    free(batch);
+    free(values);
+    return EXIT_SUCCESS;
+}
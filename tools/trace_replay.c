@@ -0,0 +1,362 @@
+/*
+ * Trace Replay
+ *
+ * Feeds recorded traces (producer_consumer -T <dir>) back through
+ * queue_enqueue: one replay thread per producer file re-issues its ENQUEUE
+ * events at their recorded offsets from the start of the run, divided by
+ * the speed factor, while consumer threads drain the queue. Reproduces a
+ * recorded load pattern, including its bursts and per-producer
+ * concurrency, against any queue backend.
+ *
+ * Usage: trace_replay [options] <trace_file>...
+ *   e.g. producer_consumer -B -T traces 4 2 64 10
+ *        trace_replay -q lockfree -x 10 traces/producer-1.trace traces/producer-2.trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "trace.h"
+#include "queue.h"
+#include "payload.h"
+#include "histogram.h"
+#include "timing.h"
+#include "utils.h"
+#include "config.h"
+
+// Waits shorter than this are busy-waited (nanosleep overshoots them)
+#define REPLAY_SPIN_NS 50000
+
+// One recorded producer
+typedef struct {
+    TraceFile file;
+    Queue *queue;
+    uint64_t anchor_ns;             // Recorded time that maps to the replay start
+    uint64_t start_ns;              // Replay start (timing_now_ns)
+    double speed;                   // Time compression (0 = as fast as possible)
+    long replayed;
+    long blocks;                    // Enqueues that waited for space
+    uint64_t lag_sum_ns;            // How late the enqueues started, summed
+    uint64_t lag_max_ns;
+} ReplayProducer;
+
+typedef struct {
+    Queue *queue;
+    int batch_size;
+    long consumed;
+    long by_priority[3];
+    LatencyHistogram *latency;
+} ReplayConsumer;
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <trace_file>...\n", program_name);
+    fprintf(stderr, "  trace_file: producer/consumer trace files written by producer_consumer -T\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -q <backend>  Queue backend: scan (default), bucket, lockfree or spsc\n");
+    fprintf(stderr, "  -n <size>     Queue capacity (1-%d, default %d)\n",
+            MAX_QUEUE_SIZE, DEFAULT_REPLAY_QUEUE_SIZE);
+    fprintf(stderr, "  -c <n>        Consumer threads (default: as many as were traced, else 1)\n");
+    fprintf(stderr, "  -b <n>        Items per batch read (1-%d, default %d)\n",
+            MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  -x <factor>   Speed: 1 = recorded rate (default), 10 = ten times faster,\n");
+    fprintf(stderr, "                0 = as fast as the queue allows\n");
+}
+
+static void* replay_producer_thread(void *arg) {
+    ReplayProducer *p = (ReplayProducer *)arg;
+    
+    for (uint64_t i = 0; i < p->file.count; i++) {
+        const TraceRecord *r = &p->file.records[i];
+        if (r->event != TRACE_EVENT_ENQUEUE) {
+            continue;
+        }
+    
+        // Wait for the recorded offset, or note how far behind we are
+        uint64_t now = timing_now_ns();
+        if (p->speed > 0) {
+            uint64_t due = p->start_ns + (uint64_t)((r->timestamp - p->anchor_ns) / p->speed);
+            if (due > now) {
+                timing_pause_ns(due - now, due - now < REPLAY_SPIN_NS);
+                now = timing_now_ns();
+            } else {
+                p->lag_sum_ns += now - due;
+                if (now - due > p->lag_max_ns) {
+                    p->lag_max_ns = now - due;
+                }
+            }
+        }
+    
+        QueueItem item;
+        memset(&item, 0, sizeof(item));
+        item.value = r->value;
+        item.priority = r->priority;
+        item.producer_id = r->producer_id;
+        item.sequence = r->sequence;
+#if QUEUE_ITEM_PAYLOAD
+        item.payload = PAYLOAD_NONE;
+#endif
+        item.timestamp = now;
+    
+        // The batch call of queue_enqueue, for the wait report
+        QueueWaitInfo wait;
+        if (queue_enqueue_batch(p->queue, &item, 1, &wait) != 1) {
+            break;
+        }
+        if (wait.waited) {
+            p->blocks++;
+        }
+        p->replayed++;
+    }
+    
+    return NULL;
+}
+
+static void* replay_consumer_thread(void *arg) {
+    ReplayConsumer *c = (ReplayConsumer *)arg;
+    QueueItem *batch = (QueueItem *)malloc(sizeof(QueueItem) * (size_t)c->batch_size);
+    if (batch == NULL) {
+        fprintf(stderr, "Error: Failed to allocate batch buffer\n");
+        return NULL;
+    }
+    
+    for (;;) {
+        QueueWaitInfo wait;
+        int result = queue_dequeue_batch(c->queue, batch, c->batch_size, 1, &wait);
+        if (result <= 0) {
+            break; // Replay finished and drained
+        }
+    
+        uint64_t now = timing_now_ns();
+        for (int b = 0; b < result; b++) {
+            histogram_record(c->latency, now > batch[b].timestamp ? now - batch[b].timestamp : 0);
+            c->by_priority[batch[b].priority == PRIORITY_HIGH ? 0 :
+                           batch[b].priority == PRIORITY_NORMAL ? 1 : 2]++;
+        }
+        c->consumed += result;
+    }
+    
+    free(batch);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    QueueBackend backend = QUEUE_BACKEND_DEFAULT;
+    int capacity = DEFAULT_REPLAY_QUEUE_SIZE;
+    int n_consumers = 0;
+    int batch_size = DEFAULT_BATCH_SIZE;
+    double speed = 1.0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "q:n:c:b:x:")) != -1) {
+        switch (opt) {
+            case 'q':
+                if (queue_backend_from_name(optarg, &backend) != 0) {
+                    fprintf(stderr, "Error: Unknown queue backend '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                capacity = atoi(optarg);
+                if (capacity < MIN_QUEUE_SIZE || capacity > MAX_QUEUE_SIZE) {
+                    fprintf(stderr, "Error: queue size must be between %d and %d\n",
+                            MIN_QUEUE_SIZE, MAX_QUEUE_SIZE);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                n_consumers = atoi(optarg);
+                if (n_consumers < 1 || n_consumers > MAX_CONSUMERS) {
+                    fprintf(stderr, "Error: consumers must be between 1 and %d\n", MAX_CONSUMERS);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'b':
+                batch_size = atoi(optarg);
+                if (batch_size < 1 || batch_size > MAX_BATCH_SIZE) {
+                    fprintf(stderr, "Error: batch size must be between 1 and %d\n", MAX_BATCH_SIZE);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'x':
+                speed = atof(optarg);
+                if (speed < 0) {
+                    fprintf(stderr, "Error: speed must not be negative\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    // Map every file; producer files are replayed, consumer files only
+    // tell how many consumers the recorded run had
+    int n_files = argc - optind;
+    ReplayProducer *producers = (ReplayProducer *)calloc((size_t)n_files, sizeof(ReplayProducer));
+    if (producers == NULL) {
+        fprintf(stderr, "Error: Failed to allocate replay table\n");
+        return EXIT_FAILURE;
+    }
+    int n_producers = 0;
+    int traced_consumers = 0;
+    long recorded = 0;
+    uint64_t anchor = UINT64_MAX;
+    uint64_t last = 0;
+    for (int i = 0; i < n_files; i++) {
+        TraceFile file;
+        if (trace_file_open(argv[optind + i], &file) != 0) {
+            continue;
+        }
+        if (file.hdr->role != TRACE_ROLE_PRODUCER) {
+            traced_consumers++;
+            trace_file_close(&file);
+            continue;
+        }
+        for (uint64_t r = 0; r < file.count; r++) {
+            if (file.records[r].event == TRACE_EVENT_ENQUEUE) {
+                uint64_t ts = file.records[r].timestamp;
+                anchor = ts < anchor ? ts : anchor;
+                last = ts > last ? ts : last;
+                recorded++;
+            }
+        }
+        producers[n_producers++].file = file;
+    }
+    if (recorded == 0) {
+        fprintf(stderr, "Error: No enqueue events to replay\n");
+        for (int i = 0; i < n_producers; i++) {
+            trace_file_close(&producers[i].file);
+        }
+        free(producers);
+        return EXIT_FAILURE;
+    }
+    if (n_consumers == 0) {
+        n_consumers = traced_consumers > 0 ? traced_consumers : 1;
+    }
+    if (backend == QUEUE_BACKEND_SPSC && (n_producers > 1 || n_consumers > 1)) {
+        fprintf(stderr, "Error: the spsc backend needs exactly 1 producer and 1 consumer\n");
+        for (int i = 0; i < n_producers; i++) {
+            trace_file_close(&producers[i].file);
+        }
+        free(producers);
+        return EXIT_FAILURE;
+    }
+    
+    QueueOptions opts;
+    queue_options_default(&opts, capacity);
+    opts.backend = backend;
+    Queue *queue = queue_init_with(&opts);
+    pthread_t *threads = (pthread_t *)calloc((size_t)(n_producers + n_consumers), sizeof(pthread_t));
+    ReplayConsumer *consumers = (ReplayConsumer *)calloc((size_t)n_consumers, sizeof(ReplayConsumer));
+    LatencyHistogram *latency = (LatencyHistogram *)malloc(sizeof(LatencyHistogram) *
+                                                          (size_t)(n_consumers + 1));
+    if (queue == NULL || threads == NULL || consumers == NULL || latency == NULL) {
+        fprintf(stderr, "Error: Failed to set up the replay\n");
+        queue_destroy(queue);
+        free(threads);
+        free(consumers);
+        free(latency);
+        for (int i = 0; i < n_producers; i++) {
+            trace_file_close(&producers[i].file);
+        }
+        free(producers);
+        return EXIT_FAILURE;
+    }
+    
+    printf("[REPLAY] %d producer trace(s), %ld enqueue(s) over %.2f s recorded\n",
+           n_producers, recorded, (last - anchor) / 1e9);
+    if (speed > 0) {
+        printf("[REPLAY] Backend %s, capacity %d, %d consumer(s), speed %gx\n",
+               queue_backend_name(backend), capacity, n_consumers, speed);
+    } else {
+        printf("[REPLAY] Backend %s, capacity %d, %d consumer(s), as fast as possible\n",
+               queue_backend_name(backend), capacity, n_consumers);
+    }
+    
+    for (int i = 0; i < n_consumers; i++) {
+        consumers[i].queue = queue;
+        consumers[i].batch_size = batch_size;
+        consumers[i].latency = &latency[i];
+        histogram_reset(&latency[i]);
+        pthread_create(&threads[n_producers + i], NULL, replay_consumer_thread, &consumers[i]);
+    }
+    uint64_t start = timing_now_ns();
+    for (int i = 0; i < n_producers; i++) {
+        producers[i].queue = queue;
+        producers[i].anchor_ns = anchor;
+        producers[i].start_ns = start;
+        producers[i].speed = speed;
+        pthread_create(&threads[i], NULL, replay_producer_thread, &producers[i]);
+    }
+    
+    // Once every event is replayed, let the consumers empty the queue,
+    // then stop them
+    for (int i = 0; i < n_producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    while (queue_get_size_approx(queue) > 0) {
+        timing_pause_ns(1000000, 0);
+    }
+    queue_close(queue);
+    for (int i = 0; i < n_consumers; i++) {
+        pthread_join(threads[n_producers + i], NULL);
+    }
+    double runtime = (timing_now_ns() - start) / 1e9;
+    
+    // Totals over all threads
+    long replayed = 0;
+    long consumed = 0;
+    long blocks = 0;
+    long by_priority[3] = { 0, 0, 0 };
+    uint64_t lag_sum = 0;
+    uint64_t lag_max = 0;
+    LatencyHistogram *all = &latency[n_consumers];
+    histogram_reset(all);
+    for (int i = 0; i < n_producers; i++) {
+        replayed += producers[i].replayed;
+        blocks += producers[i].blocks;
+        lag_sum += producers[i].lag_sum_ns;
+        lag_max = producers[i].lag_max_ns > lag_max ? producers[i].lag_max_ns : lag_max;
+        trace_file_close(&producers[i].file);
+    }
+    for (int i = 0; i < n_consumers; i++) {
+        consumed += consumers[i].consumed;
+        for (int p = 0; p < 3; p++) {
+            by_priority[p] += consumers[i].by_priority[p];
+        }
+        histogram_merge(all, &latency[i]);
+    }
+    
+    printf("[REPLAY] %ld of %ld item(s) replayed, %ld consumed in %.2f s (%.0f items/sec)\n",
+           replayed, recorded, consumed, runtime, runtime > 0 ? consumed / runtime : 0.0);
+    if (speed > 0) {
+        char mean[32], max[32];
+        format_duration_ns(replayed > 0 ? lag_sum / (uint64_t)replayed : 0, mean, sizeof(mean));
+        format_duration_ns(lag_max, max, sizeof(max));
+        printf("[REPLAY] Schedule lag: mean %s, max %s behind the recording\n", mean, max);
+    }
+    printf("[REPLAY] Enqueues blocked on a full queue: %ld\n", blocks);
+    if (consumed > 0) {
+        char p50[32], p99[32], max[32];
+        format_duration_ns(histogram_percentile(all, 50.0), p50, sizeof(p50));
+        format_duration_ns(histogram_percentile(all, 99.0), p99, sizeof(p99));
+        format_duration_ns(histogram_max(all), max, sizeof(max));
+        printf("[REPLAY] Latency p50 %s, p99 %s, max %s\n", p50, p99, max);
+        printf("[REPLAY] Priorities: high %ld, normal %ld, low %ld\n",
+               by_priority[0], by_priority[1], by_priority[2]);
+    }
+    
+    queue_destroy(queue);
+    free(threads);
+    free(consumers);
+    free(latency);
+    free(producers);
+    return EXIT_SUCCESS;
+}